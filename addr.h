@@ -30,6 +30,24 @@
 #define PHY_PAGE_NUM    20
 #define PHY_ADDR        32 // = PHY_PAGE_NUM + PAGE_OFFSET
 
+/*
+ * Huge pages: a PUD entry with PTE_PAGE_SIZE set maps a 1 GiB page and a
+ * PMD entry with it set a 2 MiB page, as the PS bit of x86-64 does. The
+ * other entries are addresses of 4 kiB aligned tables or pages, so their
+ * 12 low bits are free for such flags.
+ */
+#define PTE_PAGE_SIZE   0x80u
+#define PTE_ADDR_MASK   (~(pte_t) (PAGE_SIZE - 1))
+
+/*
+ * CR3, the current address space: the address of its PGD, 4 kiB aligned,
+ * with its process-context identifier (PCID) in the 12 low bits, as on
+ * x86-64. The PGD of the initial address space, of PCID 0, is at 0.
+ */
+#define CR3_PCID_MASK   ((uint32_t) (PAGE_SIZE - 1))
+#define cr3_root(CR3)   ((CR3) & PTE_ADDR_MASK)
+#define cr3_pcid(CR3)   ((uint16_t) ((CR3) & CR3_PCID_MASK))
+
 #define mask_9bit 		0b111111111
 #define mask_offset  	0b111111111111
 #define shift  			9
@@ -51,6 +69,18 @@ uint16_t page_offset : PAGE_OFFSET;
 
 } virt_addr_t;
 
+/**
+ * @brief Sizes of the pages a translation may map.
+ */
+typedef enum {
+    PAGE_4K, PAGE_2M, PAGE_1G, NB_PAGE_SIZES } page_size_t;
+
+// log_2 of the number of 4 kiB pages in a page of SIZE
+#define page_size_order(SIZE) ((unsigned) (SIZE) * PTE_ENTRY)
+
+// number of bits of the offset in a page of SIZE
+#define page_size_bits(SIZE)  (PAGE_OFFSET + page_size_order(SIZE))
+
 typedef struct {
 
 
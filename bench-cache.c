@@ -0,0 +1,145 @@
+/**
+ * @file bench-cache.c
+ * @brief throughput benchmark of the cache hierarchy (cache_read/cache_write)
+ *
+ * Runs a pseudo-random stream of instruction fetches, data reads and data
+ * writes over a working set larger than L2 and reports accesses/sec and
+ * the peak resident set size of the process.
+ *
+ * usage: bench-cache [nb_accesses [seed [l1_ways l2_ways [l1_policy l2_policy]]]]
+ *        where policies are named as in cache_replace.h (e.g. lru, tree-plru, srrip)
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32  || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "error.h"
+#include "cache_mng.h"
+#include "cache_replace.h"
+#include "addr_mng.h"
+#include "util.h" // for zero_init_var()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define BENCH_DEFAULT_ACCESSES 10000000ul
+#define BENCH_MEM_SIZE         (1u << 20) // 1 MiB of simulated memory
+#define BENCH_WORKING_SET      (1u << 18) // 256 kiB, 4x the L2 capacity
+
+// ======================================================================
+static uint64_t xorshift64(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// ======================================================================
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    const unsigned long nb_accesses = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_ACCESSES;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 0x2545F4914F6CDD1Dull;
+    if (seed == 0) seed = 1;
+
+    void* mem_space = calloc(BENCH_MEM_SIZE, 1);
+    if (mem_space == NULL)
+        {
+            fputs("ERROR: cannot allocate simulated memory\n", stderr);
+            return 1;
+        }
+
+    // default geometry and policy, unless others are given
+    cache_config_t l1_config = L1_ICACHE_CONFIG;
+    cache_config_t l2_config = L2_CACHE_CONFIG;
+    if (argc > 4)
+        {
+            l1_config.ways = (uint8_t) strtoul(argv[3], NULL, 0);
+            l2_config.ways = (uint8_t) strtoul(argv[4], NULL, 0);
+        }
+    if (argc > 6
+        && (cache_replace_from_name(argv[5], &l1_config.replace) != ERR_NONE
+            || cache_replace_from_name(argv[6], &l2_config.replace) != ERR_NONE))
+        {
+            fputs("ERROR: unknown replacement policy\n", stderr);
+            return 1;
+        }
+
+    cache_level_t l1_icache, l1_dcache, l2_cache;
+    if (cache_init(&l1_icache, L1_ICACHE, &l1_config) != ERR_NONE
+        || cache_init(&l1_dcache, L1_DCACHE, &l1_config) != ERR_NONE
+        || cache_init(&l2_cache, L2_CACHE, &l2_config) != ERR_NONE)
+        {
+            fputs("ERROR: cannot create the caches\n", stderr);
+            return 1;
+        }
+
+    unsigned long reads = 0, writes = 0, errors = 0;
+    const double start = now_in_seconds();
+    for (unsigned long i = 0; i < nb_accesses; ++i)
+        {
+            const uint64_t r = xorshift64(&seed);
+            const uint32_t addr = (uint32_t) (r >> 32) % BENCH_WORKING_SET & ~(uint32_t) 3;
+            phy_addr_t paddr;
+            init_phy_addr(&paddr, addr & ~(uint32_t) (PAGE_SIZE - 1), addr % PAGE_SIZE);
+
+            word_t word = (word_t) r;
+            int err = ERR_NONE;
+            switch (r & 3)
+                {
+                case 0:
+                    err = cache_read(mem_space, &paddr, INSTRUCTION, &l1_icache, &l2_cache, &word);
+                    ++reads;
+                    break;
+                case 1:
+                    err = cache_write(mem_space, &paddr, &l1_dcache, &l2_cache, &word);
+                    ++writes;
+                    break;
+                default:
+                    err = cache_read(mem_space, &paddr, DATA, &l1_dcache, &l2_cache, &word);
+                    ++reads;
+                    break;
+                }
+            if (err != ERR_NONE) ++errors;
+        }
+    const double elapsed = now_in_seconds() - start;
+
+    struct rusage usage;
+    zero_init_var(usage);
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("accesses:   %lu (%lu reads, %lu writes, %lu errors)\n", nb_accesses, reads, writes, errors);
+    printf("time:       %.3f s\n", elapsed);
+    printf("throughput: %.0f accesses/s\n", elapsed > 0 ? (double) nb_accesses / elapsed : 0.0);
+    printf("max RSS:    %ld kiB\n", usage.ru_maxrss);
+
+    putchar('\n');
+    stats_print_header(stdout, STATS_TEXT);
+    cache_stats_print(stdout, STATS_TEXT, &l1_icache);
+    cache_stats_print(stdout, STATS_TEXT, &l1_dcache);
+    cache_stats_print(stdout, STATS_TEXT, &l2_cache);
+
+    cache_free(&l1_icache);
+    cache_free(&l1_dcache);
+    cache_free(&l2_cache);
+    free(mem_space);
+    return errors == 0 ? 0 : 2;
+}
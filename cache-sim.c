@@ -0,0 +1,327 @@
+/**
+ * @file cache-sim.c
+ * @brief simulator: runs a program through the TLB and cache hierarchies
+ *        and prints the statistics at the end
+ *
+ * The command file is either a binary trace (see trace.h) or a program in
+ * text format; both are streamed, so any length of program can be run.
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32  || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "error.h"
+#include "sim_mng.h"
+#include "cache_replace.h"
+#include "cache_prefetch.h"
+#include "cache_mng.h"
+#include "cmd_source_mng.h"
+#include "memory.h"
+#include "image_mng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h> // PRIu64
+
+// ======================================================================
+static void usage(const char* pgm, const char* msg)
+{
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s [options] (dump|desc|image) mem_filename command_filename\n", pgm);
+    fputs("options:  --csv              print the statistics as CSV\n", stderr);
+    fputs("          --l1-policy NAME   replacement policy of the L1 caches (default: lru)\n", stderr);
+    fputs("          --l2-policy NAME   replacement policy of the L2 cache (default: lru)\n", stderr);
+    fputs("          --inclusion NAME   inclusion policy of L2: exclusive, inclusive or nine (default: exclusive)\n", stderr);
+    fputs("          --l3 SETSxWAYS     add a shared L3 cache of that geometry (default: none, 4096x16)\n", stderr);
+    fputs("          --l3-slices N      number of slices of L3: 1, 2, 4 or 8 (default: 4)\n", stderr);
+    fputs("          --l3-inclusion NAME inclusion policy of L3: inclusive or nine (default: inclusive)\n", stderr);
+    fputs("          --l1d-prefetch NAME[:DEGREE[:DISTANCE]], --l2-prefetch NAME[:DEGREE[:DISTANCE]]\n", stderr);
+    fputs("                             prefetcher of the L1 DCACHE, of L2: none, next-line, stride or\n", stderr);
+    fputs("                             streamer (default: none)\n", stderr);
+    fputs("          --latency          count the cycles of the accesses, with the latencies of Kaby Lake,\n", stderr);
+    fputs("                             and print their average (AMAT) and histogram\n", stderr);
+    fputs("          --latency-of LEVEL=CYCLES\n", stderr);
+    fputs("                             as --latency, with the latency of LEVEL (l1-tlb, l2-tlb, walk,\n", stderr);
+    fputs("                             l1, l2, l3 or memory) set to CYCLES\n", stderr);
+    fputs("          --itlb SETSxWAYS   geometry of the L1 ITLB (default: 16x1)\n", stderr);
+    fputs("          --dtlb SETSxWAYS   geometry of the L1 DTLB (default: 16x1)\n", stderr);
+    fputs("          --l2-tlb SETSxWAYS geometry of the L2 TLB (default: 64x1)\n", stderr);
+    fputs("          --kaby-lake-tlbs   the TLBs of Kaby Lake, with their 2 MiB and 1 GiB page arrays\n", stderr);
+    fputs("                             and paging-structure caches\n", stderr);
+    fputs("          --pml4e-cache SETSxWAYS, --pdpte-cache SETSxWAYS, --pde-cache SETSxWAYS\n", stderr);
+    fputs("                             geometry of the paging-structure caches (default: none)\n", stderr);
+    fputs("          --pcid             tag the TLB entries with the PCID of CR3: context switches\n", stderr);
+    fputs("                             (C commands) do not flush them\n", stderr);
+    fputs("          --tlb-policy NAME  replacement policy of the TLBs: lru, fifo or random (default: lru)\n", stderr);
+    fputs("          --write-back       write-back caches (default: write-through)\n", stderr);
+    fputs("          --mmap             map the memory dump (copy-on-write) instead of reading it\n", stderr);
+    fputs("          --mmap-tables      as --mmap, asking the system to read the page tables ahead\n", stderr);
+    fputs("          --stack-dist N     also print the hits of LRU caches of 1 to N ways\n", stderr);
+    fputs("          --threads N        split the caches by set across N threads (a power of 2)\n", stderr);
+    fprintf(stderr, "example:  %s dump memory_dump.bin commands01.txt\n", pgm);
+}
+
+// ======================================================================
+// parses "SETSxWAYS" into a geometry within bounds
+static int parse_geometry(const char* arg, unsigned max_lines, unsigned max_ways, uint16_t* lines, uint8_t* ways)
+{
+    unsigned l = 0, w = 0;
+    char end = '\0';
+    if (sscanf(arg, "%ux%u%c", &l, &w, &end) != 2
+        || l == 0 || l > max_lines || w == 0 || w > max_ways)
+        return 0;
+    *lines = (uint16_t) l;
+    *ways = (uint8_t) w;
+    return 1;
+}
+
+// --------------------------------------------------
+#define parse_tlb_geometry(ARG, CONFIG) \
+        parse_geometry(ARG, TLB_MAX_LINES, TLB_MAX_WAYS, &(CONFIG)->lines, &(CONFIG)->ways)
+
+// --------------------------------------------------
+#define parse_walk_cache_geometry(ARG, CONFIG) \
+        parse_geometry(ARG, WALK_CACHE_MAX_LINES, WALK_CACHE_MAX_WAYS, &(CONFIG)->lines, &(CONFIG)->ways)
+
+// ======================================================================
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+// parses "LEVEL=CYCLES" into the latency of that level (see sim_latency_t)
+static int parse_latency(const char* arg, sim_latency_t* latency)
+{
+    const char* const names[] = { "l1-tlb", "l2-tlb", "walk", "l1", "l2", "l3", "memory" };
+    uint16_t* const fields[] = { &latency->l1_tlb, &latency->l2_tlb, &latency->walk_read, &latency->l1_cache,
+                                 &latency->l2_cache, &latency->l3_cache, &latency->memory };
+    const char* equal = strchr(arg, '=');
+    if (equal == NULL) return 0;
+    char* end = NULL;
+    const unsigned long cycles = strtoul(equal + 1, &end, 10);
+    if (end == equal + 1 || *end != '\0' || cycles > UINT16_MAX) return 0;
+
+    const size_t length = (size_t) (equal - arg);
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        if (strncmp(arg, names[i], length) == 0 && names[i][length] == '\0')
+            {
+                *fields[i] = (uint16_t) cycles;
+                return 1;
+            }
+    return 0;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    stats_format_t format = STATS_TEXT;
+    sim_config_t config = SIM_DEFAULT_CONFIG;
+    unsigned long nb_threads = 1;
+    int mapped = 0, advise_tables = 0;
+    uint8_t l3_slices = L3_CACHE_SLICES;
+    cache_inclusion_t l3_inclusion = INCLUSIVE;
+    const sim_latency_t kaby_lake_latency = SIM_KABY_LAKE_LATENCY;
+    int timed = 0;
+
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg)
+        {
+            int ok = 0;
+            if (strcmp(argv[arg], "--csv") == 0)
+                {
+                    format = STATS_CSV;
+                    ok = 1;
+                }
+            else if (strcmp(argv[arg], "--l1-policy") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_replace_from_name(argv[++arg], &config.l1_icache.replace) == ERR_NONE;
+                    config.l1_dcache.replace = config.l1_icache.replace;
+                }
+            else if (strcmp(argv[arg], "--l2-policy") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_replace_from_name(argv[++arg], &config.l2_cache.replace) == ERR_NONE;
+                }
+            else if (strcmp(argv[arg], "--inclusion") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_inclusion_from_name(argv[++arg], &config.l2_cache.inclusion) == ERR_NONE;
+                }
+            else if (strcmp(argv[arg], "--l3") == 0 && arg + 1 < argc)
+                {
+                    const cache_config_t l3 = L3_CACHE_CONFIG;
+                    if (config.l3_cache.lines == 0) config.l3_cache = l3;
+                    ok = parse_geometry(argv[++arg], CACHE_MAX_LINES, CACHE_MAX_WAYS,
+                                        &config.l3_cache.lines, &config.l3_cache.ways);
+                }
+            else if (strcmp(argv[arg], "--l3-slices") == 0 && arg + 1 < argc)
+                {
+                    const unsigned long slices = strtoul(argv[++arg], NULL, 0);
+                    ok = slices > 0 && slices <= CACHE_MAX_SLICES && (slices & (slices - 1)) == 0;
+                    l3_slices = (uint8_t) slices;
+                }
+            else if (strcmp(argv[arg], "--l3-inclusion") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_inclusion_from_name(argv[++arg], &l3_inclusion) == ERR_NONE && l3_inclusion != EXCLUSIVE;
+                }
+            else if (strcmp(argv[arg], "--l1d-prefetch") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_prefetch_from_name(argv[++arg], &config.l1_dcache.prefetch) == ERR_NONE;
+                }
+            else if (strcmp(argv[arg], "--l2-prefetch") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_prefetch_from_name(argv[++arg], &config.l2_cache.prefetch) == ERR_NONE;
+                }
+            else if (strcmp(argv[arg], "--latency") == 0)
+                {
+                    if (!timed) config.latency = kaby_lake_latency;
+                    timed = ok = 1;
+                }
+            else if (strcmp(argv[arg], "--latency-of") == 0 && arg + 1 < argc)
+                {
+                    if (!timed) config.latency = kaby_lake_latency;
+                    timed = 1;
+                    ok = parse_latency(argv[++arg], &config.latency);
+                }
+            else if (strcmp(argv[arg], "--itlb") == 0 && arg + 1 < argc)
+                {
+                    ok = parse_tlb_geometry(argv[++arg], &config.tlb.l1_itlb);
+                }
+            else if (strcmp(argv[arg], "--dtlb") == 0 && arg + 1 < argc)
+                {
+                    ok = parse_tlb_geometry(argv[++arg], &config.tlb.l1_dtlb);
+                }
+            else if (strcmp(argv[arg], "--l2-tlb") == 0 && arg + 1 < argc)
+                {
+                    ok = parse_tlb_geometry(argv[++arg], &config.tlb.l2_tlb);
+                }
+            else if (strcmp(argv[arg], "--pml4e-cache") == 0 && arg + 1 < argc)
+                {
+                    ok = parse_walk_cache_geometry(argv[++arg], &config.tlb.walk[PML4E_CACHE]);
+                }
+            else if (strcmp(argv[arg], "--pdpte-cache") == 0 && arg + 1 < argc)
+                {
+                    ok = parse_walk_cache_geometry(argv[++arg], &config.tlb.walk[PDPTE_CACHE]);
+                }
+            else if (strcmp(argv[arg], "--pde-cache") == 0 && arg + 1 < argc)
+                {
+                    ok = parse_walk_cache_geometry(argv[++arg], &config.tlb.walk[PDE_CACHE]);
+                }
+            else if (strcmp(argv[arg], "--kaby-lake-tlbs") == 0)
+                {
+                    config.tlb = TLB_HRCHY_KABY_LAKE_CONFIG;
+                    ok = 1;
+                }
+            else if (strcmp(argv[arg], "--pcid") == 0)
+                {
+                    config.tlb.pcids = 1;
+                    ok = 1;
+                }
+            else if (strcmp(argv[arg], "--tlb-policy") == 0 && arg + 1 < argc)
+                {
+                    ok = cache_replace_from_name(argv[++arg], &config.tlb.l1_itlb.replace) == ERR_NONE;
+                    config.tlb.l1_dtlb.replace = config.tlb.l2_tlb.replace = config.tlb.l1_itlb.replace;
+                    for (tlb_t level = L1_ITLB; level < NB_TLBS; ++level)
+                        for (size_t i = 0; i < TLB_LARGE_ARRAYS; ++i)
+                            config.tlb.large[level][i].replace = config.tlb.l1_itlb.replace;
+                }
+            else if (strcmp(argv[arg], "--write-back") == 0)
+                {
+                    config.l1_icache.write_back = config.l1_dcache.write_back = config.l2_cache.write_back = 1;
+                    ok = 1;
+                }
+            else if (strcmp(argv[arg], "--mmap") == 0 || strcmp(argv[arg], "--mmap-tables") == 0)
+                {
+                    mapped = 1;
+                    advise_tables = strcmp(argv[arg], "--mmap-tables") == 0;
+                    ok = 1;
+                }
+            else if (strcmp(argv[arg], "--stack-dist") == 0 && arg + 1 < argc)
+                {
+                    const unsigned long ways = strtoul(argv[++arg], NULL, 0);
+                    ok = ways > 0 && ways <= STACK_DIST_MAX_WAYS;
+                    config.stack_dist_ways = (uint16_t) ways;
+                }
+            else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc)
+                {
+                    nb_threads = strtoul(argv[++arg], NULL, 0);
+                    ok = nb_threads > 0 && nb_threads <= SIM_MAX_THREADS;
+                }
+            if (!ok)
+                {
+                    usage(argv[0], "unknown option or invalid option value.");
+                    return 1;
+                }
+        }
+    config.l3_cache.slices = l3_slices;
+    config.l3_cache.inclusion = l3_inclusion;
+    if (argc - arg < 3)
+        {
+            usage(argv[0], "please provide memory format, memory file and command file.");
+            return 1;
+        }
+
+    void* mem_space = NULL;
+    size_t mem_size = 0;
+    int err = ERR_NONE;
+    if (strcmp(argv[arg], "dump") == 0 && mapped)
+        err = mem_map_dumpfile(argv[arg + 1], &mem_space, &mem_size, advise_tables);
+    else if (strcmp(argv[arg], "dump") == 0)
+        err = mem_init_from_dumpfile(argv[arg + 1], &mem_space, &mem_size);
+    else if (strcmp(argv[arg], "desc") == 0 && !mapped)
+        err = mem_init_from_description(argv[arg + 1], &mem_space, &mem_size);
+    else if (strcmp(argv[arg], "image") == 0 && !mapped)
+        err = image_read(argv[arg + 1], &mem_space, &mem_size);
+    else
+        {
+            usage(argv[0], mapped ? "only a memory dump can be mapped." : "unknown memory format.");
+            return 1;
+        }
+    if (err != ERR_NONE)
+        {
+            fprintf(stderr, "ERROR: cannot initialize memory from \"%s\": %s\n", argv[arg + 1], ERR_MESSAGES[err]);
+            return 2;
+        }
+
+    cmd_source_t source;
+    if ((err = cmd_source_open(&source, argv[arg + 2])) != ERR_NONE)
+        {
+            fprintf(stderr, "ERROR: cannot read commands from \"%s\": %s\n", argv[arg + 2], ERR_MESSAGES[err]);
+            mem_free(mem_space, mem_size);
+            return 2;
+        }
+
+    sim_t sim;
+    if ((err = sim_init(&sim, mem_space, mem_size, &config)) != ERR_NONE)
+        {
+            fprintf(stderr, "ERROR: cannot create the TLBs and caches: %s\n", ERR_MESSAGES[err]);
+            cmd_source_close(&source);
+            mem_free(mem_space, mem_size);
+            return 2;
+        }
+
+    const double start = now_in_seconds();
+    err = nb_threads > 1 ? sim_run_parallel(&sim, &source, (unsigned) nb_threads) : sim_run_source(&sim, &source);
+    if (err == ERR_NONE) err = sim_write_back(&sim);
+    const double elapsed = now_in_seconds() - start;
+    if (err != ERR_NONE)
+        fprintf(stderr, "ERROR: command %" PRIu64 ": %s\n", sim.commands, ERR_MESSAGES[err]);
+
+    sim_print_summary(stdout, format, &sim);
+    if (format == STATS_TEXT)
+        fprintf(stderr, "simulated %" PRIu64 " commands in %.3f s\n", sim.commands, elapsed);
+
+    sim_free(&sim);
+    cmd_source_close(&source);
+    mem_free(mem_space, mem_size);
+    return err == ERR_NONE ? 0 : 3;
+}
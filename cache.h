@@ -9,12 +9,18 @@
  */
 
 #include <stdint.h>
+#include <stddef.h> // size_t
 #include "addr.h"
+#include "stats.h"
 
+/*
+ * Default (Kaby Lake like) geometry of each cache; the actual geometry of
+ * a cache is given at run time by a cache_config_t (see cache_init()).
+ */
 #define L1_ICACHE_WORDS_PER_LINE 4
 #define L1_ICACHE_LINE   16u // 16 bytes (4 words) per line
 #define L1_ICACHE_WAYS   4u
-#define L1_ICACHE_LINES  64u  // Do not modify this!
+#define L1_ICACHE_LINES  64u
 #define L1_ICACHE_TAG_REMAINING_BITS   10 // 2(select byte) + 2(select word) + 6(select line)
 #define L1_ICACHE_TAG_BITS             22 // 32 - L1_ICACHE_TAG_REMAINING_BITS
 
@@ -28,33 +34,47 @@
 #define L2_CACHE_WORDS_PER_LINE L1_ICACHE_WORDS_PER_LINE
 #define L2_CACHE_LINE   L1_ICACHE_LINE
 #define L2_CACHE_WAYS   8u
-#define L2_CACHE_LINES  512u  // Do not modify this!
+#define L2_CACHE_LINES  512u
 #define L2_CACHE_TAG_REMAINING_BITS   13 // 2(select byte) + 2(select word) + 9(select line)
 #define L2_CACHE_TAG_BITS             19 // 32 - L1_ICACHE_TAG_REMAINING_BITS
 
+#define L3_CACHE_WORDS_PER_LINE L1_ICACHE_WORDS_PER_LINE
+#define L3_CACHE_LINE   L1_ICACHE_LINE
+#define L3_CACHE_WAYS   16u
+#define L3_CACHE_LINES  4096u // 1024 per slice
+#define L3_CACHE_SLICES 4u
+
+/*
+ * Bounds on run-time geometries.
+ * The number of lines must fit in a line index (HIT_INDEX_MISS excluded).
+ */
+#define CACHE_MAX_WAYS           16u
+#define CACHE_MAX_WORDS_PER_LINE 16u // 64 bytes per line
+#define CACHE_MAX_LINES          32768u
+
 #define VALID 1
 #define INVALID 0
 
 
 /**
- * L1 ICACHE, L1 DCACHE:
+ * L1 ICACHE, L1 DCACHE (default geometry):
  *  - byte addressing
  *  - physically addressed
  *  - 4-way set-associative
  *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
  *  - 64 sets (= 64 blocks per way) (= 6 bits to index)
  *  - total capacity = 4kiB
- *  - write-through policy (no dirty bit)
+ *  - write-through policy (no dirty bit), or write-back (see below)
  *  - write-allocate on write miss
  *
- * L2 CACHE:
+ * L2 CACHE (default geometry):
  *  - byte addressing
  *  - physically addressed
  *  - 8-way set-associative
  *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
  *  - 512 sets (= 512 blocks per way) (= 9 bits to index)
  *  - total capacity = 64kiB
- *  - write-through policy (no dirty bit)
+ *  - write-through policy (no dirty bit), or write-back (see below)
  *  - write-allocate on write miss
  *
  *  Exclusive policy (https://en.wikipedia.org/wiki/Cache_inclusion_policy)
@@ -69,189 +89,288 @@
  *      L2, then it is fetched from main memory and placed just in L1 and not
  *      in L2.
  *
+ *  Exclusive is the default inclusion policy of L2 (config.inclusion of
+ *  L2, see cache_inclusion_t); the others are:
+ *
+ *  Inclusive policy
+ *      L2 holds a copy of every line of the L1 caches. A line missing in both
+ *      is placed in L2 and in L1; an L2 hit copies the line to L1 and keeps
+ *      it in L2. An L1 victim is dropped, unless dirty: then it updates its
+ *      copy in L2. When a line leaves L2, it is back-invalidated in the L1
+ *      caches (see cache_attach_inner()); a dirty L1 copy is written back
+ *      with it.
+ *
+ *  Non-inclusive non-exclusive (NINE) policy
+ *      Lines are filled as in the inclusive policy, but a line leaving L2
+ *      stays in L1: a dirty L1 victim absent from L2 is placed in L2 again.
+ *
+ *  As the victim of L1 is moved as a whole into L2, L1 and L2 must have
+ *  the same line size.
+ *
+ * L3 CACHE (optional, default geometry):
+ *  - byte addressing
+ *  - physically addressed
+ *  - 16-way set-associative
+ *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
+ *  - 4 slices of 1024 sets (= 10 bits to index a set in its slice)
+ *  - total capacity = 1MiB
+ *  - inclusive of L1 and L2 (or NINE), see cache_attach_next()
+ *
+ *  The slice of a line is a hash of its address (see cache_slice_of());
+ *  as the hash reads bits above the set index, the tag holds all the bits
+ *  above the index in the slice. L3 is shared by both L1 caches: an L2
+ *  miss looks L3 up before memory, and a dirty line leaving L2 is written
+ *  into L3. When a line leaves an inclusive L3, it is back-invalidated in
+ *  L2 and both L1 caches. L3 has the line size of L2.
+ *
+ *  Write-back policy (config.write_back of L1)
+ *      A write only changes the line in L1 and marks it dirty. The dirty
+ *      bit moves with the line: an L1 victim goes to L2 dirty, a line
+ *      promoted from L2 to L1 stays dirty. Memory is only written when a
+ *      dirty line leaves L2, or when the caches are written back at the end
+ *      (see cache_write_back()). Until then, memory (and thus the page
+ *      walks) does not see the writes. L1 ICACHE and L1 DCACHE are not kept
+ *      coherent with each other.
+ *      With write-through caches, a write also changes the copy of the line
+ *      in L2, if any (inclusive and NINE policies).
+ *
+ *  Prefetchers (config.prefetch of L1 DCACHE and L2, see cache_prefetch.h)
+ *      A prefetcher learns from the demand misses of its cache and brings
+ *      lines in ahead of them, through the same path as a demand miss but
+ *      without counting an access. A prefetched line is tagged until its
+ *      first demand hit (a useful prefetch); a demand miss on a line still
+ *      waiting to be prefetched is a late prefetch, and one on a line a
+ *      prefetch evicted is a polluting prefetch.
  */
-typedef struct
+
+typedef enum
 {
+	L1_ICACHE, L1_DCACHE, L2_CACHE, L3_CACHE,
+	MAIN_MEMORY // not a cache: what serves an access every cache misses (see cache_level_t.served)
+} cache_t;
+
+/**
+ * @brief Replacement policies, see cache_replace.h.
+ */
+enum cache_replacement_policy
+{
+	LRU,       // true LRU, with ages
+	TREE_PLRU, // binary tree pseudo-LRU (power of 2 ways only)
+	BIT_PLRU,  // MRU-bit pseudo-LRU
+	FIFO,      // oldest inserted
+	RANDOM,    // pseudo-random way, seeded
+	SRRIP,     // static re-reference interval prediction (2-bit RRPV)
+	BRRIP,     // bimodal RRIP: SRRIP with mostly distant insertions
+	NB_CACHE_REPLACE // not a policy, the number of policies
+};
+typedef enum cache_replacement_policy cache_replace_t;
 
-	uint8_t v: 1;
-	uint8_t age: 2;
-	uint32_t tag: 22;
-	word_t line[L1_ICACHE_WORDS_PER_LINE];
+/**
+ * @brief Inclusion policies of a cache with respect to the caches it backs
+ * (https://en.wikipedia.org/wiki/Cache_inclusion_policy), see above.
+ */
+typedef enum
+{
+	EXCLUSIVE, // a victim cache: lines are either inside or outside
+	INCLUSIVE, // a superset of the inner caches, back-invalidates them
+	NINE,      // non-inclusive non-exclusive: filled as inclusive, never back-invalidates
+	NB_CACHE_INCLUSION // not a policy, the number of policies
+} cache_inclusion_t;
 
-} l1_icache_entry_t;
+/**
+ * @brief Hardware prefetchers, see cache_prefetch.h.
+ */
+typedef enum
+{
+	NO_PREFETCH,
+	NEXT_LINE, // the lines after a miss
+	STRIDE,    // a constant stride between the misses of a stream (a 4 kiB page)
+	STREAMER,  // runs of ascending or descending misses in a page, as the L2 streamer of Intel
+	NB_CACHE_PREFETCH // not a prefetcher, the number of prefetchers
+} cache_prefetch_t;
 
+/**
+ * @brief A prefetcher and its aggressiveness.
+ */
 typedef struct
 {
+	cache_prefetch_t kind;
+	uint8_t degree;   // lines proposed per trigger, at most CACHE_PREFETCH_MAX_DEGREE
+	uint8_t distance; // lines (strides for STRIDE) between the trigger and the first line, at most CACHE_PREFETCH_MAX_DISTANCE
+} cache_prefetch_config_t;
 
-	uint8_t v: 1;
-	uint8_t age: 2;
-	uint32_t tag: 22;
-	word_t line[L1_ICACHE_WORDS_PER_LINE];
-
-} l1_dcache_entry_t;
+/**
+ * @brief Run-time geometry and replacement policy of one cache.
+ *
+ * lines and words_per_line must be powers of 2.
+ */
+typedef struct
+{
+	uint16_t lines;         // number of sets
+	uint8_t ways;           // associativity, at most CACHE_MAX_WAYS
+	uint8_t words_per_line; // at most CACHE_MAX_WORDS_PER_LINE
+	cache_replace_t replace;
+	uint32_t seed;          // of the RANDOM and BRRIP generator, 0 for a fixed default
+	uint8_t write_back;     // 1 for write-back, 0 for write-through (the policy of L1 rules a hierarchy)
+	cache_inclusion_t inclusion; // with respect to the inner caches (the policy of L2 rules a hierarchy)
+	uint8_t slices;         // a power of 2, at most CACHE_MAX_SLICES (0 is as 1: not sliced)
+	cache_prefetch_config_t prefetch;
+} cache_config_t;
+
+#define L1_ICACHE_CONFIG ((cache_config_t) { L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_WORDS_PER_LINE, LRU, 0, 0, EXCLUSIVE, 1, { NO_PREFETCH, 0, 0 } })
+#define L1_DCACHE_CONFIG ((cache_config_t) { L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_WORDS_PER_LINE, LRU, 0, 0, EXCLUSIVE, 1, { NO_PREFETCH, 0, 0 } })
+#define L2_CACHE_CONFIG  ((cache_config_t) { L2_CACHE_LINES,  L2_CACHE_WAYS,  L2_CACHE_WORDS_PER_LINE, LRU, 0, 0, EXCLUSIVE, 1, { NO_PREFETCH, 0, 0 } })
+#define L3_CACHE_CONFIG  ((cache_config_t) { L3_CACHE_LINES,  L3_CACHE_WAYS,  L3_CACHE_WORDS_PER_LINE, LRU, 0, 0, INCLUSIVE, L3_CACHE_SLICES, { NO_PREFETCH, 0, 0 } })
 
+/**
+ * @brief A cache entry outside of any cache, large enough for any geometry.
+ * Used to stage a line that moves between memory, L1 and L2.
+ */
 typedef struct
 {
+	uint32_t tag;
+	uint8_t v;
+	uint8_t age;
+	uint8_t dirty; // changed since read from memory (write-back only)
+	word_t line[CACHE_MAX_WORDS_PER_LINE];
+
+} cache_entry_t;
+
+/*
+ * In the tag store, a valid entry holds its tag with CACHE_TAG_VALID set
+ * and an invalid one holds 0, so that one compare against
+ * (tag | CACHE_TAG_VALID) checks validity and tag at once.
+ * Tags are at most 28 bits wide (at least 4 bits select the byte in the line).
+ */
+#define CACHE_TAG_VALID 0x80000000u
+#define CACHE_TAG_MASK  (CACHE_TAG_VALID - 1u)
 
-	uint8_t v: 1;
-	uint8_t age: 3;
-	uint32_t tag: 19;
-	word_t line[L2_CACHE_WORDS_PER_LINE];
+/*
+ * At most that many inner caches (L2, L1 ICACHE and L1 DCACHE) are
+ * back-invalidated by a cache (see cache_attach_inner()).
+ */
+#define CACHE_MAX_INNER 3u
+
+/*
+ * Slice selection (see cache_slice_of()): bit i of the slice of a line is
+ * the parity of the bits of its address selected by CACHE_SLICE_HASH_i.
+ * These are the hash functions of Intel Core processors with 2, 4 and 8
+ * slices (Maurice et al., "Reverse Engineering Intel Last-Level Cache
+ * Complex Addressing Using Performance Counters", RAID 2015), restricted
+ * to 32-bit addresses; they only read bits above a 64-byte line.
+ */
+#define CACHE_MAX_SLICES   8u
+#define CACHE_SLICE_HASH_0 0x5F575440u
+#define CACHE_SLICE_HASH_1 0xB5FAA880u
+#define CACHE_SLICE_HASH_2 0xCCC93100u
+
+/*
+ * Each line of the tag store is padded to a multiple of this number of
+ * ways, the width of the vector compare of a line (see cache_hit()).
+ */
+#define CACHE_TAG_GROUP 4u
 
-} l2_cache_entry_t;
+struct cache_policy; // see cache_replace.h
+struct cache_prefetch_state; // see cache_prefetch.h
 
-typedef enum
+/**
+ * @brief One cache: its geometry and its entries.
+ * The fields after config are derived from it by cache_init().
+ *
+ * Entries are stored as a structure of arrays so that the lookup of a
+ * line only reads its row of tags (one host cache line for up to 16 ways);
+ * line data and replacement state are only touched once the way is known.
+ */
+typedef struct cache_level
 {
-	L1_ICACHE, L1_DCACHE, L2_CACHE
-} cache_t;
+	cache_t type;
+	cache_config_t config;
+	uint8_t line_bits;  // log_2 of the line size in bytes
+	uint8_t index_bits; // log_2 of the lines of a slice (config.lines if not sliced)
+	uint8_t slice_bits; // log_2(config.slices), 0 if not sliced
+	uint8_t tag_shift;  // line_bits + index_bits, i.e. the bits below the tag
+	uint8_t tag_ways;   // config.ways rounded up to CACHE_TAG_GROUP
+	const struct cache_policy * policy; // the functions of config.replace
+	uint64_t rng;       // state of the RANDOM and BRRIP generator
+	uint32_t * tags;    // config.lines rows of tag_ways tags; owns the whole storage
+	word_t * data;      // config.lines * config.ways lines, line after line
+	uint16_t * bits;    // config.lines PLRU bits (one per way or per tree node)
+	uint8_t * ages;     // config.lines * config.ways ages (LRU, FIFO) or RRPVs (RRIP)
+	uint8_t * dirty;    // config.lines * config.ways dirty bits (write-back only)
+	uint8_t * prefetched; // config.lines * config.ways tags: brought in by a prefetch, not used yet
+	struct cache_prefetch_state * prefetch; // state of config.prefetch, NULL if none
+	level_stats_t stats; // counted by cache_read/cache_write and friends
+	struct cache_level * inner[CACHE_MAX_INNER]; // back-invalidated by an inclusive cache, NULL if none
+	struct cache_level * next; // the level below (L3 for L2), NULL for memory
+	cache_t served;     // the level that served the last demand access to this L1 cache (latency models)
+
+} cache_level_t;
 
 // --------------------------------------------------
-#define cache_cast(TYPE) ((TYPE *)cache)
+#define cache_slot(CACHE, LINE_INDEX, WAY) \
+        ((size_t) (LINE_INDEX) * (CACHE)->config.ways + (WAY))
 
 // --------------------------------------------------
-#define cache_entry(TYPE, WAYS, LINE_INDEX, WAY) \
-        (cache_cast(TYPE) + (LINE_INDEX) * (WAYS) + (WAY))
+#define cache_tags(CACHE, LINE_INDEX) \
+        ((CACHE)->tags + (size_t) (LINE_INDEX) * (CACHE)->tag_ways)
 
 // --------------------------------------------------
-#define cache_valid(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->v
+#define cache_valid(CACHE, LINE_INDEX, WAY) \
+        ((uint8_t) (cache_tags(CACHE, LINE_INDEX)[WAY] >> 31))
 
 // --------------------------------------------------
-#define cache_age(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->age
+#define cache_invalidate(CACHE, LINE_INDEX, WAY) \
+        (cache_tags(CACHE, LINE_INDEX)[WAY] = 0)
 
 // --------------------------------------------------
-#define cache_tag(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->tag
+#define cache_age(CACHE, LINE_INDEX, WAY) \
+        (CACHE)->ages[cache_slot(CACHE, LINE_INDEX, WAY)]
 
 // --------------------------------------------------
-#define cache_line(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->line
-
-
-#define hit_L2(TYPE,LINES,TYPE2,WAYS)\
-TYPE *  newentry = malloc(sizeof(TYPE));\
-M_REQUIRE_NON_NULL(newentry);\
-newentry->tag = new_tag;\
-M_REQUIRE(index_from_l2_to_l1(l2_cache, newentry, cache_type , hit_way, indexl2) == 0, ERR_BAD_PARAMETER, " ");\
-cache_valid(l2_cache_entry_t, L2_CACHE_LINES, indexl2, hit_way) = INVALID;\
-uint8_t nway = find_place(l1_cache, cache_type, line_1);/*   if there is a cold start nway != HIT_WAY_MISS so insert then age increase else apply the lru */\
-if ( nway != HIT_WAY_MISS )\
-{\
-M_REQUIRE(cache_insert(line_1, nway, newentry, l1_cache, cache_type) == ERR_NONE, ERR_BAD_PARAMETER, " ");\
-LRU_age_increase(TYPE, WAYS, nway, line_1);\
-}\
-else\
-{/* if there is no place in L1 we need to evict an entry and put it in the L2 cache*/\
-uint8_t waydel = apply_lru(l1_cache, TYPE2, line_1);\
-TYPE  old_entry = *cache_entry(TYPE, LINES, line_1, waydel);\
-cache_insert(line_1, waydel, newentry, l1_cache, TYPE2 );\
-LRU_age_update(TYPE, WAYS, waydel, line_1);\
-uint8_t l2way = find_place(l2_cache, L2_CACHE, indexl2);\
-*word = cache_line(TYPE, WAYS, line_1, waydel)[word_select];\
-cache = l2_cache; /* when inserting in the l2 if there is a cold start directly insert  into the l2 else search with the LRU*/\
-if (l2way != HIT_WAY_MISS)\
-{\
-cache_insert(indexl2, l2way, &old_entry, l2_cache, L2_CACHE );\
-LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, l2way, indexl2 );\
-}\
-else\
-{\
-uint8_t waydel = apply_lru(l2_cache, L2_CACHE, indexl2);\
-M_REQUIRE(cache_insert(indexl2, waydel, &old_entry, l2_cache, L2_CACHE ) == ERR_NONE, ERR_BAD_PARAMETER, " ");\
-LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, waydel, indexl2);\
-}\
-}\
-
-
-#define not_hit_L1_or_L2(TYPE,WAYS,TYPE2)\
-TYPE* newentry = malloc(sizeof(TYPE));\
-M_REQUIRE_NON_NULL(newentry);\
-cache_entry_init(mem_space, paddr, newentry, TYPE2); \
-uint8_t nway = find_place(l1_cache, TYPE2, line_1);/* search in the l1 cache if there is an invalid entry, if there is insert at this place*/\
-if (nway == HIT_WAY_MISS)/* if there is no valid place then search with the LRU policy*/\
-	{\
-		nway = apply_lru(l1_cache, cache_type, line_1); \
-	}\
-cache_insert(line_1, nway, newentry, l1_cache, TYPE2 );/* insert the entry at the right way in the l1 */\
-LRU_age_update(TYPE, WAYS, nway, line_1); \
-*word = cache_line(TYPE, WAYS, line_1, nway)[word_select];/* assign the word*/\
-
-
-#define find_place_(TYPE,WAYS)/* find  an invalid entry*/\
-foreach_way(i, WAYS)\
-{\
-if (cache_valid(TYPE, WAYS, line_index, i) == 0)\
-{\
-return i;\
-}\
-}\
-
-
-#define index_from_l2_to_l1_(TYPE,WORDS)/* assign the line of the entry in l2 to the line of the entry in the l1 cache and make L1 entry valid */\
-for (int i = 0; i < WORDS; ++i )\
-{\
-((TYPE *)entry)->line[i] = cache_line(l2_cache_entry_t, L2_CACHE_LINES, index, way)[i];\
-}\
-((TYPE *)entry)->v = VALID;\
-
-
-#define lru(TYPE,WAYS)\
-foreach_way(i, WAYS)\
-			{\
-				if (cache_age(TYPE, WAYS, line_index, i) >= max_age)\
-					{\
-						max_age = cache_age(TYPE, WAYS, line_index, i);\
-						way = i;\
-					}\
-			}\
-
-
-
-
-#define hit(TYPE,LINES,BITS,WAYS)/* macro for the hit*/\
-line_index = (phy_addr_t_to_uint32_t(paddr) / 16) % LINES;\
-tag = phy_addr_t_to_uint32_t(paddr) >> BITS ;\
-foreach_way(i, WAYS){/* if there is an invalid entry this is a miss*/\
-if (cache_valid(TYPE, WAYS, line_index, i) == INVALID){\
-*hit_way = HIT_WAY_MISS; \
-*hit_index = HIT_INDEX_MISS; \
-return ERR_NONE; }/* if there is an entry whose tag matches that of the physical address and is valid then we hit, assign the way of the hit to hit_way*/\
-if (cache_valid(TYPE, WAYS, line_index, i)==VALID && tag == cache_tag(TYPE, WAYS, line_index, i)){\
-*hit_way = i; \
-*hit_index = line_index; \
-*p_line = cache_line(TYPE, WAYS,  line_index, i ); \
-LRU_age_update(TYPE, WAYS, *hit_way, *hit_index); \
-return ERR_NONE;}}\
-*hit_way = HIT_WAY_MISS;\
-*hit_index = HIT_INDEX_MISS;\
-return 0;
-
-
-#define insert(TYPE,LINES,WAYS,WORDS)/* insert a line in a given cache assign the values of the entry in the cache to be those of the entry*/\
-if (cache_line_index >= LINES || cache_way >= WAYS)\
-return ERR_NONE;\
-(memcpy(cache_line(TYPE, WAYS, cache_line_index, cache_way), (*(TYPE*)cache_line_in).line, WORDS * sizeof(word_t)));\
-cache_valid(TYPE, WAYS, cache_line_index, cache_way) = (*(TYPE*)cache_line_in).v;\
-cache_age(TYPE, WAYS, cache_line_index, cache_way) = (*(TYPE*)cache_line_in).age;\
-cache_tag(TYPE, WAYS, cache_line_index, cache_way) = (*(TYPE*)cache_line_in).tag;\
-
-
-
-#define flush(TYPE,WAYS,LINES,WORDS)/*   put all the values to 0*/\
-for (i = 0; i < WAYS * LINES; ++i)\
-((TYPE*)cache)[i].v = INVALID;\
-((TYPE*)cache)[i].tag = 0;\
-((TYPE*)cache)[i].age = 0;\
-(memset(((TYPE *)cache)->line, 0, WORDS * sizeof(word_t)))\
-
-
-#define cache_init(TYPE,BITS) /* initialise the entry put the validity bit to 1, age to 0, assign the tag with the tag in the physical address and for the line assign with the values found in the memory*/\
-tag = phy_addr_t_to_uint32_t(paddr) >> BITS;\
-((TYPE*)cache_entry)->v = VALID;\
-((TYPE *)cache_entry)->age = 0;\
-((TYPE *)cache_entry)->tag = tag;\
-(memcpy(((TYPE *)cache_entry)->line, mem_space + phy_addr_t_to_uint32_t(paddr), 4 * sizeof(word_t)));\
+#define cache_dirty(CACHE, LINE_INDEX, WAY) \
+        (CACHE)->dirty[cache_slot(CACHE, LINE_INDEX, WAY)]
 
+// --------------------------------------------------
+#define cache_prefetched(CACHE, LINE_INDEX, WAY) \
+        (CACHE)->prefetched[cache_slot(CACHE, LINE_INDEX, WAY)]
 
+// --------------------------------------------------
+#define cache_bits(CACHE, LINE_INDEX) \
+        (CACHE)->bits[LINE_INDEX]
+
+// --------------------------------------------------
+#define cache_tag(CACHE, LINE_INDEX, WAY) \
+        (cache_tags(CACHE, LINE_INDEX)[WAY] & CACHE_TAG_MASK)
+
+// --------------------------------------------------
+#define cache_line(CACHE, LINE_INDEX, WAY) \
+        ((CACHE)->data + cache_slot(CACHE, LINE_INDEX, WAY) * (CACHE)->config.words_per_line)
+
+// --------------------------------------------------
+#define cache_line_bytes(CACHE) \
+        ((size_t) (CACHE)->config.words_per_line * sizeof(word_t))
+
+// --------------------------------------------------
+#define cache_slice_of(CACHE, ADDR) \
+        (((uint32_t) __builtin_parity((ADDR) & CACHE_SLICE_HASH_0) \
+          | (uint32_t) __builtin_parity((ADDR) & CACHE_SLICE_HASH_1) << 1 \
+          | (uint32_t) __builtin_parity((ADDR) & CACHE_SLICE_HASH_2) << 2) & ((1u << (CACHE)->slice_bits) - 1u))
+
+// --------------------------------------------------
+#define cache_index_in_slice_of(CACHE, ADDR) \
+        (((ADDR) >> (CACHE)->line_bits) & ((1u << (CACHE)->index_bits) - 1u))
+
+// --------------------------------------------------
+/* the lines of slice s are the lines s << index_bits and up */
+#define cache_index_of(CACHE, ADDR) \
+        ((CACHE)->slice_bits == 0 ? cache_index_in_slice_of(CACHE, ADDR) \
+         : cache_slice_of(CACHE, ADDR) << (CACHE)->index_bits | cache_index_in_slice_of(CACHE, ADDR))
+
+// --------------------------------------------------
+#define cache_tag_of(CACHE, ADDR) \
+        ((uint32_t) ((uint64_t) (ADDR) >> (CACHE)->tag_shift))
 
+// --------------------------------------------------
+#define cache_addr_of(CACHE, TAG, LINE_INDEX) /* first byte of the line */ \
+        ((uint32_t) (((uint64_t) (TAG) << (CACHE)->tag_shift) \
+                     | (((uint32_t) (LINE_INDEX) & ((1u << (CACHE)->index_bits) - 1u)) << (CACHE)->line_bits)))
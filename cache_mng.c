@@ -1,11 +1,18 @@
-#pragma once
-
 #include "cache_mng.h"
 #include "error.h"
 #include "addr_mng.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h> // memcpy
+#include <inttypes.h> // PRIx macros
+#include "util.h" // zero_init_var
 #include "lru.h"
+#include "cache_replace.h"
+#include "cache_prefetch.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #define bits_in_a_byte 8
 
@@ -22,62 +29,48 @@ uint32_t phy_addr_t_to_uint32_t(const phy_addr_t * paddr)
 
 
 //=========================================================================
-#define PRINT_CACHE_LINE(OUTFILE, TYPE, WAYS, LINE_INDEX, WAY, WORDS_PER_LINE) \
+#define PRINT_CACHE_LINE(OUTFILE, CACHE, LINE_INDEX, WAY) \
     do { \
-            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: %1" PRIx8 ", TAG: 0x%03" PRIx16 ", values: ( ", \
-                        cache_valid(TYPE, WAYS, LINE_INDEX, WAY), \
-                        cache_age(TYPE, WAYS, LINE_INDEX, WAY), \
-                        cache_tag(TYPE, WAYS, LINE_INDEX, WAY)); \
-            for(int i_ = 0; i_ < WORDS_PER_LINE; i_++) \
+            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: %1" PRIx8 ", TAG: 0x%03" PRIx32 ", values: ( ", \
+                        cache_valid(CACHE, LINE_INDEX, WAY), \
+                        (CACHE)->policy->state(CACHE, LINE_INDEX, WAY), \
+                        cache_tag(CACHE, LINE_INDEX, WAY)); \
+            for(int i_ = 0; i_ < (CACHE)->config.words_per_line; i_++) \
                 fprintf(OUTFILE, "0x%08" PRIx32 " ", \
-                        cache_line(TYPE, WAYS, LINE_INDEX, WAY)[i_]); \
+                        cache_line(CACHE, LINE_INDEX, WAY)[i_]); \
             fputs(")\n", OUTFILE); \
     } while(0)
 
-#define PRINT_INVALID_CACHE_LINE(OUTFILE, TYPE, WAYS, LINE_INDEX, WAY, WORDS_PER_LINE) \
-    do { \
-            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: -, TAG: -----, values: ( ---------- ---------- ---------- ---------- )\n", \
-                        cache_valid(TYPE, WAYS, LINE_INDEX, WAY)); \
-    } while(0)
-
-#define DUMP_CACHE_TYPE(OUTFILE, TYPE, WAYS, LINES, WORDS_PER_LINE)  \
+#define PRINT_INVALID_CACHE_LINE(OUTFILE, CACHE, LINE_INDEX, WAY) \
     do { \
-        for(uint16_t index = 0; index < LINES; index++) { \
-            foreach_way(way, WAYS) { \
-                fprintf(output, "%02" PRIx8 "/%04" PRIx16 ": ", way, index); \
-                if(cache_valid(TYPE, WAYS, index, way)) \
-                    PRINT_CACHE_LINE(OUTFILE, const TYPE, WAYS, index, way, WORDS_PER_LINE); \
-                else \
-                    PRINT_INVALID_CACHE_LINE(OUTFILE, const TYPE, WAYS, index, way, WORDS_PER_LINE);\
-            } \
-        } \
+            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: -, TAG: -----, values: ( ", \
+                        cache_valid(CACHE, LINE_INDEX, WAY)); \
+            for(int i_ = 0; i_ < (CACHE)->config.words_per_line; i_++) \
+                fputs("---------- ", OUTFILE); \
+            fputs(")\n", OUTFILE); \
     } while(0)
 
 //=========================================================================
 // see cache_mng.h
-int cache_dump(FILE* output, const void* cache, cache_t cache_type)
+int cache_dump(FILE* output, const cache_level_t * cache)
 {
 	M_REQUIRE_NON_NULL(output);
 	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(cache->tags);
 
 	fputs("WAY/LINE: V: AGE: TAG: WORDS\n", output);
-	switch (cache_type)
+	for (uint16_t index = 0; index < cache->config.lines; index++)
 		{
-		case L1_ICACHE:
-			DUMP_CACHE_TYPE(output, l1_icache_entry_t, L1_ICACHE_WAYS,
-			                L1_ICACHE_LINES, L1_ICACHE_WORDS_PER_LINE);
-			break;
-		case L1_DCACHE:
-			DUMP_CACHE_TYPE(output, l1_dcache_entry_t, L1_DCACHE_WAYS,
-			                L1_DCACHE_LINES, L1_DCACHE_WORDS_PER_LINE);
-			break;
-		case L2_CACHE:
-			DUMP_CACHE_TYPE(output, l2_cache_entry_t, L2_CACHE_WAYS,
-			                L2_CACHE_LINES, L2_CACHE_WORDS_PER_LINE);
-			break;
-		default:
-			debug_print("%d: unknown cache type", cache_type);
-			return ERR_BAD_PARAMETER;
+			if (cache->slice_bits > 0 && (index & ((1u << cache->index_bits) - 1u)) == 0)
+				fprintf(output, "SLICE %u\n", (unsigned) index >> cache->index_bits);
+			foreach_way(way, cache->config.ways)
+			{
+				fprintf(output, "%02" PRIx8 "/%04" PRIx16 ": ", way, index);
+				if (cache_valid(cache, index, way))
+					PRINT_CACHE_LINE(output, cache, index, way);
+				else
+					PRINT_INVALID_CACHE_LINE(output, cache, index, way);
+			}
 		}
 	putc('\n', output);
 
@@ -85,100 +78,263 @@ int cache_dump(FILE* output, const void* cache, cache_t cache_type)
 }
 
 
+static const char * const cache_names[] =
+{
+	[L1_ICACHE] = "L1_ICACHE",
+	[L1_DCACHE] = "L1_DCACHE",
+	[L2_CACHE]  = "L2_CACHE",
+	[L3_CACHE]  = "L3_CACHE",
+};
+
+//=========================================================================
+// see cache_mng.h
+int cache_stats_print(FILE* output, stats_format_t format, const cache_level_t * cache)
+{
+	M_REQUIRE_NON_NULL(cache);
+	return stats_print(output, format, cache_names[cache->type], &cache->stats);
+}
+
+
+#define CACHE_STORAGE_ALIGN 64 // a host cache line
+
+#define CACHE_DEFAULT_SEED 0x2545F4914F6CDD1Dull
+
+/**
+ * @brief size of the storage of a cache (tags, data, bits, ages, dirty and prefetched tags), rounded
+ * up to a multiple of CACHE_STORAGE_ALIGN as aligned_alloc() requires
+ */
+static size_t cache_storage_size(const cache_level_t * cache)
+{
+	const size_t entries = (size_t) cache->config.lines * cache->config.ways;
+	const size_t size = (size_t) cache->config.lines * cache->tag_ways * sizeof(uint32_t)
+	                    + entries * cache_line_bytes(cache)
+	                    + (size_t) cache->config.lines * sizeof(uint16_t)
+	                    + 3 * entries * sizeof(uint8_t);
+	return (size + CACHE_STORAGE_ALIGN - 1) / CACHE_STORAGE_ALIGN * CACHE_STORAGE_ALIGN;
+}
+
+
+/**
+ * @brief log_2 of a power of 2, -1 if x is not a (non zero) power of 2
+ */
+static int log2_exact(uint32_t x)
+{
+	if (x == 0 || (x & (x - 1)) != 0) return -1;
+	int bits = 0;
+	while (x >>= 1) ++bits;
+	return bits;
+}
+
+
+int cache_init(cache_level_t * cache, cache_t cache_type, const cache_config_t * config)
+{
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(config);
+	M_REQUIRE(cache_type == L1_ICACHE || cache_type == L1_DCACHE || cache_type == L2_CACHE || cache_type == L3_CACHE,
+	          ERR_BAD_PARAMETER, "%d: unknown cache type", cache_type);
+
+	const int index_bits = log2_exact(config->lines);
+	const int word_bits = log2_exact(config->words_per_line);
+	M_REQUIRE(index_bits >= 0 && config->lines <= CACHE_MAX_LINES, ERR_SIZE,
+	          "%" PRIu16 " lines: must be a power of 2 <= %u", config->lines, CACHE_MAX_LINES);
+	M_REQUIRE(word_bits >= 0 && config->words_per_line <= CACHE_MAX_WORDS_PER_LINE, ERR_SIZE,
+	          "%" PRIu8 " words per line: must be a power of 2 <= %u", config->words_per_line, CACHE_MAX_WORDS_PER_LINE);
+	const int slice_bits = log2_exact(config->slices == 0 ? 1u : config->slices);
+	M_REQUIRE(slice_bits >= 0 && config->slices <= CACHE_MAX_SLICES && slice_bits <= index_bits, ERR_SIZE,
+	          "%" PRIu8 " slices: must be a power of 2 <= %u and <= lines", config->slices, CACHE_MAX_SLICES);
+	M_REQUIRE(config->ways >= 1 && config->ways <= CACHE_MAX_WAYS, ERR_SIZE,
+	          "%" PRIu8 " ways: must be in [1, %u]", config->ways, CACHE_MAX_WAYS);
+	const cache_policy_t * policy = cache_policy_of(config->replace);
+	M_REQUIRE(policy != NULL, ERR_POLICY, "%d: unknown replacement policy", config->replace);
+	M_REQUIRE(config->replace != TREE_PLRU || log2_exact(config->ways) >= 0, ERR_POLICY,
+	          "%" PRIu8 " ways: tree-PLRU needs a power of 2", config->ways);
+
+	zero_init_ptr(cache);
+	cache->type = cache_type;
+	cache->config = *config;
+	cache->policy = policy;
+	cache->rng = config->seed != 0 ? config->seed : CACHE_DEFAULT_SEED;
+	cache->line_bits = (uint8_t) (word_bits + 2); // 4 bytes per word
+	cache->index_bits = (uint8_t) (index_bits - slice_bits);
+	cache->slice_bits = (uint8_t) slice_bits;
+	cache->tag_shift = (uint8_t) (cache->line_bits + cache->index_bits);
+	M_REQUIRE(cache->tag_shift < PHY_ADDR, ERR_SIZE, "%s", "no bit left for the tag");
+	cache->tag_ways = (uint8_t) ((config->ways + CACHE_TAG_GROUP - 1) / CACHE_TAG_GROUP * CACHE_TAG_GROUP);
+
+	// one block: tags first, so that rows of tags are aligned on host cache lines
+	const size_t size = cache_storage_size(cache);
+	cache->tags = aligned_alloc(CACHE_STORAGE_ALIGN, size);
+	M_EXIT_IF_NULL(cache->tags, size);
+	memset(cache->tags, 0, size);
+	cache->data = (word_t *) (cache->tags + (size_t) config->lines * cache->tag_ways);
+	cache->bits = (uint16_t *) (cache->data + (size_t) config->lines * config->ways * config->words_per_line);
+	cache->ages = (uint8_t *) (cache->bits + config->lines);
+	cache->dirty = cache->ages + (size_t) config->lines * config->ways;
+	cache->prefetched = cache->dirty + (size_t) config->lines * config->ways;
+
+	const int err = cache_prefetch_init(cache);
+	if (err != ERR_NONE) cache_free(cache);
+	return err;
+}
+
+
+void cache_free(cache_level_t * cache)
+{
+	if (cache != NULL)
+		{
+			free(cache->tags);
+			cache->tags = NULL;
+			cache->data = NULL;
+			cache->bits = NULL;
+			cache->ages = NULL;
+			cache->dirty = NULL;
+			cache->prefetched = NULL;
+			cache_prefetch_free(cache);
+		}
+}
+
+
 int cache_entry_init(const void * mem_space,
                      const phy_addr_t * paddr,
-                     void * cache_entry,
-                     cache_t cache_type)
+                     cache_entry_t * cache_entry,
+                     const cache_level_t * cache)
 {
 
 	M_REQUIRE_NON_NULL(mem_space);//check validity of arguments
 	M_REQUIRE_NON_NULL(paddr);
 	M_REQUIRE_NON_NULL(cache_entry);
-	M_REQUIRE(phy_addr_t_to_uint32_t(paddr) % (4 * sizeof(word_t)) == 0, ERR_BAD_PARAMETER, "Wrong physical address");
-	uint32_t tag = 0;
+	M_REQUIRE_NON_NULL(cache);
+	const uint32_t addr = phy_addr_t_to_uint32_t(paddr);
+	M_REQUIRE(addr % cache_line_bytes(cache) == 0, ERR_BAD_PARAMETER, "%s", "Wrong physical address");
 
-	switch (cache_type)
-		{
-		case L1_ICACHE:
-			cache_init(l1_icache_entry_t, L1_ICACHE_TAG_REMAINING_BITS);
-			return ERR_NONE;
-		case L1_DCACHE:
-			cache_init(l1_dcache_entry_t, L1_DCACHE_TAG_REMAINING_BITS);
-			return ERR_NONE;
-		case L2_CACHE:
-			cache_init(l2_cache_entry_t, L2_CACHE_TAG_REMAINING_BITS);
-			return ERR_NONE;
-		default:
-			return ERR_BAD_PARAMETER;
-		}
+	// initialise the entry: valid, age 0, clean, tag of the physical address and line read from memory
+	cache_entry->v = VALID;
+	cache_entry->age = 0;
+	cache_entry->dirty = 0;
+	cache_entry->tag = cache_tag_of(cache, addr);
+	memcpy(cache_entry->line, (const uint8_t *) mem_space + addr, cache_line_bytes(cache));
 
-	return 0;
+	return ERR_NONE;
 }
 
 
-int cache_flush(void *cache, cache_t cache_type)
+int cache_flush(cache_level_t * cache)
 {
 	M_REQUIRE_NON_NULL(cache);//check validity of arguments
-	int i;
-
-	switch (cache_type)
-		{
-		case L1_ICACHE:
-			flush(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE_LINES, L1_ICACHE_WORDS_PER_LINE);
-			return ERR_NONE;
-		case L1_DCACHE:
-			flush(l1_dcache_entry_t, L1_DCACHE_WAYS, L1_DCACHE_LINES, L1_DCACHE_WORDS_PER_LINE);
-			return ERR_NONE;
-		case L2_CACHE:
-			flush(l2_cache_entry_t, L2_CACHE_WAYS, L2_CACHE_LINES, L2_CACHE_WORDS_PER_LINE);
-			return ERR_NONE;
-		default:
-			return ERR_BAD_PARAMETER;
-		}
+	M_REQUIRE_NON_NULL(cache->tags);
 
+	// put all the values to 0 (a tag of 0 is an invalid entry)
+	memset(cache->tags, 0, cache_storage_size(cache));
+	cache->rng = cache->config.seed != 0 ? cache->config.seed : CACHE_DEFAULT_SEED;
+	cache_prefetch_reset(cache);
 
+	return ERR_NONE;
 }
 
 
+/**
+ * @brief copies a whole line; the constant size of the default geometry
+ * lets the compiler inline the copy.
+ */
+#define line_copy(DST, SRC, CACHE) \
+	do { \
+		if ((CACHE)->config.words_per_line == L1_ICACHE_WORDS_PER_LINE) \
+			memcpy(DST, SRC, L1_ICACHE_WORDS_PER_LINE * sizeof(word_t)); \
+		else \
+			memcpy(DST, SRC, cache_line_bytes(CACHE)); \
+	} while (0)
+
 
 int cache_insert(uint16_t cache_line_index,
                  uint8_t cache_way,
-                 const void * cache_line_in,
-                 void * cache,
-                 cache_t cache_type)
+                 const cache_entry_t * cache_line_in,
+                 cache_level_t * cache)
 {
 
 	M_REQUIRE_NON_NULL(cache_line_in);//check validity of arguments
 	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE(cache_line_index < cache->config.lines && cache_way < cache->config.ways,
+	          ERR_BAD_PARAMETER, "%" PRIu8 "/%" PRIu16 ": out of the cache", cache_way, cache_line_index);
 
-	switch (cache_type)
-		{
-		case L1_ICACHE:
-			insert(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_WORDS_PER_LINE);
-			return ERR_NONE;
+	// insert a line: the values of the entry in the cache become those of the given entry
+	line_copy(cache_line(cache, cache_line_index, cache_way), cache_line_in->line, cache);
+	cache_age(cache, cache_line_index, cache_way) = cache_line_in->age;
+	cache_dirty(cache, cache_line_index, cache_way) = cache_line_in->dirty;
+	cache_prefetched(cache, cache_line_index, cache_way) = 0;
+	cache_tags(cache, cache_line_index)[cache_way] =
+	    cache_line_in->v == VALID ? (cache_line_in->tag & CACHE_TAG_MASK) | CACHE_TAG_VALID : 0;
 
-		case L1_DCACHE:
-			insert(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_WORDS_PER_LINE);
-			return ERR_NONE;
+	return ERR_NONE;
+}
 
-		case L2_CACHE:
-			insert(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_WORDS_PER_LINE);
-			return ERR_NONE;
 
-		default:
-			return ERR_BAD_PARAMETER;
+/**
+ * @brief Compares key with a whole row of tags.
+ * @param tags the row of tags of a line
+ * @param key the value looked for
+ * @param tag_ways the length of the row, a multiple of CACHE_TAG_GROUP
+ * @return the mask of the ways holding key (bit i for way i)
+ */
+static inline uint32_t tag_match(const uint32_t * tags, uint32_t key, uint8_t tag_ways)
+{
+	uint32_t mask = 0;
+	uint8_t w = 0;
+#if defined(__AVX2__)
+	const __m256i key8 = _mm256_set1_epi32((int) key);
+	for (; w + 8 <= tag_ways; w += 8)
+		{
+			const __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *) (tags + w)), key8);
+			mask |= (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(eq)) << w;
+		}
+#endif
+#if defined(__SSE2__)
+	const __m128i key4 = _mm_set1_epi32((int) key);
+	for (; w < tag_ways; w += 4)
+		{
+			const __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (tags + w)), key4);
+			mask |= (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(eq)) << w;
 		}
+#else
+	for (; w < tag_ways; ++w)
+		mask |= (uint32_t) (tags[w] == key) << w;
+#endif
+	return mask;
 }
 
 
+/*
+ * Lookup kernel: one vector compare of the tag (with its valid bit) against
+ * the row of tags of the line. Instantiated with a constant WAYS for the
+ * default geometries so that the compare and the LRU update (the default
+ * policy, inlined) are unrolled, and with the run-time associativity
+ * otherwise. A tag is in at most one way, and padding ways (tag 0) never
+ * match.
+ */
+#define hit(WAYS, TAG_WAYS)\
+{\
+const uint32_t mask = tag_match(cache_tags(cache, line_index), tag | CACHE_TAG_VALID, TAG_WAYS);\
+if (mask != 0)\
+{\
+const uint8_t way = (uint8_t) __builtin_ctz(mask);\
+*hit_way = way;\
+*hit_index = line_index;\
+*p_line = cache_line(cache, line_index, way);\
+if (cache->config.replace == LRU)\
+LRU_age_update(cache, WAYS, way, line_index);\
+else \
+cache->policy->hit(cache, line_index, way);\
+return ERR_NONE;\
+}\
+}\
+break;
+
 
 int cache_hit (const void * mem_space,
-               void * cache,
+               cache_level_t * cache,
                phy_addr_t * paddr,
                const uint32_t ** p_line,
                uint8_t *hit_way,
-               uint16_t *hit_index,
-               cache_t cache_type)
+               uint16_t *hit_index)
 {
 
 	M_REQUIRE_NON_NULL(mem_space);//check validity of arguments
@@ -188,382 +344,567 @@ int cache_hit (const void * mem_space,
 	M_REQUIRE_NON_NULL(hit_way);
 	M_REQUIRE_NON_NULL(hit_index);
 
+	const uint32_t addr = phy_addr_t_to_uint32_t(paddr);
+	const uint16_t line_index = (uint16_t) cache_index_of(cache, addr);
+	const uint32_t tag = cache_tag_of(cache, addr);
 
-	uint32_t line_index = 0;
-	uint32_t tag = 0;
-	switch (cache_type)
+	switch (cache->config.ways)
 		{
-		case L1_ICACHE:
-			hit(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_TAG_REMAINING_BITS, L1_ICACHE_WAYS);
-		case L1_DCACHE:
-			hit(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE_TAG_REMAINING_BITS, L1_DCACHE_WAYS);
-		case L2_CACHE:
-			hit(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_TAG_REMAINING_BITS, L2_CACHE_WAYS);
+		case L1_ICACHE_WAYS:
+			hit(L1_ICACHE_WAYS, L1_ICACHE_WAYS);
+		case L2_CACHE_WAYS:
+			hit(L2_CACHE_WAYS, L2_CACHE_WAYS);
 		default:
-			return 0;
+			hit(cache->config.ways, cache->tag_ways);
 		}
-}
-
-int index_from_l2_to_l1(void * cache, void * entry,  cache_t cache_type, uint8_t way, uint16_t index )
-{
 
-	switch (cache_type)
-		{
-		case L1_ICACHE :
-			index_from_l2_to_l1_(l1_icache_entry_t, L1_ICACHE_WORDS_PER_LINE);
-			break;
-
-		case L1_DCACHE:
-			index_from_l2_to_l1_(l1_dcache_entry_t, L1_DCACHE_WORDS_PER_LINE);
-			break;
-		default :
-			return ERR_BAD_PARAMETER;
-		}
+	*hit_way = HIT_WAY_MISS;
+	*hit_index = HIT_INDEX_MISS;
 	return ERR_NONE;
-
 }
 
 
-uint8_t apply_lru(void* cache , cache_t type , uint32_t line_index)
+/**
+ * @brief the way of the first invalid entry of a line, HIT_WAY_MISS if all are valid
+ */
+static uint8_t find_place(const cache_level_t * cache, uint16_t line_index)
 {
+	// invalid entries hold a tag of 0; padding ways are not candidates
+	const uint32_t mask = tag_match(cache_tags(cache, line_index), 0, cache->tag_ways)
+	                      & (uint32_t) ((1ul << cache->config.ways) - 1);
+	return mask != 0 ? (uint8_t) __builtin_ctz(mask) : HIT_WAY_MISS;
+}
 
-	uint8_t max_age = 0;
-	uint8_t way = 0;
-	if (type == L1_ICACHE)
-		{
-			lru(l1_icache_entry_t, L1_ICACHE_WAYS);
-		}
-	if (type == L1_DCACHE)
+
+/**
+ * @brief Places an entry in its line: in an invalid way if any (cold start),
+ * otherwise in place of the victim chosen by the replacement policy.
+ *
+ * @param cache the cache to insert into
+ * @param line_index the line to insert into
+ * @param entry the entry to insert
+ * @param access the access the entry is brought in for (statistics)
+ * @param victim (modified) if not NULL, receives the evicted entry (v = INVALID if none)
+ * @param p_way (modified) the way the entry was put in
+ * @return error code
+ */
+static int cache_place(cache_level_t * cache, uint16_t line_index, const cache_entry_t * entry,
+                       mem_access_t access, cache_entry_t * victim, uint8_t * p_way)
+{
+	uint8_t way = find_place(cache, line_index);
+	if (way != HIT_WAY_MISS)
 		{
-			lru(l1_dcache_entry_t, L1_DCACHE_WAYS);
+			if (victim != NULL) victim->v = INVALID;
+			M_EXIT_IF_ERR(cache_insert(line_index, way, entry, cache), "inserting in a free way");
+			cache->policy->fill(cache, line_index, way);
 		}
-	if (type == L2_CACHE)
+	else
 		{
-			lru(l2_cache_entry_t, L2_CACHE_WAYS);
+			way = cache->policy->victim(cache, line_index);
+			stats_inc(&cache->stats, access, STAT_EVICTIONS);
+			if (victim != NULL)
+				{
+					victim->v = cache_valid(cache, line_index, way);
+					victim->age = 0;
+					victim->dirty = cache_dirty(cache, line_index, way);
+					victim->tag = cache_tag(cache, line_index, way);
+					line_copy(victim->line, cache_line(cache, line_index, way), cache);
+				}
+			M_EXIT_IF_ERR(cache_insert(line_index, way, entry, cache), "inserting in place of the victim");
+			cache->policy->fill(cache, line_index, way);
 		}
-
-	return way;
+	*p_way = way;
+	return ERR_NONE;
 }
 
 
-uint8_t  find_place( void * cache, cache_t type, uint32_t line_index )
+/*
+ * What a line is looked up or brought in for: demand accesses are counted
+ * (see count_access()), prefetches are not.
+ */
+typedef enum
 {
+	REQUEST_READ, REQUEST_WRITE, REQUEST_PREFETCH
+} request_t;
 
-	switch (type)
-		{
-		case L1_ICACHE :
-			find_place_(l1_icache_entry_t, L1_ICACHE_WAYS);
-			break;
-
-		case L1_DCACHE :
-			find_place_(l1_dcache_entry_t, L1_DCACHE_WAYS);
-			break;
-
-		case L2_CACHE :
-			find_place_(l2_cache_entry_t, L2_CACHE_WAYS);
-			break;
-		default :
-			return HIT_WAY_MISS ;
-
-		}
-
-
-	return HIT_WAY_MISS ;
-
-
+/**
+ * @brief counts an access to a cache and its outcome
+ */
+static inline void count_access(cache_level_t * cache, mem_access_t access, request_t request, int hit)
+{
+	if (request == REQUEST_PREFETCH) return;
+	// without branches: misses follow hits in stat_t, and write misses write hits
+	uint64_t * count = cache->stats.count[access];
+	++count[STAT_ACCESSES];
+	++count[STAT_MISSES - (hit != 0)];
+	count[STAT_WRITE_MISSES - (hit != 0)] += (request == REQUEST_WRITE);
 }
 
 
-int cache_read(const void * mem_space, phy_addr_t * paddr, mem_access_t access, void * l1_cache, void * l2_cache, uint32_t * word, cache_replace_t replace)
+/**
+ * @brief the way of a line holding a tag, HIT_WAY_MISS if none; unlike
+ * cache_hit(), changes neither the replacement state nor the statistics
+ */
+static uint8_t find_tag(const cache_level_t * cache, uint16_t line_index, uint32_t tag)
 {
+	const uint32_t mask = tag_match(cache_tags(cache, line_index), tag | CACHE_TAG_VALID, cache->tag_ways);
+	return mask != 0 ? (uint8_t) __builtin_ctz(mask) : HIT_WAY_MISS;
+}
 
 
-	M_REQUIRE_NON_NULL(mem_space);
-	M_REQUIRE_NON_NULL(paddr);
-	M_REQUIRE_NON_NULL(l1_cache);
-	M_REQUIRE_NON_NULL(l2_cache);
-	M_REQUIRE_NON_NULL(word);
-
-	uint32_t addr = phy_addr_t_to_uint32_t(paddr);
-	uint8_t word_select = (addr & 0b1111) >> 2;
-	const uint32_t * p_line = calloc(L1_ICACHE_WORDS_PER_LINE, sizeof(word_t));
-	M_REQUIRE_NON_NULL(p_line);
+/**
+ * @brief Invalidates the line of addr in an inner cache, if there. A dirty
+ * copy is newer than the one leaving the outer cache: it replaces it.
+ * Only touches the storage of the inner cache, not its statistics.
+ * @return 1 if the line was there, 0 otherwise
+ */
+static int back_invalidate(cache_level_t * inner, uint32_t addr, cache_entry_t * victim, const cache_level_t * outer)
+{
+	const uint16_t index = (uint16_t) cache_index_of(inner, addr);
+	const uint8_t way = find_tag(inner, index, cache_tag_of(inner, addr));
+	if (way == HIT_WAY_MISS) return 0;
 
-	uint8_t hit_way = 0 ;
-	uint16_t hit_index = 0;
-	M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "Wrong access");
-	cache_t cache_type = access == INSTRUCTION ? L1_ICACHE : L1_DCACHE;
-	void * cache = l1_cache;
+	if (cache_dirty(inner, index, way))
+		{
+			line_copy(victim->line, cache_line(inner, index, way), outer);
+			victim->dirty = 1;
+		}
+	cache_invalidate(inner, index, way);
+	return 1;
+}
 
 
-	M_REQUIRE(cache_hit(mem_space, l1_cache, paddr, &p_line, &hit_way, &hit_index, cache_type) == ERR_NONE, ERR_BAD_PARAMETER, " ");
+static int send_line(void * mem_space, cache_level_t * first, const cache_level_t * from, cache_level_t * outer,
+                     uint32_t addr, const cache_entry_t * line, mem_access_t access);
+
+/**
+ * @brief Places an entry in an outer cache (L2 or L3) and deals with its
+ * victim, if any: it is back-invalidated in the inner caches (inclusive
+ * policy), then sent to the level below if dirty.
+ *
+ * @param first the L1 cache of the access, back-invalidated as an inner cache
+ * @param cache the outer cache
+ * @param request what the entry is brought in for (a victim of a prefetch may be a polluted line)
+ * @return error code
+ */
+static int outer_place(void * mem_space, cache_level_t * first, cache_level_t * cache,
+                       uint16_t line_index, const cache_entry_t * entry, mem_access_t access, request_t request)
+{
+	cache_entry_t victim;
+	uint8_t way = 0;
+	M_EXIT_IF_ERR(cache_place(cache, line_index, entry, access, &victim, &way), "inserting in an outer cache");
+	if (victim.v != VALID) return ERR_NONE;
 
-	if (hit_way != HIT_WAY_MISS)
+	const uint32_t victim_addr = cache_addr_of(cache, victim.tag, line_index);
+	if (request == REQUEST_PREFETCH) cache_prefetch_evicted(cache, victim_addr);
+	if (cache->config.inclusion == INCLUSIVE)
 		{
-
-			if (cache_type == L1_ICACHE)
+			// in the order of attachment (L2 before L1: the copy of L1 is newer), then first if not attached
+			int invalidated = 0, attached = 0;
+			for (size_t i = 0; i < CACHE_MAX_INNER && cache->inner[i] != NULL; ++i)
 				{
-					*word = cache_line(l1_icache_entry_t, L1_ICACHE_WAYS, hit_index, hit_way)[word_select];
-				}
-			if (cache_type == L1_DCACHE)
-				{
-					*word = cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way)[word_select];
+					invalidated += back_invalidate(cache->inner[i], victim_addr, &victim, cache);
+					attached |= cache->inner[i] == first;
 				}
+			if (first != NULL && !attached) invalidated += back_invalidate(first, victim_addr, &victim, cache);
+			cache->stats.count[access][STAT_BACK_INVALIDATIONS] += (uint64_t) invalidated;
 		}
+	if (!victim.dirty) return ERR_NONE;
 
-	else
-		{
-
-			uint16_t indexl2 = 0;
-			M_REQUIRE(cache_hit(mem_space, l2_cache, paddr, &p_line, &hit_way, &indexl2, L2_CACHE) == 0, ERR_BAD_PARAMETER, " ");
+	stats_inc(&cache->stats, access, STAT_WRITEBACKS);
+	return send_line(mem_space, first, cache, cache->next, victim_addr, &victim, access);
+}
 
-			uint32_t newaddr  = phy_addr_t_to_uint32_t(paddr);
-			int line_1 = (newaddr & 0b1111110000) >> 4;
-			int new_tag = newaddr >> L1_ICACHE_TAG_REMAINING_BITS;
 
+/**
+ * @brief Sends a line leaving a cache to the level below (see the inclusion
+ * policies in cache.h): an exclusive cache takes it; otherwise the line
+ * (dirty) updates its copy there, if any, or is placed there (NINE), or
+ * goes further down (inclusive: its copy can only be missing for an inner
+ * cache that is not attached, see cache_attach_inner()).
+ *
+ * @param first the L1 cache of the access (back-invalidations)
+ * @param from the cache the line leaves
+ * @param outer the level below, NULL for memory
+ * @param addr the address of the first byte of the line
+ * @param line the line
+ * @return error code
+ */
+static int send_line(void * mem_space, cache_level_t * first, const cache_level_t * from, cache_level_t * outer,
+                     uint32_t addr, const cache_entry_t * line, mem_access_t access)
+{
+	if (outer == NULL)
+		{
+			memcpy((uint8_t *) mem_space + addr, line->line, cache_line_bytes(from));
+			return ERR_NONE;
+		}
 
-			if (hit_way != HIT_WAY_MISS)
+	const uint16_t line_index = (uint16_t) cache_index_of(outer, addr);
+	cache_entry_t entry = *line;
+	entry.tag = cache_tag_of(outer, addr);
+	if (outer->config.inclusion != EXCLUSIVE)
+		{
+			const uint8_t way = find_tag(outer, line_index, entry.tag);
+			if (way != HIT_WAY_MISS)
 				{
-
-					if (cache_type == L1_ICACHE)
-						{
-							hit_L2(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE, L1_ICACHE_WAYS);
-						}
-					if (cache_type == L1_DCACHE)
-						{
-							hit_L2(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE, L1_DCACHE_WAYS);
-
-						}
+					line_copy(cache_line(outer, line_index, way), line->line, outer);
+					cache_dirty(outer, line_index, way) |= line->dirty;
+					return ERR_NONE;
 				}
+			if (outer->config.inclusion == INCLUSIVE)
+				return send_line(mem_space, first, outer, outer->next, addr, line, access);
+		}
+	return outer_place(mem_space, first, outer, line_index, &entry, access, REQUEST_WRITE);
+}
 
-			else
-				{
-					line_1 &= 0b111111;
-
-					if (cache_type == L1_ICACHE)
-						{
-							not_hit_L1_or_L2(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE);
-
-						}
 
-					if (cache_type == L1_DCACHE)
-						{
+/**
+ * @brief Reads the line of an address a cache (L2) misses from the level
+ * below: from L3, filled on a miss (see cache.h), or from memory.
+ *
+ * @param first the L1 cache of the access (back-invalidations, level that served it)
+ * @param cache the cache that misses the line
+ * @param line_addr the address of the first byte of the line
+ * @param access, request the kind of access (statistics)
+ * @param entry (modified) the line, clean, with the tag of cache
+ * @return error code
+ */
+static int outer_read(void * mem_space, cache_level_t * first, const cache_level_t * cache, phy_addr_t * line_addr,
+                      mem_access_t access, request_t request, cache_entry_t * entry)
+{
+	cache_level_t * const next = cache->next;
+	if (next == NULL)
+		{
+			if (request != REQUEST_PREFETCH) first->served = MAIN_MEMORY;
+			return cache_entry_init(mem_space, line_addr, entry, cache);
+		}
 
-							not_hit_L1_or_L2(l1_dcache_entry_t, L1_DCACHE_WAYS, L1_DCACHE);
+	const uint32_t addr = phy_addr_t_to_uint32_t(line_addr);
+	const uint32_t * line = NULL;
+	uint8_t way = 0;
+	uint16_t line_index = 0;
+	M_EXIT_IF_ERR(cache_hit(mem_space, next, line_addr, &line, &way, &line_index), "L3 lookup");
+	count_access(next, access, request, way != HIT_WAY_MISS);
 
-						}
+	if (way != HIT_WAY_MISS)
+		{
+			// copied: the dirty bit stays with the copy of the outer cache
+			if (request != REQUEST_PREFETCH)
+				{
+					stats_inc(&next->stats, access, STAT_PROMOTIONS);
+					first->served = next->type;
 				}
+			entry->v = VALID;
+			entry->age = 0;
+			entry->dirty = 0;
+			line_copy(entry->line, line, next);
 		}
-
-
+	else
+		{
+			M_EXIT_IF_ERR(outer_read(mem_space, first, next, line_addr, access, request, entry), "reading line");
+			M_EXIT_IF_ERR(outer_place(mem_space, first, next, (uint16_t) cache_index_of(next, addr), entry, access, request),
+			              "inserting in L3");
+		}
+	entry->tag = cache_tag_of(cache, addr);
 	return ERR_NONE;
-
 }
-int cache_write(void * mem_space,
-                phy_addr_t * paddr,
-                void * l1_cache,
-                void * l2_cache,
-                const uint32_t * word,
-                cache_replace_t replace)
-{
 
 
-	M_REQUIRE_NON_NULL(mem_space);
-	M_REQUIRE_NON_NULL(paddr);
-	M_REQUIRE_NON_NULL(l1_cache);
-	M_REQUIRE_NON_NULL(l2_cache);
-	M_REQUIRE_NON_NULL(word);
-
-	uint32_t addr = phy_addr_t_to_uint32_t(paddr);
-	uint8_t word_index = (addr & 0b1111) >> 2;
+/**
+ * @brief Sends an L1 victim to L2 (see the inclusion policies in cache.h).
+ *
+ * @param victim the victim, with its L1 tag
+ * @param l1_index the L1 line it left
+ * @return error code
+ */
+static int l1_evict(void * mem_space, cache_entry_t * victim, uint16_t l1_index, mem_access_t access,
+                    cache_level_t * l1_cache, cache_level_t * l2_cache)
+{
+	// a clean victim is also in L2 (or was evicted from it): only exclusive L2 keeps it
+	if (l2_cache->config.inclusion != EXCLUSIVE && !victim->dirty) return ERR_NONE;
 
-	const uint32_t * p_line = calloc(L1_DCACHE_WORDS_PER_LINE, sizeof(word_t));
-	M_REQUIRE_NON_NULL(p_line);
-	const uint32_t * p_line2 =  calloc(L2_CACHE_WORDS_PER_LINE, sizeof(word_t));
-	M_REQUIRE_NON_NULL(p_line2);
-	void * cache = l1_cache;
+	stats_inc(&l1_cache->stats, access, STAT_VICTIMS);
+	if (victim->dirty) stats_inc(&l1_cache->stats, access, STAT_WRITEBACKS);
+	return send_line(mem_space, l1_cache, l1_cache, l2_cache, cache_addr_of(l1_cache, victim->tag, l1_index),
+	                 victim, access);
+}
 
 
-	uint8_t hit_way = 0;
-	uint16_t hit_index = 0;
-	cache_hit(mem_space, l1_cache, paddr, &p_line, &hit_way, &hit_index, L1_DCACHE);
+/**
+ * @brief 1 if the line of addr is in a cache, 0 otherwise (see find_tag())
+ */
+static int holds(const cache_level_t * cache, uint32_t addr)
+{
+	return find_tag(cache, (uint16_t) cache_index_of(cache, addr), cache_tag_of(cache, addr)) != HIT_WAY_MISS;
+}
 
 
-// cas ou on a un hit dans la l1 cache
-	if (hit_way != HIT_WAY_MISS)
+/**
+ * @brief Prefetch side of a demand access to a cache with a prefetcher (see
+ * cache_prefetch.h): counts the useful, late and polluting prefetches and
+ * trains the prefetcher on a miss or on the first hit of a prefetched line.
+ *
+ * @param index, way the line and way of the hit, way HIT_WAY_MISS on a miss
+ */
+static void prefetch_demand(cache_level_t * cache, uint32_t addr, mem_access_t access, uint16_t index, uint8_t way)
+{
+	if (way != HIT_WAY_MISS)
 		{
-			//inserer le nouveau mot dans la cache et dans la mémoire centrale
-
-			uint32_t * new_line = calloc(L1_DCACHE_WORDS_PER_LINE, sizeof(word_t));
-			M_REQUIRE_NON_NULL(new_line);
-			memcpy(new_line, p_line, 4 * sizeof(word_t));
-			new_line[word_index] = *word;
-
-			memcpy(cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way), new_line, 4 * sizeof(word_t));
-
-			LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_way, hit_index);
-			memcpy( mem_space + phy_addr_t_to_uint32_t(paddr), new_line, 4 * sizeof(word_t));
-
-			return ERR_NONE;
+			if (!cache_prefetched(cache, index, way)) return;
+			cache_prefetched(cache, index, way) = 0;
+			stats_inc(&cache->stats, access, STAT_PREFETCH_USEFUL);
 		}
-
-	uint8_t hit_way2 = 0;
-	uint16_t hit_index2 = 0;
-	cache_hit(mem_space, l2_cache, paddr, &p_line2, &hit_way2, &hit_index2, L1_DCACHE);
-
-
-// cas ou il y a un hit dans le deuxieme cache, écrire dans la mémoire centrale et dans le l2cache, puis insérer dans la l1cache
-	if (hit_way2 != HIT_WAY_MISS)
+	else
 		{
+			if (cache_prefetch_cancel(cache, addr)) stats_inc(&cache->stats, access, STAT_PREFETCH_LATE);
+			if (cache_prefetch_polluted(cache, addr)) stats_inc(&cache->stats, access, STAT_PREFETCH_POLLUTING);
+		}
+	cache_prefetch_train(cache, addr);
+}
 
-			uint32_t * new_line = calloc(L2_CACHE_WORDS_PER_LINE, sizeof(word_t));
-			M_REQUIRE_NON_NULL(new_line);
-			memcpy(new_line, p_line2, 4 * sizeof(word_t));
-			new_line[word_index] = *word;
-			cache = l2_cache;
-			memcpy(cache_line(l2_cache_entry_t, L2_CACHE_WAYS, hit_index2, hit_way2), new_line, 4 * sizeof(word_t));
 
+/**
+ * @brief Fills the oldest prefetch in flight of L2, if any, unless its line
+ * is already in L2 or in an L1 cache. The line is read as on an L2 miss
+ * (see outer_read()) and placed in L2 only, whatever its inclusion policy.
+ *
+ * @param l1_cache the L1 cache of the access
+ * @return error code
+ */
+static int l2_prefetch(void * mem_space, mem_access_t access, cache_level_t * l1_cache, cache_level_t * l2_cache)
+{
+	uint32_t addr = 0;
+	if (!cache_prefetch_pop(l2_cache, &addr)) return ERR_NONE;
+	if (holds(l2_cache, addr) || holds(l1_cache, addr)) return ERR_NONE;
+	for (size_t i = 0; i < CACHE_MAX_INNER && l2_cache->inner[i] != NULL; ++i)
+		if (holds(l2_cache->inner[i], addr)) return ERR_NONE;
+
+	phy_addr_t line_addr;
+	M_EXIT_IF_ERR(init_phy_addr(&line_addr, addr & ~(uint32_t) (PAGE_SIZE - 1), addr & (PAGE_SIZE - 1)),
+	              "computing line address");
+	cache_entry_t entry;
+	M_EXIT_IF_ERR(outer_read(mem_space, l1_cache, l2_cache, &line_addr, access, REQUEST_PREFETCH, &entry),
+	              "reading line");
+	const uint16_t index = (uint16_t) cache_index_of(l2_cache, addr);
+	M_EXIT_IF_ERR(outer_place(mem_space, l1_cache, l2_cache, index, &entry, access, REQUEST_PREFETCH),
+	              "prefetching into L2");
+	cache_prefetched(l2_cache, index, find_tag(l2_cache, index, entry.tag)) = 1;
+	cache_prefetch_polluted(l2_cache, addr); // back in the cache
+	stats_inc(&l2_cache->stats, access, STAT_PREFETCHES);
+	return ERR_NONE;
+}
 
-			cache = l2_cache;
-			LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, hit_way2, hit_index2);
 
-			l1_dcache_entry_t *  newentry = malloc(sizeof(l1_dcache_entry_t));
-			M_REQUIRE_NON_NULL(newentry);
-			index_from_l2_to_l1(l2_cache, newentry, L1_DCACHE , hit_way2, hit_index2);
+/**
+ * @brief Brings the line of addr into L1 after an L1 miss, according to the
+ * inclusion policy of L2 (see cache.h): an L2 hit moves (exclusive) or
+ * copies the line to L1, an L2 miss reads it from L3 or memory (see
+ * outer_read()) and places it in L2 too, unless exclusive. The L1 victim,
+ * if any, goes to L2 (see l1_evict()). A demand access to L2 first fills
+ * a prefetch of L2, if any (see l2_prefetch()).
+ *
+ * @param access, request the kind of access (statistics)
+ * @param p_line (modified) the line, inside L1
+ * @return error code
+ */
+static int l1_fill(void * mem_space, uint32_t addr, mem_access_t access, request_t request,
+                   cache_level_t * l1_cache, cache_level_t * l2_cache, word_t ** p_line)
+{
+	if (l2_cache->prefetch != NULL && request != REQUEST_PREFETCH)
+		M_EXIT_IF_ERR(l2_prefetch(mem_space, access, l1_cache, l2_cache), "L2 prefetch");
+
+	phy_addr_t line_addr; // address of the first byte of the line
+	M_EXIT_IF_ERR(init_phy_addr(&line_addr, addr & ~(uint32_t) (PAGE_SIZE - 1),
+	                            addr & (PAGE_SIZE - 1) & ~(uint32_t) (cache_line_bytes(l1_cache) - 1)),
+	              "computing line address");
+
+	const int exclusive = l2_cache->config.inclusion == EXCLUSIVE;
+	cache_entry_t entry;
+	const uint32_t * l2_line = NULL;
+	uint8_t l2_way = 0;
+	uint16_t l2_index = 0;
+	M_EXIT_IF_ERR(cache_hit(mem_space, l2_cache, &line_addr, &l2_line, &l2_way, &l2_index), "L2 lookup");
+	count_access(l2_cache, access, request, l2_way != HIT_WAY_MISS);
+	if (l2_cache->prefetch != NULL && request != REQUEST_PREFETCH)
+		prefetch_demand(l2_cache, addr, access, l2_index, l2_way);
+
+	if (l2_way != HIT_WAY_MISS)
+		{
+			if (request != REQUEST_PREFETCH)
+				{
+					stats_inc(&l2_cache->stats, access, STAT_PROMOTIONS);
+					l1_cache->served = l2_cache->type;
+				}
+			// move (exclusive) or copy the line from L2 to L1; a copy leaves the dirty bit to L2
+			entry.v = VALID;
+			entry.age = 0;
+			entry.dirty = exclusive ? cache_dirty(l2_cache, l2_index, l2_way) : 0;
+			entry.tag = cache_tag_of(l1_cache, addr);
+			line_copy(entry.line, l2_line, l2_cache);
+			if (exclusive) cache_invalidate(l2_cache, l2_index, l2_way);
+		}
+	else
+		{
+			M_EXIT_IF_ERR(outer_read(mem_space, l1_cache, l2_cache, &line_addr, access, request, &entry), "reading line");
+			if (!exclusive)
+				M_EXIT_IF_ERR(outer_place(mem_space, l1_cache, l2_cache, (uint16_t) cache_index_of(l2_cache, addr),
+				                          &entry, access, request),
+				              "inserting in L2");
+			entry.tag = cache_tag_of(l1_cache, addr);
+		}
 
-			uint16_t indexL1 = hit_index2  & 0b111111;
-			uint8_t wayL1 = find_place(l1_cache, L1_DCACHE, hit_index2);
-			cache = l1_cache;
+	const uint16_t l1_index = (uint16_t) cache_index_of(l1_cache, addr);
+	cache_entry_t victim;
+	uint8_t l1_way = 0;
+	M_EXIT_IF_ERR(cache_place(l1_cache, l1_index, &entry, access, &victim, &l1_way), "inserting in L1");
+	*p_line = cache_line(l1_cache, l1_index, l1_way);
 
-			memcpy(mem_space + phy_addr_t_to_uint32_t(paddr), new_line , 4 * sizeof(word_t));
-//pendant l'insertion dans le l1 rechercher s"il y a un cold start.
+	if (victim.v == VALID && request == REQUEST_PREFETCH)
+		cache_prefetch_evicted(l1_cache, cache_addr_of(l1_cache, victim.tag, l1_index));
+	if (victim.v == VALID)
+		M_EXIT_IF_ERR(l1_evict(mem_space, &victim, l1_index, access, l1_cache, l2_cache), "evicting from L1");
 
-			if ( wayL1 != HIT_WAY_MISS)
-				{
-					cache_insert(indexL1, wayL1, newentry, l1_cache, L1_DCACHE);
-					LRU_age_increase(l1_dcache_entry_t, L1_DCACHE_WAYS, wayL1, indexL1);
-					return ERR_NONE;
+	return ERR_NONE;
+}
 
-				}
-			else
-				{
-// s'il n'y a pas de cold start alors sortir la plus ancienne entrée du l1  à cet index et l'inserer dans le l2
-					uint8_t waydel = apply_lru(l1_cache, L1_DCACHE, indexL1);
 
-					l2_cache_entry_t * old_entry = malloc(sizeof(l2_cache_entry_t));
-					old_entry->v = VALID;
-					old_entry->tag = (addr >> L2_CACHE_TAG_REMAINING_BITS);
-					old_entry->age = 0;
+/**
+ * @brief the slot (see cache_slot()) of a line inside a cache
+ */
+#define line_slot(CACHE, LINE) \
+	((size_t) ((LINE) - (CACHE)->data) >> ((CACHE)->line_bits - 2))
 
-					memcpy(old_entry->line, cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, indexL1, wayL1), 4 * sizeof(word_t));
 
-					cache_insert(indexL1, waydel, newentry, l1_cache, L1_DCACHE);
-					LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, waydel, indexL1);
+/**
+ * @brief Write-through of a word: to memory, and to the copy of its line
+ * in L2 and L3, if any (inclusive and NINE policies)
+ */
+static void write_through(void * mem_space, cache_level_t * l2_cache, uint32_t addr, word_t word)
+{
+	((word_t *) mem_space)[addr / sizeof(word_t)] = word;
+	for (cache_level_t * cache = l2_cache; cache != NULL; cache = cache->next)
+		{
+			if (cache->config.inclusion == EXCLUSIVE) continue;
+			const uint16_t index = (uint16_t) cache_index_of(cache, addr);
+			const uint8_t way = find_tag(cache, index, cache_tag_of(cache, addr));
+			if (way != HIT_WAY_MISS)
+				cache_line(cache, index, way)[(addr >> 2) & (cache->config.words_per_line - 1u)] = word;
+		}
+}
 
-					uint8_t wayaddl2 = find_place(l2_cache, L2_CACHE, hit_index2);
-					cache = l2_cache;
 
-// cherche un cold start dans le l2
-					if (wayaddl2 != HIT_WAY_MISS)
-						{
-							cache_insert(hit_index2, wayaddl2, old_entry, l2_cache, L2_CACHE);
-							LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, wayaddl2, hit_index2);
+/**
+ * @brief Fills the oldest prefetch in flight of L1, if any, unless its line
+ * is already there; it is brought in as on an L1 miss (see l1_fill()).
+ */
+static int l1_prefetch(void * mem_space, mem_access_t access, cache_level_t * l1_cache, cache_level_t * l2_cache)
+{
+	uint32_t addr = 0;
+	if (!cache_prefetch_pop(l1_cache, &addr) || holds(l1_cache, addr)) return ERR_NONE;
+
+	word_t * line = NULL;
+	M_EXIT_IF_ERR(l1_fill(mem_space, addr, access, REQUEST_PREFETCH, l1_cache, l2_cache, &line), "prefetching into L1");
+	l1_cache->prefetched[line_slot(l1_cache, line)] = 1;
+	cache_prefetch_polluted(l1_cache, addr); // back in the cache
+	stats_inc(&l1_cache->stats, access, STAT_PREFETCHES);
+	return ERR_NONE;
+}
 
-						}
-					else
-						{
-							//s'il n'y en a pas sortir l'entrée la plus ancienne
-							uint8_t waydel2 = apply_lru(l2_cache, L2_CACHE, hit_index2);
-							cache_insert(hit_index2, waydel2, old_entry, l2_cache, L2_CACHE);
-							LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, waydel2, hit_index2);
-						}
 
+/**
+ * @brief common checks of cache_read() and cache_write(); returns the line in L1
+ * holding addr, bringing it in on a miss. A prefetch of L1 in flight, if
+ * any, is filled first (see l1_prefetch()): it cannot evict the line returned.
+ */
+static int l1_access(void * mem_space, phy_addr_t * paddr, uint32_t addr, mem_access_t access, request_t request,
+                     cache_level_t * l1_cache, cache_level_t * l2_cache, word_t ** p_line)
+{
+	M_REQUIRE_NON_NULL(l1_cache->tags);
+	M_REQUIRE_NON_NULL(l2_cache->tags);
+	M_REQUIRE(l1_cache->config.words_per_line == l2_cache->config.words_per_line, ERR_SIZE,
+	          "%s", "L1 and L2 must have the same line size");
 
+	if (l1_cache->prefetch != NULL)
+		M_EXIT_IF_ERR(l1_prefetch(mem_space, access, l1_cache, l2_cache), "L1 prefetch");
 
-				}
+	const uint32_t * l1_line = NULL; // set by cache_hit() to the line inside the cache
+	uint8_t hit_way = 0;
+	uint16_t hit_index = 0;
+	M_EXIT_IF_ERR(cache_hit(mem_space, l1_cache, paddr, &l1_line, &hit_way, &hit_index), "L1 lookup");
+	count_access(l1_cache, access, request, hit_way != HIT_WAY_MISS);
+	if (l1_cache->prefetch != NULL)
+		prefetch_demand(l1_cache, addr, access, hit_index, hit_way);
 
+	if (hit_way != HIT_WAY_MISS)
+		{
+			l1_cache->served = l1_cache->type;
+			*p_line = cache_line(l1_cache, hit_index, hit_way);
 			return ERR_NONE;
 		}
-	else
-		{
-// cas ou il n'y a eu aucun hit. crée une nouvelle entrée pour la mettre dans la l1cache et écrire dans la mémoire
-
-
-			uint32_t  * mem_line = calloc(L1_DCACHE_WORDS_PER_LINE, sizeof(word_t));
-			memcpy( mem_line, mem_space + phy_addr_t_to_uint32_t(paddr), 4 * sizeof(word_t));
-			mem_line[word_index] = *word;
-			memcpy( mem_space + phy_addr_t_to_uint32_t(paddr), mem_line, 4 * sizeof(word_t));
-			l1_dcache_entry_t * newd = malloc(sizeof(l1_dcache_entry_t));
-			cache_entry_init(mem_space, paddr, newd, L1_DCACHE);
-			uint16_t newindex = (addr >> 4) & 0b111111;
-			uint8_t wayld = find_place(l1_cache, L1_DCACHE, newindex);
-			cache = l1_cache;
-// regarde s'il y a une cold start dans le l1 cache
-			if (wayld != HIT_WAY_MISS)
-				{
-					cache_insert(newindex, wayld, newd, l1_cache, L1_DCACHE);
-					LRU_age_increase(l1_dcache_entry_t, L1_DCACHE_WAYS, wayld, newindex);
-					return ERR_NONE;
-				}
-
-			else
-				{
-// s'il n'y a pas de cold start trouver la plus ancienne entrée du l1 et la remplacer par la nouvelle
-					uint8_t waydel2 = apply_lru(l1_cache, L1_DCACHE, newindex);
-
-
+	return l1_fill(mem_space, addr, access, request, l1_cache, l2_cache, p_line);
+}
 
-					l2_cache_entry_t * old_entry = malloc(sizeof(l2_cache_entry_t));
 
-					memcpy(old_entry->line, cache_entry(l1_dcache_entry_t, L1_DCACHE_WAYS, newindex, waydel2)->line, 4 * sizeof(word_t));
+int cache_read(void * mem_space,
+               phy_addr_t * paddr,
+               mem_access_t access,
+               cache_level_t * l1_cache,
+               cache_level_t * l2_cache,
+               uint32_t * word)
+{
 
-					old_entry->age = 0;
-					old_entry->v = INVALID;
-					old_entry->tag = (cache_tag(l1_dcache_entry_t, L1_DCACHE_WAYS, newindex, waydel2) >> 3);
+	M_REQUIRE_NON_NULL(mem_space);
+	M_REQUIRE_NON_NULL(paddr);
+	M_REQUIRE_NON_NULL(l1_cache);
+	M_REQUIRE_NON_NULL(l2_cache);
+	M_REQUIRE_NON_NULL(word);
+	M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "%s", "Wrong access");
 
+	const uint32_t addr = phy_addr_t_to_uint32_t(paddr);
+	word_t * line = NULL;
+	M_EXIT_IF_ERR(l1_access(mem_space, paddr, addr, access, REQUEST_READ, l1_cache, l2_cache, &line), "L1 access");
 
-					cache_insert(newindex, waydel2, newd, l1_cache, L1_DCACHE);
+	*word = line[(addr >> 2) & (l1_cache->config.words_per_line - 1u)];
 
-					LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, waydel2, newindex);
+	return ERR_NONE;
+}
 
-					uint16_t l2index = (phy_addr_t_to_uint32_t(paddr) >> 4) & 0b111111111;
-					uint8_t l2way = find_place(l2_cache, L2_CACHE, l2index);
-// inserer l'entrée sortie dans le l2
 
-					cache = l2_cache;
-					if (l2way != HIT_WAY_MISS)
-						{
-							cache_insert(l2index, l2way, old_entry, l2_cache, L2_CACHE);
-							LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, l2way, l2index);
-						}
-					else
-						{
+int cache_write(void * mem_space,
+                phy_addr_t * paddr,
+                cache_level_t * l1_cache,
+                cache_level_t * l2_cache,
+                const uint32_t * word)
+{
 
-							uint8_t way2 = apply_lru(l2_cache, L2_CACHE, l2index);
+	M_REQUIRE_NON_NULL(mem_space);
+	M_REQUIRE_NON_NULL(paddr);
+	M_REQUIRE_NON_NULL(l1_cache);
+	M_REQUIRE_NON_NULL(l2_cache);
+	M_REQUIRE_NON_NULL(word);
 
-							cache_insert(l2index, way2, old_entry, l2_cache, L2_CACHE);
+	// write-allocate: the line is brought into L1 (from L2 or memory) first
+	const uint32_t addr = phy_addr_t_to_uint32_t(paddr);
+	word_t * line = NULL;
+	M_EXIT_IF_ERR(l1_access(mem_space, paddr, addr, DATA, REQUEST_WRITE, l1_cache, l2_cache, &line), "L1 access");
 
-							LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, way2, l2index);
-						}
-				}
+	line[(addr >> 2) & (l1_cache->config.words_per_line - 1u)] = *word;
 
-			return ERR_NONE;
+	if (l1_cache->config.write_back)
+		l1_cache->dirty[line_slot(l1_cache, line)] = 1;
+	else // write-through: memory is always up to date
+		write_through(mem_space, l2_cache, addr, *word);
 
-		}
 	return ERR_NONE;
 }
 
 
-
-
-
-int cache_read_byte(const void * mem_space,
+int cache_read_byte(void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
-                    void * l1_cache,
-                    void * l2_cache,
-                    uint8_t * p_byte,
-                    cache_replace_t replace)
+                    cache_level_t * l1_cache,
+                    cache_level_t * l2_cache,
+                    uint8_t * p_byte)
 {
 
 	M_REQUIRE_NON_NULL(mem_space);
@@ -573,28 +914,26 @@ int cache_read_byte(const void * mem_space,
 	M_REQUIRE_NON_NULL(p_byte);
 //trouve l'index du byte à enlever
 	uint8_t byte_select = phy_addr_t_to_uint32_t(p_paddr) & 0b11;
-	word_t * word = malloc(sizeof(word_t));
-	M_REQUIRE_NON_NULL(word);
+	word_t word = 0;
 	// met la valeur dans le mot
 
-	int err = cache_read(mem_space, p_paddr, access, l1_cache, l2_cache, word, replace);
+	int err = cache_read(mem_space, p_paddr, access, l1_cache, l2_cache, &word);
 	if (err != ERR_NONE)
 		{
-			return ERR_BAD_PARAMETER;
+			return err;
 		}
 
 	// met la valeur du byte dans le byte.
-	*p_byte = (*word >> (byte_select * bits_in_a_byte)) & 0b11111111;
+	*p_byte = (word >> (byte_select * bits_in_a_byte)) & 0b11111111;
 
 	return ERR_NONE;
 }
 
 int cache_write_byte(void * mem_space,
                      phy_addr_t * paddr,
-                     void * l1_cache,
-                     void * l2_cache,
-                     uint8_t* p_byte,
-                     cache_replace_t replace)
+                     cache_level_t * l1_cache,
+                     cache_level_t * l2_cache,
+                     uint8_t* p_byte)
 {
 
 	M_REQUIRE_NON_NULL(mem_space);
@@ -603,22 +942,105 @@ int cache_write_byte(void * mem_space,
 	M_REQUIRE_NON_NULL(l2_cache);
 	M_REQUIRE_NON_NULL(p_byte);
 
-// trouve l'index du byte a changer
+	// one (write) access: the line is brought into L1 first, then the byte is changed in the word
+	const uint32_t addr = phy_addr_t_to_uint32_t(paddr);
+	const uint8_t byte_select = addr & 0b11;
+	word_t * line = NULL;
+	M_EXIT_IF_ERR(l1_access(mem_space, paddr, addr, DATA, REQUEST_WRITE, l1_cache, l2_cache, &line), "L1 access");
 
-	uint8_t byte_select = phy_addr_t_to_uint32_t(paddr) & 0b11;
-	word_t * word = malloc(sizeof(word_t));
-	M_REQUIRE_NON_NULL(word);
+	word_t * word = &line[(addr >> 2) & (l1_cache->config.words_per_line - 1u)];
+	*word &= ~((word_t) 0xFF << (bits_in_a_byte * byte_select));
+	*word |= (word_t) *p_byte << (bits_in_a_byte * byte_select);
+
+	if (l1_cache->config.write_back)
+		l1_cache->dirty[line_slot(l1_cache, line)] = 1;
+	else // write-through
+		write_through(mem_space, l2_cache, addr, *word);
 
+	return ERR_NONE;
 
-	M_REQUIRE(cache_read(mem_space, paddr, DATA, l1_cache, l2_cache, word, replace) == ERR_NONE, ERR_BAD_PARAMETER, " ");
+}
 
-// met le byte dans le word à inserer
-	*word |=  (*p_byte << (bits_in_a_byte * byte_select));
-//insere le word dans la cache.
-	M_REQUIRE(cache_write(mem_space, paddr, l1_cache, l2_cache, word, replace) == ERR_NONE, ERR_BAD_PARAMETER, " ");
 
+int cache_write_back(void * mem_space, cache_level_t * cache)
+{
+	M_REQUIRE_NON_NULL(mem_space);
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(cache->tags);
+
+	for (uint16_t index = 0; index < cache->config.lines; index++)
+		{
+			foreach_way(way, cache->config.ways)
+			{
+				if (cache_valid(cache, index, way) && cache_dirty(cache, index, way))
+					{
+						memcpy((uint8_t *) mem_space + cache_addr_of(cache, cache_tag(cache, index, way), index),
+						       cache_line(cache, index, way), cache_line_bytes(cache));
+						cache_dirty(cache, index, way) = 0;
+						stats_inc(&cache->stats, DATA, STAT_WRITEBACKS);
+					}
+			}
+		}
 	return ERR_NONE;
+}
 
 
+int cache_attach_inner(cache_level_t * cache, cache_level_t * inner)
+{
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(inner);
+	M_REQUIRE(inner != cache, ERR_BAD_PARAMETER, "%s", "a cache cannot be inner to itself");
+
+	for (size_t i = 0; i < CACHE_MAX_INNER; ++i)
+		{
+			if (cache->inner[i] == inner) return ERR_NONE;
+			if (cache->inner[i] == NULL)
+				{
+					cache->inner[i] = inner;
+					return ERR_NONE;
+				}
+		}
+	M_EXIT(ERR_SIZE, "more than %u inner caches", CACHE_MAX_INNER);
+}
+
 
-}
\ No newline at end of file
+static const char * const inclusion_names[NB_CACHE_INCLUSION] =
+{
+	[EXCLUSIVE] = "exclusive",
+	[INCLUSIVE] = "inclusive",
+	[NINE]      = "nine",
+};
+
+int cache_inclusion_from_name(const char * name, cache_inclusion_t * inclusion)
+{
+	M_REQUIRE_NON_NULL(name);
+	M_REQUIRE_NON_NULL(inclusion);
+
+	for (unsigned i = 0; i < NB_CACHE_INCLUSION; ++i)
+		{
+			if (strcmp(name, inclusion_names[i]) == 0)
+				{
+					*inclusion = (cache_inclusion_t) i;
+					return ERR_NONE;
+				}
+		}
+	M_EXIT(ERR_POLICY, "%s: unknown inclusion policy", name);
+}
+
+
+int cache_attach_next(cache_level_t * cache, cache_level_t * next)
+{
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(next);
+	M_REQUIRE(next != cache && cache->next == NULL, ERR_BAD_PARAMETER, "%s", "a cache has one level below");
+	M_REQUIRE(next->config.words_per_line == cache->config.words_per_line, ERR_SIZE,
+	          "%s", "a cache and the level below must have the same line size");
+	M_REQUIRE(next->config.inclusion != EXCLUSIVE, ERR_POLICY, "%s", "the level below cannot be exclusive");
+
+	// back-invalidated in this order: the cache, then its inner caches (with newer copies)
+	M_EXIT_IF_ERR(cache_attach_inner(next, cache), "attaching to the level below");
+	for (size_t i = 0; i < CACHE_MAX_INNER && cache->inner[i] != NULL; ++i)
+		M_EXIT_IF_ERR(cache_attach_inner(next, cache->inner[i]), "attaching an inner cache to the level below");
+	cache->next = next;
+	return ERR_NONE;
+}
@@ -12,9 +12,6 @@
 #include "cache.h"
 #include <stdio.h> // for FILE
 
-enum cache_replacement_policy { LRU };
-typedef enum cache_replacement_policy cache_replace_t;
-
 #define HIT_WAY_MISS   ((uint8_t)  -1)
 #define HIT_INDEX_MISS ((uint16_t) -1)
 
@@ -26,22 +23,49 @@ typedef enum cache_replacement_policy cache_replace_t;
 #define foreach_way(var, ways) \
   for (uint8_t var = 0; var < (ways); var++)
 
+//=========================================================================
+/**
+ * @brief Convert a physical address structure to its 32-bit pattern.
+ * @param paddr the physical address
+ * @return the 32-bit pattern of the address
+ */
+uint32_t phy_addr_t_to_uint32_t(const phy_addr_t * paddr);
+
+//=========================================================================
+/**
+ * @brief Create a cache of a given geometry and replacement policy. The cache is flushed.
+ *
+ * @param cache (modified) the cache to be initialized
+ * @param cache_type to distinguish between different caches
+ * @param config geometry and policy of the cache, see cache_config_t
+ * @return error code (ERR_SIZE if the geometry is not supported,
+ *         ERR_POLICY if the policy is unknown or does not support the number of ways)
+ */
+int cache_init(cache_level_t * cache, cache_t cache_type, const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for cache_level_t: free its entries.
+ * @param cache the cache to be freed
+ */
+void cache_free(cache_level_t * cache);
+
 //=========================================================================
 /**
  * @brief Clean a cache (invalidate, reset...).
  *
- * This function erases all cache data.
+ * This function erases all cache data (but not the statistics, see stats_reset()).
+ * Dirty lines are lost: write them back first (see cache_write_back()).
  * @param cache pointer to the cache
- * @param cache_type an enum to distinguish between different caches
  * @return error code
  */
-int cache_flush(void *cache, cache_t cache_type);
+int cache_flush(cache_level_t * cache);
 
 //=========================================================================
 /**
  * @brief Check if a instruction/data is present in one of the caches.
  *
- * On hit, update hit infos to corresponding index
+ * On hit, update hit infos to corresponding index, update the replacement state of the line
  *         and update the cache-line-size chunk of data passed as the pointer to the function.
  * On miss, update hit infos to HIT_WAY_MISS or HIT_INDEX_MISS.
  *
@@ -51,17 +75,15 @@ int cache_flush(void *cache, cache_t cache_type);
  * @param p_line pointer to a cache-line-size chunk of data to return
  * @param hit_way (modified) cache way where hit was detected, HIT_WAY_MISS on miss
  * @param hit_index (modified) cache line index where hit was detected, HIT_INDEX_MISS on miss
- * @param cache_type to distinguish between different caches
  * @return error code
  */
 
 int cache_hit (const void * mem_space,
-               void * cache,
+               cache_level_t * cache,
                phy_addr_t * paddr,
                const uint32_t ** p_line,
                uint8_t *hit_way,
-               uint16_t *hit_index,
-               cache_t cache_type);
+               uint16_t *hit_index);
 
 //=========================================================================
 /**
@@ -69,31 +91,29 @@ int cache_hit (const void * mem_space,
  *
  * @param cache_line_index the number of the line to overwrite
  * @param cache_way the number of the way where to insert
- * @param cache_line_in pointer to the cache line to insert
+ * @param cache_line_in pointer to the cache entry to insert
  * @param cache pointer to the cache
- * @param cache_type to distinguish between different caches
  * @return error code
  */
 int cache_insert(uint16_t cache_line_index,
                  uint8_t cache_way,
-                 const void * cache_line_in,
-                 void * cache,
-                 cache_t cache_type);
+                 const cache_entry_t * cache_line_in,
+                 cache_level_t * cache);
 
 //=========================================================================
 /**
  * @brief Initialize a cache entry (write to the cache entry for the first time)
  *
  * @param mem_space starting address of the memory space
- * @param paddr pointer to physical address, to extract the tag
+ * @param paddr pointer to physical address, to extract the tag; must be line-aligned
  * @param cache_entry pointer to the entry to be initialized
- * @param cache_type to distinguish between different caches
+ * @param cache the cache the entry is meant for (tag and line size)
  * @return error code
  */
 int cache_entry_init(const void * mem_space,
                      const phy_addr_t * paddr,
-                     void * cache_entry,
-                     cache_t cache_type);
+                     cache_entry_t * cache_entry,
+                     const cache_level_t * cache);
 
 //=========================================================================
 /**
@@ -109,6 +129,19 @@ int cache_entry_init(const void * mem_space,
  *      behaves like a victim cache. If the block is not found neither in L1 nor
  *      in L2, then it is fetched from main memory and placed just in L1 and not
  *      in L2.
+ *  L1 and L2 must have the same line size (ERR_SIZE otherwise).
+ *  Each cache evicts according to its own replacement policy (see cache_config_t).
+ *  Accesses to L1, and to L2 on an L1 miss, are counted in the stats of each cache.
+ *  With write-back caches (see cache.h), a dirty victim of L2 is written to
+ *  memory, which is thus modified by reads too.
+ *  The inclusive and NINE policies (config.inclusion of L2, see cache.h)
+ *  keep a copy of the lines of L1 in L2 instead.
+ *  An L2 miss is served by L3 if one is attached to L2 (see cache_attach_next()),
+ *  by memory otherwise.
+ *  A cache with a prefetcher (config.prefetch, see cache_prefetch.h) first
+ *  fills its oldest prefetch in flight; prefetches are not counted as accesses.
+ *  The level that served the access (L1, L2, L3 or MAIN_MEMORY) is left in
+ *  l1_cache->served, for latency models.
  *
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
@@ -116,16 +149,14 @@ int cache_entry_init(const void * mem_space,
  * @param l1_cache pointer to the beginning of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
  * @param word pointer to the word of data that is returned by cache
- * @param replace replacement policy
  * @return error code
  */
-int cache_read(const void * mem_space,
+int cache_read(void * mem_space,
                phy_addr_t * paddr,
                mem_access_t access,
-               void * l1_cache,
-               void * l2_cache,
-               uint32_t * word,
-               cache_replace_t replace);
+               cache_level_t * l1_cache,
+               cache_level_t * l2_cache,
+               uint32_t * word);
 
 //=========================================================================
 /**
@@ -137,36 +168,34 @@ int cache_read(const void * mem_space,
  * @param l1_cache pointer to the beginning of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
  * @param byte pointer to the byte to be returned
- * @param replace replacement policy
  * @return error code
  */
-int cache_read_byte(const void * mem_space,
+int cache_read_byte(void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
-                    void * l1_cache,
-                    void * l2_cache,
-                    uint8_t * p_byte,
-                    cache_replace_t replace);
+                    cache_level_t * l1_cache,
+                    cache_level_t * l2_cache,
+                    uint8_t * p_byte);
 
 //=========================================================================
 /**
  * @brief Change a word of data in the cache.
  *  Exclusive policy (see cache_read)
+ *  The word is written to memory too (write-through), or the line is
+ *  marked dirty (write-back, if config.write_back of L1).
  *
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
  * @param l1_cache pointer to the beginning of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
  * @param word const pointer to the word of data that is to be written to the cache
- * @param replace replacement policy
  * @return error code
  */
 int cache_write(void * mem_space,
                 phy_addr_t * paddr,
-                void * l1_cache,
-                void * l2_cache,
-                const uint32_t * word,
-                cache_replace_t replace);
+                cache_level_t * l1_cache,
+                cache_level_t * l2_cache,
+                const uint32_t * word);
 
 //=========================================================================
 /**
@@ -177,22 +206,76 @@ int cache_write(void * mem_space,
  * @param l1_cache pointer to the beginning of L1 ICACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
  * @param p_byte pointer to the byte to be returned
- * @param replace replacement policy
  * @return error code
  */
 int cache_write_byte(void * mem_space,
                      phy_addr_t * paddr,
-                     void * l1_cache,
-                     void * l2_cache,
-                     uint8_t* p_byte,
-                     cache_replace_t replace);
+                     cache_level_t * l1_cache,
+                     cache_level_t * l2_cache,
+                     uint8_t* p_byte);
+
+//=========================================================================
+/**
+ * @brief Writes the dirty lines of a cache back to memory; they stay in
+ * the cache, clean. Each line written is counted as a writeback
+ * (STAT_WRITEBACKS, data accesses).
+ *  Write L2 back before the L1 caches, so that the last copy of a line wins.
+ *
+ * @param mem_space pointer to the memory space
+ * @param cache pointer to the cache
+ * @return error code
+ */
+int cache_write_back(void * mem_space, cache_level_t * cache);
 
 //=========================================================================
 /**
  * @brief Print the contents of a cache to a stream.
+ * The lines of a sliced cache (L3) are printed slice after slice.
  * @param output the stream to print to.
  * @param cache pointer to the cache
- * @param cache_type to distinguish between different caches
  * @return error code
  */
-int cache_dump(FILE* output, const void* cache, cache_t cache_type);
+int cache_dump(FILE* output, const cache_level_t * cache);
+
+//=========================================================================
+/**
+ * @brief Print the statistics of a cache to a stream.
+ * @param output the stream to print to.
+ * @param format text or CSV (see stats_print())
+ * @param cache pointer to the cache
+ * @return error code
+ */
+int cache_stats_print(FILE* output, stats_format_t format, const cache_level_t * cache);
+
+//=========================================================================
+/**
+ * @brief Attaches an inner cache to a cache: an inclusive cache
+ * back-invalidates the lines it evicts in its inner caches (see cache.h).
+ * The L1 cache of an access is always back-invalidated, attached or not.
+ *
+ * @param cache (modified) the outer cache (L2)
+ * @param inner an inner cache (L1), at most CACHE_MAX_INNER of them
+ * @return error code
+ */
+int cache_attach_inner(cache_level_t * cache, cache_level_t * inner);
+
+//=========================================================================
+/**
+ * @brief Puts a cache (L3) below another one (L2): L2 misses are read from
+ * it and dirty lines leaving L2 are written into it (see cache.h). L2 and
+ * its inner caches, attached before, become inner caches of L3.
+ *
+ * @param cache (modified) the cache above (L2)
+ * @param next (modified) the level below, of the same line size, inclusive or NINE
+ * @return error code
+ */
+int cache_attach_next(cache_level_t * cache, cache_level_t * next);
+
+//=========================================================================
+/**
+ * @brief Parses the name of an inclusion policy ("exclusive", "inclusive" or "nine").
+ * @param name the name to parse
+ * @param inclusion (modified) the policy
+ * @return error code (ERR_POLICY if the name is unknown)
+ */
+int cache_inclusion_from_name(const char * name, cache_inclusion_t * inclusion);
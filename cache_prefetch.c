@@ -0,0 +1,286 @@
+/**
+ * @file cache_prefetch.c
+ * @brief hardware prefetchers of the caches
+ *
+ * @date 2019
+ */
+
+#include "cache_prefetch.h"
+#include "error.h"
+#include "util.h" // zero_init_ptr
+#include <stdlib.h> // calloc, strtoul
+#include <string.h> // strchr, strlen, strncmp
+#include <inttypes.h> // PRIu8
+
+// ======================================================================
+/**
+ * @brief Queues the prefetch of line (in the page of the trigger), unless
+ * outside the page, already in flight or the queue is full.
+ */
+static void propose(const cache_level_t * cache, cache_prefetch_state_t * state, uint32_t page, int32_t line)
+{
+	if (line < 0 || line >= (int32_t) (PAGE_SIZE >> cache->line_bits)) return;
+
+	const uint32_t addr = page << PAGE_OFFSET | (uint32_t) line << cache->line_bits;
+	for (uint8_t i = 0; i < state->queued; ++i)
+		if (state->queue[(state->head + i) % CACHE_PREFETCH_QUEUE] == addr) return;
+	if (state->queued == CACHE_PREFETCH_QUEUE) return;
+
+	state->queue[(state->head + state->queued) % CACHE_PREFETCH_QUEUE] = addr;
+	++state->queued;
+}
+
+// ======================================================================
+/**
+ * @brief The stream of a page; a new one (replacing the oldest) starting
+ * at line if the page has none.
+ * @return the stream, NULL if it is new
+ */
+static cache_stream_t * stream_of(cache_prefetch_state_t * state, uint32_t page, int32_t line)
+{
+	for (size_t i = 0; i < CACHE_PREFETCH_STREAMS; ++i)
+		if (state->streams[i].page == page + 1) return &state->streams[i];
+
+	cache_stream_t * stream = &state->streams[state->next_stream];
+	state->next_stream = (uint8_t) ((state->next_stream + 1) % CACHE_PREFETCH_STREAMS);
+	zero_init_ptr(stream);
+	stream->page = page + 1;
+	stream->last = line;
+	stream->ahead = line;
+	return NULL;
+}
+
+// ======================================================================
+/*
+ * Next-line: degree lines, distance lines after the trigger.
+ */
+static void next_line_train(cache_level_t * cache, cache_prefetch_state_t * state, uint32_t addr)
+{
+	const uint32_t page = addr >> PAGE_OFFSET;
+	const int32_t line = (int32_t) ((addr & (PAGE_SIZE - 1)) >> cache->line_bits);
+	for (uint8_t i = 0; i < cache->config.prefetch.degree; ++i)
+		propose(cache, state, page, line + cache->config.prefetch.distance + i);
+}
+
+// ======================================================================
+/*
+ * Stride: once the same stride (in lines) separates the last triggers of
+ * a page, the lines distance, distance + 1, ... strides ahead. A new
+ * stride restarts the learning.
+ */
+static void stride_train(cache_level_t * cache, cache_prefetch_state_t * state, uint32_t addr)
+{
+	const uint32_t page = addr >> PAGE_OFFSET;
+	const int32_t line = (int32_t) ((addr & (PAGE_SIZE - 1)) >> cache->line_bits);
+	cache_stream_t * stream = stream_of(state, page, line);
+	if (stream == NULL || line == stream->last) return;
+
+	const int32_t stride = line - stream->last;
+	if (stride == stream->stride)
+		{
+			if (stream->confidence < CACHE_PREFETCH_CONFIDENT) ++stream->confidence;
+		}
+	else
+		{
+			stream->stride = stride;
+			stream->confidence = 0;
+		}
+	stream->last = line;
+	if (stream->confidence < CACHE_PREFETCH_CONFIDENT) return;
+
+	for (uint8_t i = 0; i < cache->config.prefetch.degree; ++i)
+		propose(cache, state, page, line + stride * (cache->config.prefetch.distance + i));
+}
+
+// ======================================================================
+/*
+ * Streamer: once the triggers of a page go the same way (ascending or
+ * descending, whatever the step), keeps the prefetches up to distance
+ * lines ahead of the last trigger, at most degree new lines per trigger.
+ * A change of direction restarts the learning.
+ */
+static void streamer_train(cache_level_t * cache, cache_prefetch_state_t * state, uint32_t addr)
+{
+	const uint32_t page = addr >> PAGE_OFFSET;
+	const int32_t line = (int32_t) ((addr & (PAGE_SIZE - 1)) >> cache->line_bits);
+	cache_stream_t * stream = stream_of(state, page, line);
+	if (stream == NULL || line == stream->last) return;
+
+	const int32_t direction = line > stream->last ? 1 : -1;
+	if (direction == stream->stride)
+		{
+			if (stream->confidence < CACHE_PREFETCH_CONFIDENT) ++stream->confidence;
+		}
+	else
+		{
+			stream->stride = direction;
+			stream->confidence = 0;
+		}
+	stream->last = line;
+	// the stream went past its prefetches: start again from the trigger
+	if ((stream->ahead - line) * direction < 0) stream->ahead = line;
+	if (stream->confidence < CACHE_PREFETCH_CONFIDENT) return;
+
+	for (uint8_t i = 0; i < cache->config.prefetch.degree
+	     && (stream->ahead + direction - line) * direction <= (int32_t) cache->config.prefetch.distance; ++i)
+		{
+			stream->ahead += direction;
+			propose(cache, state, page, stream->ahead);
+		}
+}
+
+// ======================================================================
+static const cache_prefetcher_t prefetchers[NB_CACHE_PREFETCH] =
+{
+	[NO_PREFETCH] = { "none",      0, 0,  NULL },
+	[NEXT_LINE]   = { "next-line", 1, 1,  next_line_train },
+	[STRIDE]      = { "stride",    1, 1,  stride_train },
+	[STREAMER]    = { "streamer",  2, 16, streamer_train },
+};
+
+// ======================================================================
+// see cache_prefetch.h
+const cache_prefetcher_t * cache_prefetcher_of(cache_prefetch_t kind)
+{
+	if ((unsigned) kind >= NB_CACHE_PREFETCH) return NULL;
+	return &prefetchers[kind];
+}
+
+// ======================================================================
+// see cache_prefetch.h
+int cache_prefetch_from_name(const char * arg, cache_prefetch_config_t * config)
+{
+	M_REQUIRE_NON_NULL(arg);
+	M_REQUIRE_NON_NULL(config);
+
+	const char * colon = strchr(arg, ':');
+	const size_t length = colon != NULL ? (size_t) (colon - arg) : strlen(arg);
+	for (unsigned i = 0; i < NB_CACHE_PREFETCH; ++i)
+		{
+			if (strncmp(arg, prefetchers[i].name, length) != 0 || prefetchers[i].name[length] != '\0') continue;
+
+			config->kind = (cache_prefetch_t) i;
+			config->degree = prefetchers[i].degree;
+			config->distance = prefetchers[i].distance;
+			if (colon == NULL) return ERR_NONE;
+
+			char * end = NULL;
+			const unsigned long degree = strtoul(colon + 1, &end, 10);
+			unsigned long distance = config->distance;
+			if (*end == ':') distance = strtoul(end + 1, &end, 10);
+			M_REQUIRE(*end == '\0' && degree <= UINT8_MAX && distance <= UINT8_MAX, ERR_BAD_PARAMETER,
+			          "%s: expected NAME[:DEGREE[:DISTANCE]]", arg);
+			config->degree = (uint8_t) degree;
+			config->distance = (uint8_t) distance;
+			return ERR_NONE;
+		}
+	M_EXIT(ERR_POLICY, "%s: unknown prefetcher", arg);
+}
+
+// ======================================================================
+// see cache_prefetch.h
+int cache_prefetch_init(cache_level_t * cache)
+{
+	M_REQUIRE_NON_NULL(cache);
+	const cache_prefetch_config_t * config = &cache->config.prefetch;
+	M_REQUIRE(cache_prefetcher_of(config->kind) != NULL, ERR_POLICY, "%d: unknown prefetcher", config->kind);
+
+	cache->prefetch = NULL;
+	if (config->kind == NO_PREFETCH) return ERR_NONE;
+
+	M_REQUIRE(config->degree >= 1 && config->degree <= CACHE_PREFETCH_MAX_DEGREE, ERR_BAD_PARAMETER,
+	          "%" PRIu8 ": prefetch degree must be in [1, %u]", config->degree, CACHE_PREFETCH_MAX_DEGREE);
+	M_REQUIRE(config->distance >= 1 && config->distance <= CACHE_PREFETCH_MAX_DISTANCE, ERR_BAD_PARAMETER,
+	          "%" PRIu8 ": prefetch distance must be in [1, %u]", config->distance, CACHE_PREFETCH_MAX_DISTANCE);
+
+	cache->prefetch = calloc(1, sizeof(cache_prefetch_state_t));
+	M_EXIT_IF_NULL(cache->prefetch, sizeof(cache_prefetch_state_t));
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see cache_prefetch.h
+void cache_prefetch_free(cache_level_t * cache)
+{
+	if (cache != NULL)
+		{
+			free(cache->prefetch);
+			cache->prefetch = NULL;
+		}
+}
+
+// ======================================================================
+// see cache_prefetch.h
+void cache_prefetch_reset(cache_level_t * cache)
+{
+	if (cache != NULL && cache->prefetch != NULL) zero_init_ptr(cache->prefetch);
+}
+
+// ======================================================================
+// see cache_prefetch.h
+void cache_prefetch_train(cache_level_t * cache, uint32_t addr)
+{
+	if (cache->prefetch == NULL) return;
+	prefetchers[cache->config.prefetch.kind].train(cache, cache->prefetch, addr);
+}
+
+// ======================================================================
+// see cache_prefetch.h
+int cache_prefetch_pop(cache_level_t * cache, uint32_t * addr)
+{
+	cache_prefetch_state_t * state = cache->prefetch;
+	if (state == NULL || state->queued == 0) return 0;
+
+	*addr = state->queue[state->head];
+	state->head = (uint8_t) ((state->head + 1) % CACHE_PREFETCH_QUEUE);
+	--state->queued;
+	return 1;
+}
+
+// ======================================================================
+// see cache_prefetch.h
+int cache_prefetch_cancel(cache_level_t * cache, uint32_t addr)
+{
+	cache_prefetch_state_t * state = cache->prefetch;
+	if (state == NULL) return 0;
+
+	const uint32_t line_addr = addr & ~(uint32_t) ((1u << cache->line_bits) - 1u);
+	for (uint8_t i = 0; i < state->queued; ++i)
+		{
+			if (state->queue[(state->head + i) % CACHE_PREFETCH_QUEUE] != line_addr) continue;
+			// close the gap, keeping the order of the others
+			for (uint8_t j = i; j + 1 < state->queued; ++j)
+				state->queue[(state->head + j) % CACHE_PREFETCH_QUEUE] =
+				    state->queue[(state->head + j + 1) % CACHE_PREFETCH_QUEUE];
+			--state->queued;
+			return 1;
+		}
+	return 0;
+}
+
+// ======================================================================
+/**
+ * @brief the entry of a line in the filter of evicted lines
+ */
+#define evicted_of(STATE, CACHE, ADDR) \
+	(STATE)->evicted[((ADDR) >> (CACHE)->line_bits) & (CACHE_PREFETCH_FILTER - 1u)]
+
+// ======================================================================
+// see cache_prefetch.h
+void cache_prefetch_evicted(cache_level_t * cache, uint32_t addr)
+{
+	if (cache->prefetch == NULL) return;
+	evicted_of(cache->prefetch, cache, addr) = addr | 1u;
+}
+
+// ======================================================================
+// see cache_prefetch.h
+int cache_prefetch_polluted(cache_level_t * cache, uint32_t addr)
+{
+	if (cache->prefetch == NULL) return 0;
+
+	const uint32_t key = (addr & ~(uint32_t) ((1u << cache->line_bits) - 1u)) | 1u;
+	if (evicted_of(cache->prefetch, cache, addr) != key) return 0;
+	evicted_of(cache->prefetch, cache, addr) = 0;
+	return 1;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+/**
+ * @file cache_prefetch.h
+ * @brief hardware prefetchers of the caches
+ *
+ * A prefetcher is trained by the demand misses of its cache and by the
+ * first demand hit on a prefetched line (which would have been a miss
+ * without it), see cache_prefetch_train(). It proposes lines, which wait
+ * in a queue of CACHE_PREFETCH_QUEUE prefetches in flight; the cache
+ * fills the oldest one before each of its demand accesses (see
+ * cache_mng.c). A demand miss on a line still in the queue is a late
+ * prefetch. The lines a prefetch evicts are remembered in a small filter
+ * to count the demand misses they cause (polluting prefetches).
+ *
+ * As traces carry no program counter, streams are told apart by their 4 kiB
+ * page, as the L2 streamer of Intel does; a prefetch never crosses the page
+ * of its trigger, which is the last one known to be mapped.
+ *
+ * @date 2019
+ */
+
+#include "cache.h"
+
+/*
+ * Bounds of cache_prefetch_config_t and sizes of the prefetcher state
+ */
+#define CACHE_PREFETCH_MAX_DEGREE   8u
+#define CACHE_PREFETCH_MAX_DISTANCE 64u
+#define CACHE_PREFETCH_STREAMS      16u  // pages tracked by STRIDE and STREAMER
+#define CACHE_PREFETCH_QUEUE        16u  // prefetches in flight
+#define CACHE_PREFETCH_FILTER       256u // lines evicted by prefetches, a power of 2
+#define CACHE_PREFETCH_CONFIDENT    1u   // repeats of a stride or direction needed to prefetch
+
+/**
+ * @brief A stream: the misses in a page (STRIDE, STREAMER).
+ */
+typedef struct
+{
+	uint32_t page;       // page number + 1, 0 for a free entry
+	int32_t last;        // line (in the page) of the last trigger
+	int32_t stride;      // in lines (STRIDE), or the direction, 1 or -1 (STREAMER)
+	int32_t ahead;       // last line proposed (STREAMER)
+	uint8_t confidence;  // repeats of the stride, saturates at CACHE_PREFETCH_CONFIDENT
+} cache_stream_t;
+
+/**
+ * @brief The state of the prefetcher of a cache.
+ */
+typedef struct cache_prefetch_state
+{
+	cache_stream_t streams[CACHE_PREFETCH_STREAMS];
+	uint8_t next_stream;                   // the stream replaced next (round robin)
+	uint32_t queue[CACHE_PREFETCH_QUEUE];  // addresses of the lines in flight, oldest at head
+	uint8_t head;
+	uint8_t queued;
+	uint32_t evicted[CACHE_PREFETCH_FILTER]; // line address | 1 of lines evicted by prefetches, 0 if none
+} cache_prefetch_state_t;
+
+/**
+ * @brief The functions of a prefetcher.
+ */
+typedef struct cache_prefetcher
+{
+	const char * name;
+	uint8_t degree;   // default degree
+	uint8_t distance; // default distance
+
+	/** @brief learns from a trigger at addr and proposes lines (NULL for NO_PREFETCH) */
+	void (*train)(cache_level_t * cache, cache_prefetch_state_t * state, uint32_t addr);
+
+} cache_prefetcher_t;
+
+//=========================================================================
+/**
+ * @brief The functions of a prefetcher.
+ * @param kind the prefetcher
+ * @return the prefetcher functions, NULL if kind is not a prefetcher
+ */
+const cache_prefetcher_t * cache_prefetcher_of(cache_prefetch_t kind);
+
+//=========================================================================
+/**
+ * @brief Parses a prefetcher as NAME[:DEGREE[:DISTANCE]] (NAME as in
+ * cache_prefetcher_t.name, e.g. "stride:2:4"); the default degree and
+ * distance of the prefetcher are used if missing.
+ * @param arg the text to parse
+ * @param config (modified) the prefetcher
+ * @return error code (ERR_POLICY if the name is unknown)
+ */
+int cache_prefetch_from_name(const char * arg, cache_prefetch_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Creates the state of the prefetcher of a cache, if any (called by cache_init()).
+ * @param cache the cache, with its config
+ * @return error code
+ */
+int cache_prefetch_init(cache_level_t * cache);
+
+//=========================================================================
+/**
+ * @brief Frees the state of the prefetcher of a cache.
+ * @param cache the cache
+ */
+void cache_prefetch_free(cache_level_t * cache);
+
+//=========================================================================
+/**
+ * @brief Forgets the streams, the prefetches in flight and the evicted lines.
+ * @param cache the cache
+ */
+void cache_prefetch_reset(cache_level_t * cache);
+
+//=========================================================================
+/**
+ * @brief Trains the prefetcher of a cache (if any) on a trigger.
+ * @param cache the cache
+ * @param addr the address of the trigger
+ */
+void cache_prefetch_train(cache_level_t * cache, uint32_t addr);
+
+//=========================================================================
+/**
+ * @brief Takes the oldest prefetch in flight.
+ * @param cache the cache
+ * @param addr (modified) the address of the first byte of its line
+ * @return 1 if there was one, 0 otherwise
+ */
+int cache_prefetch_pop(cache_level_t * cache, uint32_t * addr);
+
+//=========================================================================
+/**
+ * @brief Cancels the prefetch in flight of the line of addr (a demand miss came first).
+ * @param cache the cache
+ * @param addr an address of the line
+ * @return 1 if it was in flight (a late prefetch), 0 otherwise
+ */
+int cache_prefetch_cancel(cache_level_t * cache, uint32_t addr);
+
+//=========================================================================
+/**
+ * @brief Remembers a line evicted by a prefetch.
+ * @param cache the cache
+ * @param addr the address of the first byte of the line
+ */
+void cache_prefetch_evicted(cache_level_t * cache, uint32_t addr);
+
+//=========================================================================
+/**
+ * @brief Tells if a line was evicted by a prefetch, and forgets it.
+ * @param cache the cache
+ * @param addr an address of the line
+ * @return 1 if the line was evicted by a prefetch, 0 otherwise
+ */
+int cache_prefetch_polluted(cache_level_t * cache, uint32_t addr);
@@ -0,0 +1,238 @@
+/**
+ * @file cache_replace.c
+ * @brief replacement policies of the caches
+ *
+ * @date 2019
+ */
+
+#include "cache_replace.h"
+#include "cache_mng.h" // foreach_way
+#include "error.h"
+#include "lru.h"
+#include <string.h> // strcmp
+
+// ======================================================================
+static uint64_t cache_random(cache_level_t * cache)
+{
+	// xorshift64, never 0 as the state is seeded with a non zero value
+	uint64_t x = cache->rng;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return cache->rng = x;
+}
+
+// ======================================================================
+static void no_update(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	(void) cache;
+	(void) line_index;
+	(void) way;
+}
+
+// ======================================================================
+static uint8_t age_state(const cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	return cache_age(cache, line_index, way);
+}
+
+// ======================================================================
+/*
+ * LRU and FIFO: ages. A new entry gets age 0 and the others get older;
+ * LRU also rejuvenates an entry on hit. The oldest entry is evicted
+ * (the last one in case of a tie). The age of the new entry is already
+ * 0 when fill is called (cache_insert()), hence LRU_age_increase() rather
+ * than LRU_age_update() also after an eviction.
+ */
+static void lru_hit(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	LRU_age_update(cache, cache->config.ways, way, line_index);
+}
+
+static void age_fill(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	LRU_age_increase(cache, cache->config.ways, way, line_index);
+}
+
+static uint8_t oldest_victim(cache_level_t * cache, uint16_t line_index)
+{
+	uint8_t max_age = 0;
+	uint8_t way = 0;
+	foreach_way(i, cache->config.ways)
+	{
+		if (cache_age(cache, line_index, i) >= max_age)
+			{
+				max_age = cache_age(cache, line_index, i);
+				way = i;
+			}
+	}
+	return way;
+}
+
+// ======================================================================
+/*
+ * Tree pseudo-LRU: ways - 1 nodes of a binary tree stored as a heap
+ * (root 1, children 2n and 2n+1) in the bits of the line. A node bit
+ * points to the half (0: left, 1: right) to evict from; an access makes
+ * every node on the path of its way point away from it.
+ */
+static void tree_plru_touch(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	uint16_t bits = cache_bits(cache, line_index);
+	for (unsigned node = way + cache->config.ways; node > 1; node >>= 1)
+		{
+			const unsigned parent = node >> 1;
+			if (node & 1u)
+				bits &= (uint16_t) ~(1u << parent); // came from the right: point left
+			else
+				bits |= (uint16_t) (1u << parent);
+		}
+	cache_bits(cache, line_index) = bits;
+}
+
+static void tree_plru_fill(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	tree_plru_touch(cache, line_index, way);
+}
+
+static uint8_t tree_plru_victim(cache_level_t * cache, uint16_t line_index)
+{
+	const uint16_t bits = cache_bits(cache, line_index);
+	unsigned node = 1;
+	while (node < cache->config.ways)
+		node = 2 * node + ((bits >> node) & 1u);
+	return (uint8_t) (node - cache->config.ways);
+}
+
+static uint8_t tree_plru_state(const cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	// the number of nodes pointing to the way: log_2(ways) for the victim
+	const uint16_t bits = cache_bits(cache, line_index);
+	uint8_t toward = 0;
+	for (unsigned node = way + cache->config.ways; node > 1; node >>= 1)
+		if (((bits >> (node >> 1)) & 1u) == (node & 1u))
+			++toward;
+	return toward;
+}
+
+// ======================================================================
+/*
+ * Bit pseudo-LRU: one MRU bit per way, set on access; when all would be
+ * set, only the accessed one is kept. The first way whose bit is clear is
+ * evicted.
+ */
+static void bit_plru_touch(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	const uint16_t all = (uint16_t) ((1u << cache->config.ways) - 1);
+	uint16_t bits = cache_bits(cache, line_index) | (uint16_t) (1u << way);
+	if ((bits & all) == all)
+		bits = (uint16_t) (1u << way);
+	cache_bits(cache, line_index) = bits;
+}
+
+static void bit_plru_fill(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	bit_plru_touch(cache, line_index, way);
+}
+
+static uint8_t bit_plru_victim(cache_level_t * cache, uint16_t line_index)
+{
+	const uint32_t clear = ~(uint32_t) cache_bits(cache, line_index) & ((1u << cache->config.ways) - 1);
+	return clear != 0 ? (uint8_t) __builtin_ctz(clear) : 0; // 0 only with a single way
+}
+
+static uint8_t bit_plru_state(const cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	return (cache_bits(cache, line_index) >> way) & 1u;
+}
+
+// ======================================================================
+static void random_fill(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	cache_age(cache, line_index, way) = 0;
+}
+
+static uint8_t random_victim(cache_level_t * cache, uint16_t line_index)
+{
+	(void) line_index;
+	return (uint8_t) (cache_random(cache) % cache->config.ways);
+}
+
+// ======================================================================
+/*
+ * SRRIP and BRRIP: a re-reference prediction value (RRPV) per way, 0 on
+ * hit. The first way predicted for a distant re-reference (RRIP_MAX) is
+ * evicted, after aging all the ways until there is one.
+ */
+static void rrip_hit(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	cache_age(cache, line_index, way) = 0;
+}
+
+static void srrip_fill(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	cache_age(cache, line_index, way) = RRIP_LONG;
+}
+
+static void brrip_fill(cache_level_t * cache, uint16_t line_index, uint8_t way)
+{
+	cache_age(cache, line_index, way) =
+	    cache_random(cache) % BRRIP_LONG_PERIOD == 0 ? RRIP_LONG : RRIP_MAX;
+}
+
+static uint8_t rrip_victim(cache_level_t * cache, uint16_t line_index)
+{
+	uint8_t max_rrpv = 0;
+	foreach_way(i, cache->config.ways)
+	{
+		if (cache_age(cache, line_index, i) > max_rrpv)
+			max_rrpv = cache_age(cache, line_index, i);
+	}
+	const uint8_t way_older = (uint8_t) (RRIP_MAX - max_rrpv);
+	uint8_t way = HIT_WAY_MISS;
+	foreach_way(i, cache->config.ways)
+	{
+		cache_age(cache, line_index, i) = (uint8_t) (cache_age(cache, line_index, i) + way_older);
+		if (way == HIT_WAY_MISS && cache_age(cache, line_index, i) == RRIP_MAX)
+			way = i;
+	}
+	return way;
+}
+
+// ======================================================================
+static const cache_policy_t policies[NB_CACHE_REPLACE] =
+{
+	[LRU]       = { "lru",       lru_hit,          age_fill,       oldest_victim,    age_state },
+	[TREE_PLRU] = { "tree-plru", tree_plru_touch,  tree_plru_fill, tree_plru_victim, tree_plru_state },
+	[BIT_PLRU]  = { "bit-plru",  bit_plru_touch,   bit_plru_fill,  bit_plru_victim,  bit_plru_state },
+	[FIFO]      = { "fifo",      no_update,        age_fill,       oldest_victim,    age_state },
+	[RANDOM]    = { "random",    no_update,        random_fill,    random_victim,    age_state },
+	[SRRIP]     = { "srrip",     rrip_hit,         srrip_fill,     rrip_victim,      age_state },
+	[BRRIP]     = { "brrip",     rrip_hit,         brrip_fill,     rrip_victim,      age_state },
+};
+
+// ======================================================================
+// see cache_replace.h
+const cache_policy_t * cache_policy_of(cache_replace_t replace)
+{
+	if ((unsigned) replace >= NB_CACHE_REPLACE) return NULL;
+	return &policies[replace];
+}
+
+// ======================================================================
+// see cache_replace.h
+int cache_replace_from_name(const char * name, cache_replace_t * replace)
+{
+	M_REQUIRE_NON_NULL(name);
+	M_REQUIRE_NON_NULL(replace);
+
+	for (unsigned i = 0; i < NB_CACHE_REPLACE; ++i)
+		{
+			if (strcmp(name, policies[i].name) == 0)
+				{
+					*replace = (cache_replace_t) i;
+					return ERR_NONE;
+				}
+		}
+	M_EXIT(ERR_POLICY, "%s: unknown replacement policy", name);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/**
+ * @file cache_replace.h
+ * @brief replacement policies of the caches
+ *
+ * A policy only decides which valid way of a line is evicted: invalid
+ * ways are always filled first (see cache_mng.c). Its state lives in the
+ * cache: one age per way (LRU, FIFO) or one 2-bit re-reference prediction
+ * value per way (SRRIP, BRRIP) in cache->ages, one 16-bit word per line
+ * (TREE_PLRU, BIT_PLRU) in cache->bits, and one generator per cache
+ * (RANDOM, BRRIP) in cache->rng.
+ *
+ * @date 2019
+ */
+
+#include "cache.h"
+
+/**
+ * @brief The functions of a replacement policy.
+ */
+typedef struct cache_policy
+{
+	const char * name;
+
+	/** @brief updates the state after a hit on way */
+	void (*hit)(cache_level_t * cache, uint16_t line_index, uint8_t way);
+
+	/** @brief updates the state after an entry was put in way (invalid or victim) */
+	void (*fill)(cache_level_t * cache, uint16_t line_index, uint8_t way);
+
+	/** @brief the way to evict from a line whose ways are all valid */
+	uint8_t (*victim)(cache_level_t * cache, uint16_t line_index);
+
+	/** @brief the per-way state shown by cache_dump() in the AGE column */
+	uint8_t (*state)(const cache_level_t * cache, uint16_t line_index, uint8_t way);
+
+} cache_policy_t;
+
+/*
+ * Re-reference prediction values of SRRIP and BRRIP
+ */
+#define RRIP_MAX  3u // distant re-reference, evicted first
+#define RRIP_LONG 2u // insertion value of SRRIP
+#define BRRIP_LONG_PERIOD 32u // BRRIP inserts with RRIP_LONG once every (about) that many fills
+
+//=========================================================================
+/**
+ * @brief The functions of a replacement policy.
+ * @param replace the policy
+ * @return the policy functions, NULL if replace is not a policy
+ */
+const cache_policy_t * cache_policy_of(cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Parses the name of a policy (as in cache_policy_t.name, e.g. "lru", "srrip").
+ * @param name the name to parse
+ * @param replace (modified) the policy
+ * @return error code (ERR_POLICY if the name is unknown)
+ */
+int cache_replace_from_name(const char * name, cache_replace_t * replace);
@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+ * @file cmd_source.h
+ * @brief a source of commands (see commands.h) read one at a time
+ *
+ * A command source hides where commands come from: a program in text
+ * format, read through a fixed-size buffer; a binary trace (see trace.h);
+ * or a program_t already in memory. Reading a file this way needs the
+ * same memory whatever its length.
+ *
+ * @date 2019
+ */
+
+#include <stdio.h> // FILE
+#include <stddef.h> // size_t
+#include "commands.h"
+#include "trace.h"
+
+// size of the buffer of a text source, in bytes
+#ifndef CMD_TEXT_BUFFER_SIZE
+#define CMD_TEXT_BUFFER_SIZE 65536u
+#endif
+
+typedef enum
+{
+	CMD_SOURCE_TEXT, CMD_SOURCE_TRACE, CMD_SOURCE_PROGRAM
+} cmd_source_kind_t;
+
+/**
+ * @brief Buffered reader of a program in text format.
+ */
+typedef struct
+{
+	FILE * file;
+	char * buffer; // CMD_TEXT_BUFFER_SIZE bytes
+	size_t pos;    // next byte of buffer to read
+	size_t len;    // bytes of buffer filled
+	size_t line;   // current line, from 1, for error messages
+} cmd_text_reader_t;
+
+/**
+ * @brief A source of commands.
+ */
+typedef struct
+{
+	cmd_source_kind_t kind;
+	union
+	{
+		cmd_text_reader_t text;
+		trace_t trace;
+		struct
+		{
+			const program_t * program; // not owned
+			size_t next;
+		} program;
+	} from;
+	size_t nb_commands; // commands returned so far
+} cmd_source_t;
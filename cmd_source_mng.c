@@ -0,0 +1,267 @@
+/**
+ * @file cmd_source_mng.c
+ * @brief pulling commands one at a time, and the parser of the text format
+ *
+ * @date 2019
+ */
+
+#include "cmd_source_mng.h"
+#include "trace_mng.h"
+#include "addr_mng.h"
+#include "error.h"
+#include "util.h" // zero_init_ptr
+
+#include <stdlib.h> // malloc
+#include <ctype.h>  // isspace, isxdigit
+
+// ======================================================================
+// see cmd_source_mng.h
+int cmd_source_open(cmd_source_t * source, const char * filename)
+{
+	M_REQUIRE_NON_NULL(source);
+	M_REQUIRE_NON_NULL(filename);
+	zero_init_ptr(source);
+
+	const int err = trace_open(filename, &source->from.trace);
+	if (err == ERR_NONE)
+		{
+			source->kind = CMD_SOURCE_TRACE;
+			return ERR_NONE;
+		}
+	// not a trace: text
+	M_REQUIRE(err == ERR_IO, err, "%s: truncated trace", filename);
+	return cmd_source_open_text(source, filename);
+}
+
+// ======================================================================
+// see cmd_source_mng.h
+int cmd_source_open_text(cmd_source_t * source, const char * filename)
+{
+	M_REQUIRE_NON_NULL(source);
+	M_REQUIRE_NON_NULL(filename);
+	zero_init_ptr(source);
+	source->kind = CMD_SOURCE_TEXT;
+
+	cmd_text_reader_t * const text = &source->from.text;
+	text->buffer = malloc(CMD_TEXT_BUFFER_SIZE);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(text->buffer, ERR_MEM);
+	text->file = fopen(filename, "r");
+	if (text->file == NULL)
+		{
+			free(text->buffer);
+			text->buffer = NULL;
+			return ERR_IO;
+		}
+	// the reader does its own buffering
+	setvbuf(text->file, NULL, _IONBF, 0);
+	text->line = 1;
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see cmd_source_mng.h
+int cmd_source_from_program(cmd_source_t * source, const program_t * program)
+{
+	M_REQUIRE_NON_NULL(source);
+	M_REQUIRE_NON_NULL(program);
+	zero_init_ptr(source);
+	source->kind = CMD_SOURCE_PROGRAM;
+	source->from.program.program = program;
+	return ERR_NONE;
+}
+
+// ======================================================================
+static int text_getc(cmd_text_reader_t * text)
+{
+	if (text->pos == text->len)
+		{
+			text->len = fread(text->buffer, 1, CMD_TEXT_BUFFER_SIZE, text->file);
+			text->pos = 0;
+			if (text->len == 0) return EOF;
+		}
+	return (unsigned char) text->buffer[text->pos++];
+}
+
+// only right after a text_getc() that did not return EOF
+#define text_ungetc(TEXT) --(TEXT)->pos
+
+// ======================================================================
+static int text_next_nonspace(cmd_text_reader_t * text)
+{
+	int c = EOF;
+	do
+		{
+			c = text_getc(text);
+			if (c == '\n') ++text->line;
+		}
+	while (c != EOF && isspace(c));
+	return c;
+}
+
+// ======================================================================
+/*
+ * Reads an hexadecimal number, as fscanf("%" SCNx64) does:
+ * leading spaces, then an optional "0x" and at least one digit.
+ */
+static int text_read_hex(cmd_text_reader_t * text, uint64_t * value)
+{
+	int c = text_next_nonspace(text);
+	if (c == '0')
+		{
+			c = text_getc(text);
+			if (c == 'x' || c == 'X')
+				c = text_getc(text);
+			else if (c != EOF)
+				{
+					// the 0 was a digit
+					text_ungetc(text);
+					c = '0';
+				}
+			else
+				c = '0';
+		}
+	M_REQUIRE(c != EOF && isxdigit(c), ERR_BAD_PARAMETER, "line %zu: hexadecimal number expected", text->line);
+
+	uint64_t v = 0;
+	int nb_digits = 0;
+	for (; c != EOF && isxdigit(c); c = text_getc(text), ++nb_digits)
+		{
+			M_REQUIRE(nb_digits < 16, ERR_BAD_PARAMETER, "line %zu: number too large", text->line);
+			v = v << 4 | (uint64_t) (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+		}
+	if (c != EOF) text_ungetc(text);
+	*value = v;
+	return ERR_NONE;
+}
+
+// ======================================================================
+// reads "@address"
+static int text_read_vaddr(cmd_text_reader_t * text, virt_addr_t * vaddr)
+{
+	M_REQUIRE(text_next_nonspace(text) == '@', ERR_BAD_PARAMETER, "line %zu: '@' expected", text->line);
+	uint64_t addr = 0;
+	M_EXIT_IF_ERR(text_read_hex(text, &addr), "reading address");
+	return init_virt_addr64(vaddr, addr);
+}
+
+// ======================================================================
+// reads the size of a data access: 'W' (word) or 'B' (byte)
+static int text_read_size(cmd_text_reader_t * text, size_t * data_size)
+{
+	const int size = text_next_nonspace(text);
+	M_REQUIRE(size == 'W' || size == 'B', ERR_BAD_PARAMETER, "line %zu: 'W' or 'B' expected", text->line);
+	*data_size = size == 'W' ? sizeof(word_t) : 1;
+	return ERR_NONE;
+}
+
+// ======================================================================
+/*
+ * Parses one command:
+ *    R I @vaddr
+ *    R D{W|B} @vaddr
+ *    W D{W|B} value @vaddr
+ *    C cr3                   (a context switch, see commands.h)
+ * Characters before R, W or C are skipped, as program_read() always did.
+ */
+static int text_next(cmd_text_reader_t * text, command_t * command)
+{
+	int c = EOF;
+	do
+		{
+			c = text_next_nonspace(text);
+		}
+	while (c != EOF && c != 'R' && c != 'W' && c != 'C');
+	if (c == EOF) return ferror(text->file) ? ERR_IO : ERR_EOF;
+
+	zero_init_ptr(command);
+	if (c == 'C')
+		{
+			command->order = SWITCH;
+			uint64_t cr3 = 0;
+			M_EXIT_IF_ERR(text_read_hex(text, &cr3), "reading CR3");
+			M_REQUIRE(cr3 <= UINT32_MAX, ERR_BAD_PARAMETER, "line %zu: CR3 larger than a physical address", text->line);
+			command->write_data = (word_t) cr3;
+			return command_check(command);
+		}
+	if (c == 'R')
+		{
+			command->order = READ;
+			c = text_next_nonspace(text);
+			if (c == 'I')
+				{
+					command->type = INSTRUCTION;
+				}
+			else
+				{
+					M_REQUIRE(c == 'D', ERR_BAD_PARAMETER, "line %zu: 'I' or 'D' expected", text->line);
+					command->type = DATA;
+					M_EXIT_IF_ERR(text_read_size(text, &command->data_size), "reading data size");
+				}
+		}
+	else
+		{
+			command->order = WRITE;
+			M_REQUIRE(text_next_nonspace(text) == 'D', ERR_BAD_PARAMETER, "line %zu: only data can be written", text->line);
+			command->type = DATA;
+			M_EXIT_IF_ERR(text_read_size(text, &command->data_size), "reading data size");
+			uint64_t value = 0;
+			M_EXIT_IF_ERR(text_read_hex(text, &value), "reading data");
+			M_REQUIRE(value <= UINT32_MAX, ERR_BAD_PARAMETER, "line %zu: data larger than a word", text->line);
+			command->write_data = (word_t) value;
+		}
+	M_EXIT_IF_ERR(text_read_vaddr(text, &command->vaddr), "reading address");
+
+	return command_check(command);
+}
+
+// ======================================================================
+// see cmd_source_mng.h
+int cmd_source_next(cmd_source_t * source, command_t * command)
+{
+	M_REQUIRE_NON_NULL(source);
+	M_REQUIRE_NON_NULL(command);
+
+	int err = ERR_NONE;
+	switch (source->kind)
+		{
+		case CMD_SOURCE_TEXT:
+			err = text_next(&source->from.text, command);
+			break;
+		case CMD_SOURCE_TRACE:
+			err = trace_next(&source->from.trace, command);
+			break;
+		case CMD_SOURCE_PROGRAM:
+			{
+				const program_t * const program = source->from.program.program;
+				if (source->from.program.next < program->nb_lines)
+					*command = program->listing[source->from.program.next++];
+				else
+					err = ERR_EOF;
+			}
+			break;
+		default:
+			return ERR_BAD_PARAMETER;
+		}
+	if (err == ERR_NONE) ++source->nb_commands;
+	return err;
+}
+
+// ======================================================================
+// see cmd_source_mng.h
+void cmd_source_close(cmd_source_t * source)
+{
+	if (source == NULL) return;
+	switch (source->kind)
+		{
+		case CMD_SOURCE_TEXT:
+			if (source->from.text.file != NULL) fclose(source->from.text.file);
+			free(source->from.text.buffer);
+			break;
+		case CMD_SOURCE_TRACE:
+			trace_close(&source->from.trace);
+			break;
+		default:
+			break;
+		}
+	zero_init_ptr(source);
+}
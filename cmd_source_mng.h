@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * @file cmd_source_mng.h
+ * @brief pulling commands one at a time from a text program, a trace or a program_t
+ *
+ * @date 2019
+ */
+
+#include "cmd_source.h"
+
+//=========================================================================
+/**
+ * @brief Opens a command file: a binary trace if it is one (see
+ * trace_open()), a program in text format (see program_read()) otherwise.
+ * @param source (modified) the source to open
+ * @param filename the command file
+ * @return error code
+ */
+int cmd_source_open(cmd_source_t * source, const char * filename);
+
+//=========================================================================
+/**
+ * @brief Opens a program in text format.
+ * @param source (modified) the source to open
+ * @param filename the text file
+ * @return error code
+ */
+int cmd_source_open_text(cmd_source_t * source, const char * filename);
+
+//=========================================================================
+/**
+ * @brief Reads the commands of a program already in memory.
+ * @param source (modified) the source to initialize
+ * @param program the program, which must outlive the source
+ * @return error code
+ */
+int cmd_source_from_program(cmd_source_t * source, const program_t * program);
+
+//=========================================================================
+/**
+ * @brief Reads the next command of a source.
+ * Commands read from text are checked as by program_add_command().
+ * @param source the source
+ * @param command (modified) the command
+ * @return error code, ERR_EOF after the last command
+ */
+int cmd_source_next(cmd_source_t * source, command_t * command);
+
+//=========================================================================
+/**
+ * @brief Closes a source and releases its resources.
+ * @param source the source to close
+ */
+void cmd_source_close(cmd_source_t * source);
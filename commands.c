@@ -7,7 +7,7 @@
 #include <stdio.h> // for size_t, FILE
 #include <stdint.h> // for uint32_t
 #include "error.h"
-#include <ctype.h> //  for isspace
+#include "cmd_source_mng.h"
 #include <stdlib.h> // realloc
 
 #define firstsize 10
@@ -22,7 +22,7 @@ int program_init(program_t * program)
 	program->listing = calloc(firstsize, sizeof(command_t));
 	M_REQUIRE_NON_NULL(program->listing);
 	program->nb_lines = 0;
-	program->allocated = sizeof(program->listing);
+	program->allocated = firstsize;
 
 	return ERR_NONE;
 }
@@ -38,6 +38,12 @@ int program_print(FILE* output, const program_t* program)
 	for_all_lines(line, program)
 	{
 
+		if (line->order == SWITCH)
+			{
+				fprintf(output, "C " "0x%08" PRIX32 "\n", line->write_data);
+				continue;
+			}
+
 		char order = (line->order == READ) ? 'R' : 'W';
 		char instruction = (line->type == INSTRUCTION) ? 'I' : 'D';
 		char size = 0;
@@ -82,19 +88,12 @@ int program_shrink(program_t* program)
 	M_REQUIRE_NON_NULL(program);
 	M_REQUIRE_NON_NULL(program->listing);
 
-	if (program->nb_lines > firstsize)
-		{
-			program->allocated = program->nb_lines * sizeof(command_t);
-			program->listing = realloc(program->listing, program->allocated );
-			M_REQUIRE_NON_NULL(program->listing);
-		}
-
-	else
-		{
-			program->allocated = firstsize * sizeof(command_t);
-			program->listing = realloc(program->listing, program->allocated );
-			M_REQUIRE_NON_NULL(program->listing);
-		}
+	// allocated counts commands, not bytes
+	const size_t allocated = program->nb_lines > firstsize ? program->nb_lines : firstsize;
+	command_t* listing = realloc(program->listing, allocated * sizeof(command_t));
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(listing, ERR_MEM);
+	program->listing = listing;
+	program->allocated = allocated;
 	return ERR_NONE;
 }
 
@@ -110,17 +109,23 @@ int program_free(program_t* program)
 }
 
 
-int program_add_command(program_t* program, const command_t* command)
+int command_check(const command_t* command)
 {
-
-	M_REQUIRE_NON_NULL(program);
-	M_REQUIRE_NON_NULL(program->listing);
-
 	M_REQUIRE_NON_NULL(command);
-	M_REQUIRE(command->order == READ || command->order == WRITE , ERR_BAD_PARAMETER, " ",);
+	M_REQUIRE(command->order == READ || command->order == WRITE || command->order == SWITCH, ERR_BAD_PARAMETER, " ",);
+	if (command->order == SWITCH)
+		{
+			M_REQUIRE(command->data_size == 0 && virt_addr_t_to_uint64_t(&command->vaddr) == 0, ERR_BAD_PARAMETER,
+			          "%s", "a context switch has no data size nor address");
+			return ERR_NONE;
+		}
 	M_REQUIRE(command->type == DATA || command->type == INSTRUCTION , ERR_BAD_PARAMETER, " ",);
 
-	M_REQUIRE((command->vaddr.page_offset % sizeof(word_t))  == 0 , ERR_BAD_PARAMETER, " ",);
+	if (command->type == INSTRUCTION || command->data_size == sizeof(word_t))
+		{
+			// only byte accesses may be unaligned
+			M_REQUIRE((command->vaddr.page_offset % sizeof(word_t))  == 0 , ERR_BAD_PARAMETER, " ",);
+		}
 	if (command->order == READ)
 		{
 			M_REQUIRE(command->write_data == 0, ERR_BAD_PARAMETER, " ", );
@@ -147,8 +152,18 @@ int program_add_command(program_t* program, const command_t* command)
 		{
 			M_REQUIRE(command->data_size != 0 , ERR_BAD_PARAMETER, "data size should be bigger than 0",  );
 		}
+	return ERR_NONE;
+}
 
 
+int program_add_command(program_t* program, const command_t* command)
+{
+
+	M_REQUIRE_NON_NULL(program);
+	M_REQUIRE_NON_NULL(program->listing);
+
+	M_EXIT_IF_ERR(command_check(command), "checking command");
+
 // adds a line when there are less lines than the allocated number
 	if (program->nb_lines < program->allocated)
 		{
@@ -160,9 +175,10 @@ int program_add_command(program_t* program, const command_t* command)
 	else
 		{
 
+			command_t* listing = realloc(program->listing, 2 * program->allocated * sizeof(command_t));
+			M_REQUIRE_NON_NULL_CUSTOM_ERR(listing, ERR_MEM);
+			program->listing = listing;
 			program->allocated *= 2;
-			program->listing = realloc(program->listing, program->allocated * sizeof(command_t));
-			M_REQUIRE_NON_NULL(program->listing);
 			program->listing[program->nb_lines] = *command;
 			++program->nb_lines;
 		}
@@ -170,147 +186,26 @@ int program_add_command(program_t* program, const command_t* command)
 }
 
 
-// read untile the next non space
-char next_nonspace_read(FILE* entree)
-{
-	char c = ' ';
-	do
-		{
-			c = (fgetc(entree));
-
-		}
-	while (isspace(c) && c != EOF);
-	return c;
-}
-
-
-
-// read when the order is a read
-int   read_read(FILE* entree, command_t* com )
-{
-	char order = next_nonspace_read(entree);
-	M_REQUIRE(order != EOF, ERR_BAD_PARAMETER, " ", );
-	virt_addr_t vaddr;
-
-
-// read when the order is an instruction
-	if (order == 'I')
-		{
-			if (next_nonspace_read(entree) == '@')
-				{
-					uint64_t tovaddr = 0;
-
-					M_REQUIRE(fscanf(entree, "%"SCNx64, &tovaddr) > 0, ERR_BAD_PARAMETER, " ", );
-
-					init_virt_addr64(&vaddr, tovaddr);
-
-					com->order = READ;
-					com->type = INSTRUCTION;
-					com->vaddr = vaddr;
-				}
-			else
-				{
-
-					return ERR_BAD_PARAMETER;
-				}
-		}
-	else
-		{
-// reads when the order is DATA
-			char size  = next_nonspace_read(entree);
-			M_REQUIRE(size == 'W' || size == 'B', ERR_BAD_PARAMETER, " ", );
-
-			if (next_nonspace_read(entree) == '@')
-				{
-					uint64_t tovaddr = 0;
-					M_REQUIRE(fscanf(entree, "%"SCNx64, &tovaddr) > 0, ERR_BAD_PARAMETER, " ", );
-					init_virt_addr64(&vaddr, tovaddr);
-
-				}
-			else
-				{
-					return ERR_BAD_PARAMETER;
-				}
-			com->order = READ;
-			com->type = DATA;
-			com->vaddr = vaddr;
-			com->data_size = (size == 'W') ? sizeof(word_t) : 1 ;
-		}
-	return ERR_NONE;
-}
-
-
-// read to use when the order of the command is a write
-int  read_write(FILE* entree, command_t * com)
-{
-
-	char order = next_nonspace_read(entree);
-	M_REQUIRE(order == WRITE || order == READ, ERR_BAD_PARAMETER, " ", );
-
-
-	virt_addr_t vaddr;
-	char size  = next_nonspace_read(entree);
-
-	M_REQUIRE(size == 'W' || size == 'B', ERR_BAD_PARAMETER, " ", );
-
-
-	word_t value = 0;
-	M_REQUIRE(fscanf(entree, "%"SCNx32, &value) > 0, ERR_BAD_PARAMETER, " ", );
-
-	if (next_nonspace_read(entree) == '@')
-		{
-			uint64_t tovaddr = 0;
-			M_REQUIRE(fscanf(entree, "%64"SCNx64, &tovaddr) > 0, ERR_BAD_PARAMETER, " ", );
-			init_virt_addr64(&vaddr, tovaddr);
-
-		}
-
-	else
-		{
-			return ERR_BAD_PARAMETER;
-		}
-
-	com->order = WRITE;
-	com->type = DATA;
-	com->write_data = value;
-	com->data_size = (size == 'W') ? sizeof(word_t) : 1;
-	com->vaddr = vaddr;
-	return ERR_NONE;
-}
-
-
+// the text format is parsed by the text command source, see cmd_source_mng.h
 int program_read(const char* filename, program_t* program)
 {
 	M_REQUIRE_NON_NULL(filename);
 	M_REQUIRE_NON_NULL(program);
-	M_REQUIRE_NON_NULL(program->listing);
 
-
-	FILE* entree = fopen(filename, "r");
-	M_REQUIRE_NON_NULL_CUSTOM_ERR(entree, ERR_IO);
-	M_REQUIRE(program_init(program) == ERR_NONE, ERR_BAD_PARAMETER, " ", );
-	do
+	cmd_source_t source;
+	M_EXIT_IF_ERR(cmd_source_open_text(&source, filename), "opening program");
+	int err = program_init(program);
+	command_t command;
+	while (err == ERR_NONE && (err = cmd_source_next(&source, &command)) == ERR_NONE)
 		{
+			err = program_add_command(program, &command);
+		}
+	cmd_source_close(&source);
 
-			command_t   command;
-//divides the reading of the line in two parts,reading and writing
-			char first = next_nonspace_read(entree);
-			M_REQUIRE_NON_NULL(&first);
-			if (first == 'R')
-				{
-
-					read_read(entree, &command);
-					M_REQUIRE( program_add_command( program, &command) == ERR_NONE, ERR_BAD_PARAMETER, "");
-				}
-
-			if (first == 'W')
-				{
-
-					read_write(entree, &command);
-					M_REQUIRE( program_add_command( program, &command) == ERR_NONE, ERR_BAD_PARAMETER, "");
-				}
+	if (err != ERR_EOF)
+		{
+			program_free(program);
+			return err;
 		}
-	while (!feof(entree) & !ferror(entree));
-	fclose(entree);
 	return ERR_NONE;
 }
@@ -24,8 +24,12 @@
 
 
 typedef  enum {
-	READ, WRITE } command_word_t ;
+	READ, WRITE, SWITCH } command_word_t ;
 
+/*
+ * A SWITCH command is a context switch: it loads write_data into CR3 (see
+ * addr.h); its data_size and vaddr are 0.
+ */
 typedef struct {
 
 	command_word_t order;
@@ -39,7 +43,7 @@ typedef struct {
 typedef struct {
 	command_t* listing;
 	size_t nb_lines;
-	size_t allocated;
+	size_t allocated; // number of commands listing can hold
 
 } program_t;
 
@@ -67,7 +71,15 @@ typedef struct {
 int program_init(program_t* program) ;
 
 /**
- * @brief add a command (line) to a program. Reallocate memory if necessary.
+ * @brief Check that a command is well-formed (only data can be written,
+ * data size of 1 byte or a word, only byte accesses may be unaligned...).
+ * @param command the command to check.
+ * @return ERR_NONE if ok, ERR_BAD_PARAMETER otherwise.
+ */
+int command_check(const command_t* command);
+
+/**
+ * @brief add a command (line) to a program, once checked (see command_check()). Reallocate memory if necessary.
  * @param program (modified) the program where to add to.
  * @param command the command to be added.
  * @return ERR_NONE if ok, appropriate error code otherwise.
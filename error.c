@@ -11,7 +11,7 @@ const char * const ERR_MESSAGES[] = {
     "End of file",
     "Wrong address",
     "Wrong size",
-    "Wrong size",
+    "Wrong policy",
     "Not found",
     "no error (shall not be displayed)" // ERR_LAST
 };
@@ -0,0 +1,46 @@
+/**
+ * @file image-convert.c
+ * @brief converts a memory dump or description into a packed memory
+ *        image (see image.h)
+ *
+ * usage: image-convert (dump|desc) mem_filename image_filename
+ *
+ * @date 2019
+ */
+
+#include "error.h"
+#include "image_mng.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || (strcmp(argv[1], "dump") != 0 && strcmp(argv[1], "desc") != 0))
+        {
+            fprintf(stderr, "usage: %s (dump|desc) mem_filename image_filename\n", argv[0]);
+            return 1;
+        }
+
+    void* mem_space = NULL;
+    size_t mem_size = 0;
+    int err = strcmp(argv[1], "dump") == 0
+              ? mem_init_from_dumpfile(argv[2], &mem_space, &mem_size)
+              : mem_init_from_description(argv[2], &mem_space, &mem_size);
+    if (err != ERR_NONE)
+        {
+            fprintf(stderr, "ERROR: cannot initialize memory from \"%s\": %s\n", argv[2], ERR_MESSAGES[err]);
+            return 2;
+        }
+
+    err = image_write(argv[3], mem_space, mem_size);
+    mem_free(mem_space, mem_size);
+    if (err != ERR_NONE)
+        {
+            fprintf(stderr, "ERROR: cannot write \"%s\": %s\n", argv[3], ERR_MESSAGES[err]);
+            return 2;
+        }
+    return 0;
+}
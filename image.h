@@ -0,0 +1,41 @@
+#pragma once
+
+/**
+ * @file image.h
+ * @brief packed memory image: a whole memory space in one file
+ *
+ * An image file is a header, the index of the pages it stores and their
+ * contents, all little-endian:
+ *
+ *    header (IMAGE_HEADER_SIZE bytes):
+ *      [0..7]   IMAGE_MAGIC
+ *      [8..9]   IMAGE_VERSION
+ *      [10..11] 0
+ *      [12..15] number N of pages stored
+ *      [16..23] size of the memory in bytes
+ *
+ *    index (N * IMAGE_INDEX_ENTRY_SIZE bytes, from IMAGE_HEADER_SIZE):
+ *      the physical page numbers of the pages stored, increasing
+ *
+ *    pages (N * PAGE_SIZE bytes, from image_pages_offset(N)):
+ *      their contents, in the order of the index
+ *
+ * The pages not in the index are all zeros. The last page of a memory
+ * whose size is not a multiple of PAGE_SIZE is padded with zeros. The
+ * pages start on a PAGE_SIZE boundary of the file.
+ *
+ * @date 2019
+ */
+
+#include "addr.h" // PAGE_SIZE
+#include <stdint.h>
+
+#define IMAGE_MAGIC            "MEMIMAGE" // 8 bytes, no terminating 0 in the file
+#define IMAGE_MAGIC_SIZE       8
+#define IMAGE_VERSION          1
+#define IMAGE_HEADER_SIZE      24
+#define IMAGE_INDEX_ENTRY_SIZE 4
+
+// offset in the file of the first of N pages
+#define image_pages_offset(N) \
+        ((((uint64_t) IMAGE_HEADER_SIZE + (uint64_t) (N) * IMAGE_INDEX_ENTRY_SIZE + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE)
@@ -0,0 +1,157 @@
+/**
+ * @file image_mng.c
+ * @brief reading and writing packed memory images
+ *
+ * @date 2019
+ */
+
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise, fstat
+
+#include "image_mng.h"
+#include "memory.h" // mem_alloc, mem_free
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h> // calloc
+#include <string.h> // memcmp, memcpy
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint8_t zero_page[PAGE_SIZE];
+
+// ======================================================================
+static void put_le(uint8_t * bytes, uint64_t value, int nb_bytes)
+{
+	for (int i = 0; i < nb_bytes; ++i, value >>= 8)
+		bytes[i] = (uint8_t) value;
+}
+
+static uint64_t get_le(const uint8_t * bytes, int nb_bytes)
+{
+	uint64_t value = 0;
+	for (int i = nb_bytes - 1; i >= 0; --i)
+		value = (value << 8) | bytes[i];
+	return value;
+}
+
+// ======================================================================
+// number of bytes of the memory in its page page_num
+static size_t image_page_bytes(size_t mem_size, size_t page_num)
+{
+	const size_t rest = mem_size - page_num * PAGE_SIZE;
+	return rest < PAGE_SIZE ? rest : PAGE_SIZE;
+}
+
+// ======================================================================
+// see image_mng.h
+int image_write(const char * filename, const void * memory, size_t mem_size)
+{
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL(memory);
+	const size_t nb_pages = (mem_size + PAGE_SIZE - 1) / PAGE_SIZE;
+	M_REQUIRE(nb_pages <= ((size_t) 1 << PHY_PAGE_NUM), ERR_SIZE, "%zu bytes: memory too large", mem_size);
+
+	// the index: the pages that are not all zeros
+	const uint8_t * const bytes = memory;
+	uint8_t * const index = calloc(nb_pages > 0 ? nb_pages : 1, IMAGE_INDEX_ENTRY_SIZE);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(index, ERR_MEM);
+	uint32_t nb_stored = 0;
+	for (size_t page = 0; page < nb_pages; ++page)
+		if (memcmp(bytes + page * PAGE_SIZE, zero_page, image_page_bytes(mem_size, page)) != 0)
+			put_le(index + IMAGE_INDEX_ENTRY_SIZE * nb_stored++, page, IMAGE_INDEX_ENTRY_SIZE);
+
+	FILE * output = fopen(filename, "wb");
+	if (output == NULL)
+		{
+			free(index);
+			M_EXIT(ERR_IO, "%s: cannot create", filename);
+		}
+
+	uint8_t header[IMAGE_HEADER_SIZE] = { 0 };
+	memcpy(header, IMAGE_MAGIC, IMAGE_MAGIC_SIZE);
+	put_le(header + 8, IMAGE_VERSION, 2);
+	put_le(header + 12, nb_stored, 4);
+	put_le(header + 16, mem_size, 8);
+	const size_t index_size = (size_t) nb_stored * IMAGE_INDEX_ENTRY_SIZE;
+	const size_t padding = (size_t) image_pages_offset(nb_stored) - IMAGE_HEADER_SIZE - index_size;
+	int err = fwrite(header, IMAGE_HEADER_SIZE, 1, output) == 1
+	          && fwrite(index, 1, index_size, output) == index_size
+	          && fwrite(zero_page, 1, padding, output) == padding ? ERR_NONE : ERR_IO;
+
+	for (uint32_t i = 0; err == ERR_NONE && i < nb_stored; ++i)
+		{
+			const size_t page = (size_t) get_le(index + IMAGE_INDEX_ENTRY_SIZE * i, IMAGE_INDEX_ENTRY_SIZE);
+			const size_t size = image_page_bytes(mem_size, page);
+			if (fwrite(bytes + page * PAGE_SIZE, 1, size, output) != size
+			    || fwrite(zero_page, 1, PAGE_SIZE - size, output) != PAGE_SIZE - size)
+				err = ERR_IO;
+		}
+	free(index);
+	if (fclose(output) != 0 && err == ERR_NONE) err = ERR_IO;
+	return err;
+}
+
+// ======================================================================
+// see image_mng.h
+int image_read(const char * filename, void ** memory, size_t * mem_size)
+{
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL(memory);
+	M_REQUIRE_NON_NULL(mem_size);
+	*memory = NULL;
+
+	const int fd = open(filename, O_RDONLY);
+	M_REQUIRE(fd >= 0, ERR_IO, "%s: cannot open", filename);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < IMAGE_HEADER_SIZE)
+		{
+			close(fd);
+			M_EXIT(ERR_IO, "%s: not an image", filename);
+		}
+
+	const size_t file_size = (size_t) st.st_size;
+	void * map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays valid
+	M_REQUIRE(map != MAP_FAILED, ERR_IO, "%s: cannot map", filename);
+	(void) posix_madvise(map, file_size, POSIX_MADV_SEQUENTIAL); // only a hint
+
+	const uint8_t * const bytes = map;
+	const uint64_t nb_stored = get_le(bytes + 12, 4);
+	const uint64_t size = get_le(bytes + 16, 8);
+	const uint64_t nb_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	int err = ERR_NONE;
+	if (memcmp(bytes, IMAGE_MAGIC, IMAGE_MAGIC_SIZE) != 0 || get_le(bytes + 8, 2) != IMAGE_VERSION)
+		err = ERR_IO;
+	else if (nb_stored > nb_pages || nb_pages > ((uint64_t) 1 << PHY_PAGE_NUM)
+	         || file_size != image_pages_offset(nb_stored) + nb_stored * PAGE_SIZE)
+		err = ERR_SIZE;
+
+	uint8_t * mem = NULL;
+	if (err == ERR_NONE && (mem = mem_alloc((size_t) size)) == NULL) err = ERR_MEM;
+
+	const uint8_t * const index = bytes + IMAGE_HEADER_SIZE;
+	const uint8_t * page = bytes + image_pages_offset(nb_stored);
+	uint64_t previous = 0;
+	for (uint64_t i = 0; err == ERR_NONE && i < nb_stored; ++i, page += PAGE_SIZE)
+		{
+			const uint64_t page_num = get_le(index + IMAGE_INDEX_ENTRY_SIZE * i, IMAGE_INDEX_ENTRY_SIZE);
+			if (page_num >= nb_pages || (i > 0 && page_num <= previous))
+				err = ERR_SIZE;
+			else
+				memcpy(mem + page_num * PAGE_SIZE, page, image_page_bytes((size_t) size, (size_t) page_num));
+			previous = page_num;
+		}
+	munmap(map, file_size);
+
+	if (err != ERR_NONE)
+		{
+			mem_free(mem, (size_t) size);
+			M_EXIT(err, "%s: not an image, or truncated", filename);
+		}
+	*memory = mem;
+	*mem_size = (size_t) size;
+	return ERR_NONE;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+/**
+ * @file image_mng.h
+ * @brief reading and writing packed memory images (see image.h)
+ *
+ * @date 2019
+ */
+
+#include "image.h"
+#include <stddef.h> // size_t
+
+//=========================================================================
+/**
+ * @brief Writes a memory space as an image: only its pages that are not
+ * all zeros are stored.
+ * @param filename the image file to create
+ * @param memory the memory space
+ * @param mem_size its size in bytes
+ * @return error code
+ */
+int image_write(const char * filename, const void * memory, size_t mem_size);
+
+//=========================================================================
+/**
+ * @brief Creates the whole memory space from an image: the file is
+ * mapped once, and each page it stores copied to its place in a sparse
+ * memory (see memory.h). The memory shall be released with mem_free().
+ * @param filename the image file
+ * @param memory (modified) pointer to the begining of the memory
+ * @param mem_size (modified) its size in bytes
+ * @return error code, *memory shall be NULL in case of error
+ */
+int image_read(const char * filename, void ** memory, size_t * mem_size);
@@ -205,8 +205,13 @@ void move_back(list_t* this, node_t* node)
 
     else if (this->front == node) //if the node passed as argument is the front
         {
-            push_back(this, &node->value);
-            pop_front(this);
+            // relinked, not reallocated: pointers to the node stay valid
+            this->front = node->next;
+            this->front->previous = NULL;
+            node->previous = this->back;
+            node->next = NULL;
+            this->back->next = node;
+            this->back = node;
         }
 
     else
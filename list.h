@@ -89,7 +89,8 @@ void pop_back(list_t* this);
 void pop_front(list_t* this);
 
 /**
- * @brief move a node a the end of the list
+ * @brief move a node a the end of the list, in constant time; the node
+ * itself is moved, so pointers to it stay valid
  * @param this list to modify
  * @param node pointer to the node to be moved
  */
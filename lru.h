@@ -2,20 +2,21 @@
 
 
 
-#define LRU_age_increase(TYPE, WAYS,WAY_INDEX, LINE_INDEX) \
-	foreach_way(i,WAYS)\
-		if(cache_entry(TYPE, WAYS, LINE_INDEX, i)->age<WAYS-1)\
-			cache_entry(TYPE, WAYS, LINE_INDEX, i)->age += 1;\
-	cache_entry(TYPE, WAYS, LINE_INDEX, WAY_INDEX)->age=0;
-
-
-
-#define LRU_age_update(TYPE, WAYS,WAY_INDEX, LINE_INDEX) \
-	int max =(cache_entry(TYPE, WAYS, LINE_INDEX, WAY_INDEX)->age);\
-	foreach_way(i,WAYS)\
-		if(cache_entry(TYPE, WAYS, LINE_INDEX, i)->age<max)\
-			cache_entry(TYPE, WAYS, LINE_INDEX, i)->age += 1;\
-	cache_entry(TYPE, WAYS, LINE_INDEX, WAY_INDEX)->age=0;
-
-
-
+#define LRU_age_increase(CACHE, WAYS, WAY_INDEX, LINE_INDEX) \
+	do {\
+	foreach_way(i_, WAYS)\
+		if(cache_age(CACHE, LINE_INDEX, i_) < (WAYS) - 1)\
+			cache_age(CACHE, LINE_INDEX, i_) += 1;\
+	cache_age(CACHE, LINE_INDEX, WAY_INDEX) = 0;\
+	} while (0)
+
+
+
+#define LRU_age_update(CACHE, WAYS, WAY_INDEX, LINE_INDEX) \
+	do {\
+	const uint8_t max_ = cache_age(CACHE, LINE_INDEX, WAY_INDEX);\
+	foreach_way(i_, WAYS)\
+		if(cache_age(CACHE, LINE_INDEX, i_) < max_)\
+			cache_age(CACHE, LINE_INDEX, i_) += 1;\
+	cache_age(CACHE, LINE_INDEX, WAY_INDEX) = 0;\
+	} while (0)
@@ -9,6 +9,9 @@
 #define __USE_MINGW_ANSI_STDIO 1
 #endif
 
+#define _POSIX_C_SOURCE 200809L // mmap(), posix_madvise(), getline()
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MAP_NORESERVE
+
 #include "memory.h"
 #include "page_walk.h"
 #include "addr_mng.h"
@@ -20,6 +23,12 @@
 #include <string.h> // for memset()
 #include <inttypes.h> // for SCNx macros
 #include <assert.h>
+#include <fcntl.h> // open()
+#include <unistd.h> // close()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 // ======================================================================
 /**
@@ -125,7 +134,45 @@ int vmem_page_dump_with_options(const void *mem_space, const virt_addr_t* from,
     return ERR_NONE;
 }
 
+// ======================================================================
+/*
+ * The memory space: an anonymous private mapping. The system allocates a
+ * page on its first write; the pages never written all read the shared
+ * zero page. A sparse memory thus costs the pages it uses, whatever its
+ * size, and the simulation reads and writes it directly.
+ */
+#ifdef MAP_NORESERVE
+#define MEM_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE) // no swap held for the untouched pages
+#else
+#define MEM_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+#endif
+
+// ======================================================================
+// See memory.h for description
+void* mem_alloc(size_t size)
+{
+    void* const memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MEM_MAP_FLAGS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+// ======================================================================
+// See memory.h for description
+void mem_free(void* memory, size_t mem_capacity_in_bytes)
+{
+    if (memory != NULL) (void) munmap(memory, mem_capacity_in_bytes);
+}
+
+// ======================================================================
+// tells if the size bytes at from are all 0
+static int mem_is_zero(const uint8_t* from, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        if (from[i] != 0) return 0;
+    return 1;
+}
 
+// ======================================================================
+// See memory.h for description
 int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capacity_in_bytes)
 {
 
@@ -135,12 +182,9 @@ int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capa
     M_REQUIRE_NON_NULL(mem_capacity_in_bytes);
 
     //opens the file as a binary file ("rb")
+    *memory = NULL;
     FILE *file = fopen(filename, "rb");
-    if (file == NULL)
-        {
-            fclose(file);
-            return ERR_BAD_PARAMETER;
-        }
+    if (file == NULL) return ERR_IO;
 
     // va tout au bout du fichier
     fseek(file, 0L, SEEK_END);
@@ -150,11 +194,29 @@ int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capa
     rewind(file);
 
     //allocates the necessary space
-    *memory = malloc(*mem_capacity_in_bytes);
-    M_REQUIRE_NON_NULL(memory);
+    *memory = mem_alloc(*mem_capacity_in_bytes);
+    if (*memory == NULL)
+        {
+            fclose(file);
+            return ERR_MEM;
+        }
 
-    //reads the file's data and stores it in the memory
-    M_REQUIRE(fread(*memory, 1, *mem_capacity_in_bytes, file) > 0, ERR_BAD_PARAMETER, " ",);
+    //reads the file's data page by page; the pages of zeros are not written,
+    //so that they stay unallocated (see mem_alloc())
+    uint8_t page[PAGE_SIZE];
+    for (size_t offset = 0; offset < *mem_capacity_in_bytes; offset += PAGE_SIZE)
+        {
+            const size_t wanted = *mem_capacity_in_bytes - offset < PAGE_SIZE ?
+                                  *mem_capacity_in_bytes - offset : PAGE_SIZE;
+            if (fread(page, 1, wanted, file) != wanted)
+                {
+                    fclose(file);
+                    mem_free(*memory, *mem_capacity_in_bytes);
+                    *memory = NULL;
+                    return ERR_IO;
+                }
+            if (!mem_is_zero(page, wanted)) memcpy((uint8_t*) *memory + offset, page, wanted);
+        }
 
 
     //closes the file
@@ -163,133 +225,323 @@ int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capa
     return ERR_NONE;
 }
 
-int mem_init_from_description(const char* master_filename, void** memory,
-                              size_t* mem_capacity_in_bytes)
+// levels of the page tables
+enum { PGD_TABLE, PUD_TABLE, PMD_TABLE, PTE_TABLE };
+
+// ======================================================================
+/*
+ * Asks the system to read ahead the page tables under the table at
+ * offset table, of the given level. The
+ * tables whose entries point to tables are read to find those; the PTEs
+ * are only hinted. Entries 0 (none) or out of the memory are skipped.
+ */
+static void mem_advise_tables(const uint8_t* memory, size_t size, pte_t table, int level)
 {
+    (void) posix_madvise((void*) (memory + table), PAGE_SIZE, POSIX_MADV_WILLNEED);
+    if (level == PTE_TABLE) return;
 
-    M_REQUIRE_NON_NULL(master_filename);
+    const pte_t* const entries = (const pte_t*) (memory + table);
+    for (size_t i = 0; i < PD_ENTRIES; ++i)
+        {
+            const pte_t entry = entries[i];
+            const pte_t next = entry & PTE_ADDR_MASK;
+            if (next == 0 || next == table || (size_t) next + PAGE_SIZE > size) continue;
+            if (level != PGD_TABLE && (entry & PTE_PAGE_SIZE)) continue; // a huge page, not a table
+            mem_advise_tables(memory, size, next, level + 1);
+        }
+}
+
+// ======================================================================
+// See memory.h for description
+int mem_map_dumpfile(const char* filename, void** memory, size_t* mem_capacity_in_bytes, int advise_tables)
+{
+    M_REQUIRE_NON_NULL(filename);
     M_REQUIRE_NON_NULL(memory);
     M_REQUIRE_NON_NULL(mem_capacity_in_bytes);
+    *memory = NULL;
 
-    FILE *file = fopen(master_filename, "r");
-    if (file == NULL)
+    const int fd = open(filename, O_RDONLY);
+    M_REQUIRE(fd >= 0, ERR_IO, "cannot open %s", filename);
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < PAGE_SIZE)
         {
-            fclose(file);
-            return ERR_BAD_PARAMETER;
+            close(fd);
+            M_EXIT(ERR_IO, "%s is not a memory dump", filename);
         }
 
-    char * line = NULL;
-    size_t len = 0;
+    // private: the written pages are copied, the file is never modified
+    const size_t size = (size_t) status.st_size;
+    void* const mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file
+    M_REQUIRE(mapped != MAP_FAILED, ERR_MEM, "cannot map %s", filename);
 
-    size_t memory_size;
-    char * file_name;
-    int n_translation_pages;
+    if (advise_tables) mem_advise_tables(mapped, size, 0, PGD_TABLE);
+    *memory = mapped;
+    *mem_capacity_in_bytes = size;
+    return ERR_NONE;
+}
 
-    int address;
-    char* file_name2 = calloc(128, sizeof(char));
 
-    int counter = 0;
+// ======================================================================
+/*
+ * Loading a memory description.
+ *
+ * The description is parsed first into the list of its page files, each
+ * with the offset it goes to in the memory: the PGD and the translation
+ * pages (at their given offsets), then the data pages (once their virtual
+ * addresses are walked in the loaded tables). Each list is then read by a
+ * pool of threads, every file straight into its place. If files of a list
+ * overlap, the list is read in order by one thread, so that the last one
+ * wins, as when the files are read one after the other.
+ */
+#define MEM_LOAD_MAX_THREADS 16u
+
+typedef struct {
+    char* filename;
+    uint64_t vaddr; // data pages only, until translated to addr
+    uint32_t addr;  // offset in the memory
+} page_file_t;
+
+typedef struct {
+    page_file_t* files;
+    size_t nb_files;
+    size_t allocated;
+} page_files_t;
+
+// the files being read by the threads of the pool
+typedef struct {
+    uint8_t* memory;
+    const page_file_t* files;
+    size_t nb_files;
+    atomic_size_t next; // the next file to be read
+    atomic_int err;     // the first error
+} page_loader_t;
+
+// ======================================================================
+// reads a page file (exactly one page) at page
+static int page_file_load(const char* filename, uint8_t* page)
+{
+    const int fd = open(filename, O_RDONLY);
+    M_REQUIRE(fd >= 0, ERR_IO, "cannot open %s", filename);
+
+    struct stat status;
+    int err = fstat(fd, &status) == 0 && status.st_size == PAGE_SIZE ? ERR_NONE : ERR_IO;
+    for (size_t done = 0; err == ERR_NONE && done < PAGE_SIZE; )
+        {
+            const ssize_t nb_read = read(fd, page + done, PAGE_SIZE - done);
+            if (nb_read <= 0) err = ERR_IO;
+            else done += (size_t) nb_read;
+        }
+    close(fd);
+    return err;
+}
 
-    while ((getline(&line, &len, file)) != -1)   //loops through the lines untils it runs out of lines
+// ======================================================================
+static int page_files_add(page_files_t* list, const char* filename, uint64_t vaddr, uint32_t addr)
+{
+    if (list->nb_files == list->allocated)
         {
+            const size_t allocated = list->allocated == 0 ? 64 : 2 * list->allocated;
+            page_file_t* const files = realloc(list->files, allocated * sizeof(page_file_t));
+            M_REQUIRE_NON_NULL_CUSTOM_ERR(files, ERR_MEM);
+            list->files = files;
+            list->allocated = allocated;
+        }
+    page_file_t* const file = &list->files[list->nb_files];
+    file->filename = strdup(filename);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file->filename, ERR_MEM);
+    file->vaddr = vaddr;
+    file->addr = addr;
+    ++list->nb_files;
+    return ERR_NONE;
+}
 
+// ======================================================================
+static void page_files_free(page_files_t* list)
+{
+    for (size_t i = 0; i < list->nb_files; ++i) free(list->files[i].filename);
+    free(list->files);
+    zero_init_ptr(list);
+}
 
-            if (counter == 0)                               //enters here at the first line
-                {
+// ======================================================================
+// a thread of the pool: reads files until there are no more, or an error
+static void* page_loader_run(void* arg)
+{
+    page_loader_t* const loader = arg;
+    size_t i = 0;
+    while ((i = atomic_fetch_add(&loader->next, 1)) < loader->nb_files
+           && atomic_load_explicit(&loader->err, memory_order_relaxed) == ERR_NONE)
+        {
+            const int err = page_file_load(loader->files[i].filename, loader->memory + loader->files[i].addr);
+            int none = ERR_NONE;
+            if (err != ERR_NONE) atomic_compare_exchange_strong(&loader->err, &none, err);
+        }
+    return NULL;
+}
 
-                    M_REQUIRE(sscanf(line, "%zu", &memory_size) > 0 , ERR_BAD_PARAMETER, " ",) ; //reads the first line
-                    *memory = calloc(memory_size, 1);
-                    M_REQUIRE_NON_NULL(memory);
-                } //allocates enough space
+// ======================================================================
+static int addr_compare(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+// ----------------------------------------------------------------------
+// tells if two files of a list are read (partly) at the same place
+static int page_files_overlap(const page_files_t* list, int* overlap)
+{
+    *overlap = 0;
+    if (list->nb_files < 2) return ERR_NONE;
+    uint32_t* const addrs = calloc(list->nb_files, sizeof(uint32_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(addrs, ERR_MEM);
+    for (size_t i = 0; i < list->nb_files; ++i) addrs[i] = list->files[i].addr;
+    qsort(addrs, list->nb_files, sizeof(uint32_t), addr_compare);
+    for (size_t i = 1; i < list->nb_files && !*overlap; ++i)
+        *overlap = (size_t) addrs[i - 1] + PAGE_SIZE > addrs[i];
+    free(addrs);
+    return ERR_NONE;
+}
+
+// ======================================================================
+// reads the files of a list at their offsets, in parallel
+static int page_files_load(uint8_t* memory, size_t mem_size, const page_files_t* list)
+{
+    for (size_t i = 0; i < list->nb_files; ++i)
+        M_REQUIRE((size_t) list->files[i].addr + PAGE_SIZE <= mem_size, ERR_ADDR,
+                  "%s: page beyond the memory", list->files[i].filename);
+    int overlap = 0;
+    M_EXIT_IF_ERR(page_files_overlap(list, &overlap), "sorting the page files");
+
+    page_loader_t loader;
+    loader.memory = memory;
+    loader.files = list->files;
+    loader.nb_files = list->nb_files;
+    atomic_init(&loader.next, 0);
+    atomic_init(&loader.err, ERR_NONE);
+
+    // the calling thread is one of the pool
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t nb_threads = online > 0 ? (size_t) online : 1;
+    if (nb_threads > MEM_LOAD_MAX_THREADS) nb_threads = MEM_LOAD_MAX_THREADS;
+    if (nb_threads > list->nb_files) nb_threads = list->nb_files;
+    if (overlap) nb_threads = 1; // in order
+
+    pthread_t threads[MEM_LOAD_MAX_THREADS];
+    size_t started = 0;
+    while (started + 1 < nb_threads && pthread_create(&threads[started], NULL, page_loader_run, &loader) == 0)
+        ++started;
+    page_loader_run(&loader);
+    for (size_t i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    return atomic_load(&loader.err);
+}
 
-            else if (counter == 1)                          //enters here at the second line
+// ======================================================================
+// parses a description into its lists of page files and memory size
+static int mem_description_parse(FILE* file, size_t* memory_size, page_files_t* tables, page_files_t* data)
+{
+    char* line = NULL;
+    size_t len = 0;
+    char* filename = NULL;
+    int err = ERR_NONE;
+    long nb_tables = 0;
+    for (long counter = 0; err == ERR_NONE && getline(&line, &len, file) != -1; ++counter)
+        {
+            char* const name = realloc(filename, len + 1); // a file name is at most a line long
+            if (name == NULL)
                 {
-                    file_name = calloc(128, sizeof(char));  //allocates enough space to the varibale that holds the name
-                    M_REQUIRE(sscanf(line, "%s", file_name) > 0 , ERR_BAD_PARAMETER, " ",);      //reads the second line
-                    M_REQUIRE(page_file_read(file_name, memory, 0) == 0, ERR_BAD_PARAMETER, " ",);
+                    err = ERR_MEM;
+                    break;
                 }
+            filename = name;
 
-            else if (counter == 2)                          //enters here at the third line
+            uint32_t addr = 0;
+            uint64_t vaddr = 0;
+            if (counter == 0)
                 {
-
-                    M_REQUIRE(sscanf(line, "%d", &n_translation_pages) > 0, ERR_BAD_PARAMETER, " ",);
-                } //reads the second line
-            else if (counter < n_translation_pages + 3)     //enters here for all the translation pages
+                    err = sscanf(line, "%zu", memory_size) == 1 ? ERR_NONE : ERR_BAD_PARAMETER;
+                }
+            else if (counter == 1) // the PGD, at 0
                 {
-
-                    M_REQUIRE(sscanf(line, "%d %s", &address, file_name2) > 0, ERR_BAD_PARAMETER, " ", );
-
-                    M_REQUIRE(page_file_read(file_name2, memory, address) == 0 , ERR_BAD_PARAMETER, " ",);
+                    err = sscanf(line, "%s", filename) == 1 ? page_files_add(tables, filename, 0, 0) : ERR_BAD_PARAMETER;
                 }
-            else                                            //enters here for the last lines
+            else if (counter == 2)
                 {
+                    err = sscanf(line, "%ld", &nb_tables) == 1 && nb_tables >= 0 ? ERR_NONE : ERR_BAD_PARAMETER;
+                }
+            else if (counter < nb_tables + 3)
+                {
+                    err = sscanf(line, "%" SCNx32 " %s", &addr, filename) == 2
+                          ? page_files_add(tables, filename, 0, addr) : ERR_BAD_PARAMETER;
+                }
+            else if (sscanf(line, "%" SCNx64 " %s", &vaddr, filename) == 2)
+                {
+                    err = page_files_add(data, filename, vaddr, 0);
+                }
+            else if (strspn(line, " \t\r\n") != strlen(line)) // not a blank line
+                {
+                    err = ERR_BAD_PARAMETER;
+                }
+        }
+    free(filename);
+    free(line);
+    return err;
+}
 
-                    uint64_t tovadd = 0;
-
-                    M_REQUIRE(sscanf(line, "%"SCNx64" %s", &tovadd, file_name2) > 0 , ERR_BAD_PARAMETER, " ",);
-
-                    virt_addr_t v_address; //creates a virtual address
-                    M_REQUIRE(init_virt_addr64(&v_address, tovadd) == 0, ERR_BAD_PARAMETER, " ",); //initializes virtual address
+// ======================================================================
+// See memory.h for description
+int mem_init_from_description(const char* master_filename, void** memory,
+                              size_t* mem_capacity_in_bytes)
+{
+    M_REQUIRE_NON_NULL(master_filename);
+    M_REQUIRE_NON_NULL(memory);
+    M_REQUIRE_NON_NULL(mem_capacity_in_bytes);
+    *memory = NULL;
 
-                    phy_addr_t paddr;      //creates a physical address
-                    M_REQUIRE(page_walk(*memory, &v_address, &paddr) == 0 , ERR_BAD_PARAMETER, " ", );
+    FILE* file = fopen(master_filename, "r");
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(file, ERR_IO);
 
-                    M_REQUIRE(page_file_read(file_name2, memory, (paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset) == 0 , ERR_BAD_PARAMETER, " " , );
+    size_t memory_size = 0;
+    page_files_t tables, data;
+    zero_init_var(tables);
+    zero_init_var(data);
+    int err = mem_description_parse(file, &memory_size, &tables, &data);
+    fclose(file);
 
-                }
+    uint8_t* mem = NULL;
+    if (err == ERR_NONE && (mem = mem_alloc(memory_size)) == NULL) err = ERR_MEM;
 
-            counter++;  //increases the counter
+    // the tables first: the addresses of the data pages are walked in them
+    if (err == ERR_NONE) err = page_files_load(mem, memory_size, &tables);
+    for (size_t i = 0; err == ERR_NONE && i < data.nb_files; ++i)
+        {
+            virt_addr_t vaddr;
+            phy_addr_t paddr;
+            err = init_virt_addr64(&vaddr, data.files[i].vaddr);
+            if (err == ERR_NONE) err = page_walk(mem, &vaddr, &paddr);
+            if (err == ERR_NONE) data.files[i].addr = (paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset;
         }
+    if (err == ERR_NONE) err = page_files_load(mem, memory_size, &data);
 
-    free(file_name); //free the variables
-    free(file_name2);
-
-    fclose(file); //closes the file
-
+    page_files_free(&tables);
+    page_files_free(&data);
+    if (err != ERR_NONE)
+        {
+            mem_free(mem, memory_size);
+            return err;
+        }
+    *memory = mem;
+    *mem_capacity_in_bytes = memory_size;
     return ERR_NONE;
-
 }
 
-
-/**
- * @brief      { Will put the information contained in a binary file in a specific address }
- *
- * @param[in]  filename  The file where the binary information is contained
- * @param      memory    The address where the memory starts
- * @param[in]  address   The address in the memory where we want to store de information of the binary file
- *
- * @return     { returns a error if something went wrong }
- */
+// ======================================================================
+// See memory.h for description
 int page_file_read(const char* filename, void** memory, pte_t address)
 {
-
-
-
-    M_REQUIRE_NON_NULL(filename);//requires that the arguments are null
+    M_REQUIRE_NON_NULL(filename);
     M_REQUIRE_NON_NULL(memory);
+    M_REQUIRE_NON_NULL(*memory);
 
-    const size_t size_of_file = 4096;
-
-    //opens the file
-    FILE *file = fopen(filename, "rb");
-    M_REQUIRE_NON_NULL(file);
-    // va tout au bout du fichier
-    M_REQUIRE(fseek(file, 0L, SEEK_END) > 0, ERR_BAD_PARAMETER, " ",);
-
-    // indique la position, et donc la taille (en octets)
-    size_t mem_capacity_in_bytes = (size_t) ftell(file);
-    // revient au début du fichier (pour le lire par la suite)
-    rewind(file);
-
-    //checks if the size is larger than the max size stated in the documentations
-    M_REQUIRE(mem_capacity_in_bytes == size_of_file, ERR_IO, "The file size does not correspond to a page file");
-
-    //reads the file and stores it in *memory + address
-    fread(((*memory) + address), 1, mem_capacity_in_bytes, file);
-
-    //closes the file
-    fclose(file);
-
-    return ERR_NONE;
-
-}
\ No newline at end of file
+    return page_file_load(filename, (uint8_t*) *memory + address);
+}
@@ -28,6 +28,12 @@ enum addr_fmt {
 typedef enum addr_fmt addr_fmt_t;
 
 
+/*
+ * The memory spaces created by the functions below are sparse: a page
+ * takes host memory once written only, the others all read as zeros.
+ * They shall be released with mem_free().
+ */
+
 /**
  * @brief Create and initialize the whole memory space from a provided
  * (binary) file containing one single dump of the whole memory space.
@@ -41,6 +47,36 @@ typedef enum addr_fmt addr_fmt_t;
 
 int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capacity_in_bytes);
 
+/**
+ * @brief Create the whole memory space by mapping a memory dump file
+ * (MAP_PRIVATE) instead of reading it: a page is read when first
+ * accessed, and copied when first written, so the file is never
+ * modified.
+ *
+ * @param filename the name of the memory dump file to map
+ * @param memory (modified) pointer to the begining of the memory
+ * @param mem_capacity_in_bytes (modified) total size of the memory, the one of the file
+ * @param advise_tables non zero to ask the system to read the page
+ *        tables (those reached from the PGD at 0) ahead
+ * @return error code, *memory shall be NULL in case of error
+ */
+int mem_map_dumpfile(const char* filename, void** memory, size_t* mem_capacity_in_bytes, int advise_tables);
+
+/**
+ * @brief Create an empty (all zeros) sparse memory space.
+ * @param mem_capacity_in_bytes its size
+ * @return the memory, NULL in case of error
+ */
+void* mem_alloc(size_t mem_capacity_in_bytes);
+
+/**
+ * @brief Release a memory space created by one of the functions above
+ * (or image_read(), see image_mng.h).
+ * @param memory the memory; may be NULL
+ * @param mem_capacity_in_bytes its size
+ */
+void mem_free(void* memory, size_t mem_capacity_in_bytes);
+
 
 /**
  * @brief Create and initialize the whole memory space from a provided
@@ -54,6 +90,10 @@ int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capa
  *  remaining lines: LIST OF DATA PAGES, expressed with two info per line:
  *                       VIRTUAL ADDRESS (uint64_t in hexa) and FILENAME
  *
+ * The page files (of exactly one page each) are read by a pool of
+ * threads: the PGD and translation pages, then the data pages once
+ * their addresses are translated by the loaded tables.
+ *
  * @param filename the name of the memory content description file to read from
  * @param memory (modified) pointer to the begining of the memory
  * @param mem_capacity_in_bytes (modified) total size of the created memory
@@ -80,4 +120,11 @@ int vmem_page_dump_with_options(const void *mem_space, const virt_addr_t* from,
 
 #define vmem_page_dump(mem, from) vmem_page_dump_with_options(mem, from, OFFSET, 16, " ")
 
+/**
+ * @brief Read a page file (of exactly one page) into the memory.
+ * @param filename the page file
+ * @param memory (modified) pointer to the begining of the memory
+ * @param address the offset of the page in the memory
+ * @return error code
+ */
 int page_file_read(const char* filename, void** memory, pte_t address);
@@ -5,6 +5,10 @@
 #include "addr_mng.h"
 #include <inttypes.h>
 #include "memory.h"
+#include "walk_cache_mng.h"
+
+// the tables of a walk, from the root
+enum { PGD_LEVEL, PUD_LEVEL, PMD_LEVEL, PTE_LEVEL, PAGE_WALK_LEVELS };
 
 
 
@@ -27,18 +31,69 @@ static inline pte_t read_page_entry(const pte_t* start, pte_t page_start, uint16
 
 
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr)
+{
+	return page_walk_sized(mem_space, vaddr, paddr, NULL);
+}
+
+
+int page_walk_sized(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* page_size)
+{
+	return page_walk_cached(mem_space, 0, vaddr, paddr, page_size, NULL, DATA, NULL);
+}
+
+
+int page_walk_cached(const void* mem_space, uint32_t cr3, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* page_size,
+                     walk_cache_t* caches, mem_access_t access, uint8_t* reads)
 {
 
 	M_REQUIRE_NON_NULL(mem_space); //Tests if all passed arguments are non null
 	M_REQUIRE_NON_NULL(vaddr);
 	M_REQUIRE_NON_NULL(paddr);
 
-	uint32_t PUD_start = read_page_entry(mem_space, 0, vaddr->pgd_entry); 		//Follows the address path as ilustrated in the notes
-	uint32_t PMD_start = read_page_entry(mem_space, PUD_start, vaddr->pud_entry);
-	uint32_t PT_start = read_page_entry(mem_space, PMD_start, vaddr->pmd_entry);
-	uint32_t phys_page_number = read_page_entry(mem_space, PT_start, vaddr->pte_entry);
+	const uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr);
+	const uint16_t index[PAGE_WALK_LEVELS] = { vaddr->pgd_entry, vaddr->pud_entry, vaddr->pmd_entry, vaddr->pte_entry };
+
+	// starts from the deepest table known, the PGD of the address space otherwise
+	const uint16_t pcid = cr3_pcid(cr3);
+	int level = 0;
+	uint32_t table = cr3_root(cr3);
+	if (caches != NULL)
+		{
+			for (int c = NB_WALK_CACHES - 1; c >= 0 && level == 0; --c)
+				{
+					if (walk_cache_lookup(&caches[c], pcid, virt_page_num, access, &table)) level = c + 1;
+				}
+		}
+
+	//Follows the address path as ilustrated in the notes
+	uint32_t entry = 0;
+	uint8_t nb_reads = 0;
+	for (; level < PAGE_WALK_LEVELS; ++level)
+		{
+			entry = read_page_entry(mem_space, table, index[level]);
+			++nb_reads;
+			if ((level == PUD_LEVEL || level == PMD_LEVEL) && (entry & PTE_PAGE_SIZE)) break; // a huge page
+			if (level < PTE_LEVEL)
+				{
+					table = entry & PTE_ADDR_MASK;
+					if (caches != NULL) walk_cache_insert(&caches[level], pcid, virt_page_num, access, table);
+				}
+		}
+
+	page_size_t size = PAGE_4K;
+	uint32_t phys_page_number = entry;
+	if (level < PAGE_WALK_LEVELS)
+		{
+			size = level == PUD_LEVEL ? PAGE_1G : PAGE_2M;
+			phys_page_number = entry & PTE_ADDR_MASK;
+			M_REQUIRE((phys_page_number & ((UINT32_C(1) << page_size_bits(size)) - 1)) == 0, ERR_BAD_PARAMETER,
+			          "huge page at 0x%08" PRIX32 " not aligned on its size", phys_page_number);
+			// the 4 kiB page of vaddr in the huge page
+			phys_page_number += (uint32_t) (virt_page_num & ((UINT64_C(1) << page_size_order(size)) - 1)) << PAGE_OFFSET;
+		}
+	if (page_size != NULL) *page_size = size;
+	if (reads != NULL) *reads = nb_reads;
 
 	return init_phy_addr(paddr, phys_page_number, vaddr->page_offset);
 
 }
-
@@ -9,6 +9,8 @@
  */
 
 #include "addr.h"
+#include "mem_access.h"
+#include "walk_cache.h"
 
 /**
  * @brief Page walker: virtual address to physical address conversion.
@@ -19,3 +21,34 @@
  * @return error code
  */
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr);
+
+/**
+ * @brief Page walker that also tells the size of the page mapping vaddr:
+ * the walk stops at a PUD entry (1 GiB page) or a PMD entry (2 MiB page)
+ * with PTE_PAGE_SIZE set (see addr.h).
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param page_size (SET) size of the page; may be NULL
+ * @return error code (ERR_BAD_PARAMETER for a huge page not aligned on its size)
+ */
+int page_walk_sized(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* page_size);
+
+/**
+ * @brief Page walker of any address space, starting from the deepest table
+ * the paging-structure caches know for vaddr (see walk_cache.h), which it
+ * then fills with the tables it reads.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param cr3 the address space: address of its PGD and PCID (see addr.h)
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param page_size (SET) size of the page; may be NULL
+ * @param caches the NB_WALK_CACHES caches, by walk_cache_type_t; may be NULL
+ * @param access the kind of access the walk is for, for the cache statistics
+ * @param reads (SET) number of page-table entries read (1 to 4); may be NULL
+ * @return error code, see page_walk_sized()
+ */
+int page_walk_cached(const void* mem_space, uint32_t cr3, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* page_size,
+                     walk_cache_t* caches, mem_access_t access, uint8_t* reads);
@@ -0,0 +1,145 @@
+#pragma once
+
+/**
+ * @file sim.h
+ * @brief a whole simulated machine: memory, TLB hierarchy and cache hierarchy
+ *
+ * @date 2019
+ */
+
+#include "cache.h"
+#include "tlb_hrchy.h"
+#include "stats.h"
+#include "stack_dist.h"
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+/**
+ * @brief Latency model: the cycles of an access, by the levels that
+ * served it. An access takes the cycles of its translation plus those of
+ * the cache level (or memory) its line was found in; writes take as long
+ * as reads (no store buffer), and write-backs, back-invalidations and
+ * prefetches are off the critical path.
+ */
+typedef struct
+{
+	uint16_t l1_tlb;    // translation found in an L1 TLB
+	uint16_t l2_tlb;    // translation found in the L2 TLB (L1 TLB lookup included)
+	uint16_t walk_read; // each page-table entry read by a walk, after the L2 TLB miss
+	uint16_t l1_cache;  // line found in an L1 cache (load-to-use)
+	uint16_t l2_cache;  // line found in L2 (L1 lookup included)
+	uint16_t l3_cache;  // line found in L3 (L1 and L2 lookups included)
+	uint16_t memory;    // line read from memory (all the lookups included)
+} sim_latency_t;
+
+/*
+ * Kaby Lake (i7-7700K, 4.2 GHz): the L1 TLB is looked up with the L1
+ * cache, and DRAM takes about 50 ns after the L3 miss.
+ */
+#define SIM_KABY_LAKE_LATENCY ((sim_latency_t) { 0, 9, 20, 4, 12, 42, 250 })
+
+/*
+ * Latency histograms: bucket 0 counts the accesses of 0 cycles, bucket i
+ * those of [2^(i-1), 2^i) cycles, the last one all the longer ones.
+ */
+#define SIM_LATENCY_BUCKETS 16u
+
+/**
+ * @brief Cycles of the accesses of a run, by kind of access.
+ */
+typedef struct
+{
+	uint64_t accesses[NB_MEM_ACCESS];
+	uint64_t tlb_cycles[NB_MEM_ACCESS];   // spent translating
+	uint64_t cache_cycles[NB_MEM_ACCESS]; // spent in the caches and memory
+	uint64_t histogram[NB_MEM_ACCESS][SIM_LATENCY_BUCKETS];
+} sim_latency_stats_t;
+
+/**
+ * @brief Run-time configuration of a simulated machine.
+ * (see tlb_hrchy.h and cache.h for the geometries)
+ */
+typedef struct
+{
+	cache_config_t l1_icache;
+	cache_config_t l1_dcache;
+	cache_config_t l2_cache;
+	cache_config_t l3_cache;  // shared by both L1 caches, below L2; 0 lines for none
+	uint16_t stack_dist_ways; // depth of the LRU stack distance analysis, 0 for none
+	tlb_hrchy_config_t tlb;
+	sim_latency_t latency;    // all 0 for no latency model
+} sim_config_t;
+
+#define SIM_DEFAULT_CONFIG ((sim_config_t) { L1_ICACHE_CONFIG, L1_DCACHE_CONFIG, L2_CACHE_CONFIG, { 0 }, 0, TLB_HRCHY_DEFAULT_CONFIG, { 0 } })
+
+/**
+ * @brief One access to the cache hierarchy: a command once translated.
+ */
+typedef struct
+{
+	phy_addr_t paddr;
+	word_t data;       // to write
+	uint8_t order;     // command_word_t
+	uint8_t type;      // mem_access_t
+	uint8_t data_size; // 1 or sizeof(word_t)
+	uint16_t tlb_cycles; // of its translation (latency model)
+} sim_access_t;
+
+/*
+ * Sequential runs (see sim_run_source()) translate the commands in blocks
+ * of at most SIM_BLOCK_SIZE (see tlb_search_batch()).
+ */
+#define SIM_BLOCK_SIZE    256u
+
+/*
+ * Parallel runs (see sim_run_parallel()): at most that many threads, each
+ * receiving its accesses in batches of SIM_BATCH_SIZE through a queue of
+ * SIM_QUEUE_BATCHES batches.
+ */
+#define SIM_MAX_THREADS   64u
+#define SIM_BATCH_SIZE    256u
+#define SIM_QUEUE_BATCHES 64u
+
+/**
+ * @brief A simulated machine.
+ * Each command is translated by the TLB hierarchy, then served by the
+ * cache hierarchy.
+ */
+typedef struct
+{
+	void * mem_space; // not owned by the machine
+	size_t mem_size;
+
+	tlb_hrchy_t tlbs;
+
+	cache_level_t l1_icache;
+	cache_level_t l1_dcache;
+	cache_level_t l2_cache;
+	cache_level_t l3_cache; // if config.l3_cache.lines > 0 (l3_cache.tags != NULL)
+
+	/*
+	 * LRU stack distances, if config.stack_dist_ways > 0: instruction then
+	 * data accesses with the sets and lines of the L1 caches, and all
+	 * accesses with those of L2 (as one cache on its own, not as a victim
+	 * cache). They give the hits of every associativity in one run.
+	 */
+	uint16_t stack_dist_ways;
+	stack_dist_t sd_l1_icache;
+	stack_dist_t sd_l1_dcache;
+	stack_dist_t sd_l2_cache;
+
+	uint64_t commands; // number of executed commands
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t switches; // context switches (SWITCH commands)
+
+	/*
+	 * Latency model, if config.latency is not all 0: the cycles of every
+	 * read and write, and those of the last one (sequential runs).
+	 */
+	uint8_t timed;
+	sim_latency_t latency;
+	sim_latency_stats_t latency_stats;
+	uint32_t last_latency;
+} sim_t;
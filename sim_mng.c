@@ -0,0 +1,714 @@
+/**
+ * @file sim_mng.c
+ * @brief running commands on a simulated machine
+ *
+ * @date 2019
+ */
+
+#include "sim_mng.h"
+#include "cache_mng.h"
+#include "tlb_hrchy_mng.h"
+#include "cmd_source_mng.h"
+#include "error.h"
+#include "spsc.h"
+#include "stack_dist_mng.h"
+#include "util.h" // zero_init_ptr
+#include <stdlib.h> // calloc
+#include <inttypes.h> // PRIu64
+#include <pthread.h>
+
+// ======================================================================
+// see sim_mng.h
+int sim_init(sim_t * sim, void * mem_space, size_t mem_size, const sim_config_t * config)
+{
+	M_REQUIRE_NON_NULL(sim);
+	M_REQUIRE_NON_NULL(mem_space);
+	M_REQUIRE_NON_NULL(config);
+
+	zero_init_ptr(sim);
+	sim->mem_space = mem_space;
+	sim->mem_size = mem_size;
+	sim->latency = config->latency;
+	const sim_latency_t * const latency = &config->latency;
+	sim->timed = (latency->l1_tlb | latency->l2_tlb | latency->walk_read | latency->l1_cache
+	              | latency->l2_cache | latency->l3_cache | latency->memory) != 0;
+
+	int err = tlb_hrchy_init(&sim->tlbs, &config->tlb);
+	if (err == ERR_NONE) err = cache_init(&sim->l1_icache, L1_ICACHE, &config->l1_icache);
+	if (err == ERR_NONE) err = cache_init(&sim->l1_dcache, L1_DCACHE, &config->l1_dcache);
+	if (err == ERR_NONE) err = cache_init(&sim->l2_cache, L2_CACHE, &config->l2_cache);
+	if (err == ERR_NONE) err = cache_attach_inner(&sim->l2_cache, &sim->l1_icache);
+	if (err == ERR_NONE) err = cache_attach_inner(&sim->l2_cache, &sim->l1_dcache);
+	if (err == ERR_NONE && config->l3_cache.lines > 0)
+		{
+			err = cache_init(&sim->l3_cache, L3_CACHE, &config->l3_cache);
+			if (err == ERR_NONE) err = cache_attach_next(&sim->l2_cache, &sim->l3_cache);
+		}
+	if (err == ERR_NONE && config->stack_dist_ways > 0)
+		{
+			sim->stack_dist_ways = config->stack_dist_ways;
+			err = stack_dist_init(&sim->sd_l1_icache, config->l1_icache.lines, config->stack_dist_ways,
+			                      config->l1_icache.words_per_line * (uint32_t) sizeof(word_t));
+			if (err == ERR_NONE)
+				err = stack_dist_init(&sim->sd_l1_dcache, config->l1_dcache.lines, config->stack_dist_ways,
+				                      config->l1_dcache.words_per_line * (uint32_t) sizeof(word_t));
+			if (err == ERR_NONE)
+				err = stack_dist_init(&sim->sd_l2_cache, config->l2_cache.lines, config->stack_dist_ways,
+				                      config->l2_cache.words_per_line * (uint32_t) sizeof(word_t));
+		}
+	if (err != ERR_NONE)
+		{
+			sim_free(sim);
+			return err;
+		}
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see sim_mng.h
+void sim_free(sim_t * sim)
+{
+	if (sim != NULL)
+		{
+			tlb_hrchy_free(&sim->tlbs);
+			cache_free(&sim->l1_icache);
+			cache_free(&sim->l1_dcache);
+			cache_free(&sim->l2_cache);
+			cache_free(&sim->l3_cache);
+			stack_dist_free(&sim->sd_l1_icache);
+			stack_dist_free(&sim->sd_l1_dcache);
+			stack_dist_free(&sim->sd_l2_cache);
+		}
+}
+
+// ======================================================================
+/*
+ * Latency model (see sim_latency_t)
+ */
+static uint16_t sim_tlb_cycles(const sim_latency_t * latency, const tlb_outcome_t * outcome)
+{
+	switch (outcome->level)
+		{
+		case L1_ITLB:
+		case L1_DTLB:
+			return latency->l1_tlb;
+		case L2_TLB:
+			return latency->l2_tlb;
+		default:
+			return (uint16_t) (latency->l2_tlb + outcome->walk_reads * latency->walk_read);
+		}
+}
+
+// ----------------------------------------------------------------------
+// histogram bucket of a latency (see SIM_LATENCY_BUCKETS)
+static size_t sim_latency_bucket(uint32_t cycles)
+{
+	const size_t bucket = cycles == 0 ? 0 : (size_t) (32 - __builtin_clz(cycles));
+	return bucket < SIM_LATENCY_BUCKETS ? bucket : SIM_LATENCY_BUCKETS - 1;
+}
+
+// ----------------------------------------------------------------------
+/*
+ * Counts the cycles of an access just served by the caches (see
+ * cache_level_t.served) and returns them.
+ */
+static uint32_t sim_time_access(const sim_latency_t * latency, sim_latency_stats_t * stats, const sim_access_t * access,
+                                const cache_level_t * l1_icache, const cache_level_t * l1_dcache)
+{
+	const cache_level_t * l1_cache = (access->type == INSTRUCTION) ? l1_icache : l1_dcache;
+	uint32_t cache_cycles = latency->memory;
+	switch (l1_cache->served)
+		{
+		case L1_ICACHE:
+		case L1_DCACHE:
+			cache_cycles = latency->l1_cache;
+			break;
+		case L2_CACHE:
+			cache_cycles = latency->l2_cache;
+			break;
+		case L3_CACHE:
+			cache_cycles = latency->l3_cache;
+			break;
+		default:
+			break;
+		}
+
+	const uint32_t cycles = access->tlb_cycles + cache_cycles;
+	++stats->accesses[access->type];
+	stats->tlb_cycles[access->type] += access->tlb_cycles;
+	stats->cache_cycles[access->type] += cache_cycles;
+	++stats->histogram[access->type][sim_latency_bucket(cycles)];
+	return cycles;
+}
+
+// ----------------------------------------------------------------------
+static void sim_latency_add(sim_latency_stats_t * sum, const sim_latency_stats_t * stats)
+{
+	for (size_t a = 0; a < NB_MEM_ACCESS; ++a)
+		{
+			sum->accesses[a] += stats->accesses[a];
+			sum->tlb_cycles[a] += stats->tlb_cycles[a];
+			sum->cache_cycles[a] += stats->cache_cycles[a];
+			for (size_t b = 0; b < SIM_LATENCY_BUCKETS; ++b)
+				sum->histogram[a][b] += stats->histogram[a][b];
+		}
+}
+
+// ======================================================================
+/*
+ * A read or write once translated: its access to the cache hierarchy,
+ * its LRU stack distances and its counter.
+ */
+static void sim_count_access(sim_t * sim, const command_t * command, const phy_addr_t * paddr,
+                             const tlb_outcome_t * outcome, sim_access_t * access)
+{
+	access->paddr = *paddr;
+	access->data = command->write_data;
+	access->order = (uint8_t) command->order;
+	access->type = (uint8_t) command->type;
+	access->data_size = (uint8_t) command->data_size;
+	access->tlb_cycles = sim->timed ? sim_tlb_cycles(&sim->latency, outcome) : 0;
+
+	if (sim->stack_dist_ways > 0)
+		{
+			stack_dist_access(command->type == INSTRUCTION ? &sim->sd_l1_icache : &sim->sd_l1_dcache, paddr);
+			stack_dist_access(&sim->sd_l2_cache, paddr);
+		}
+
+	if (command->order == READ) ++sim->reads;
+	else ++sim->writes;
+}
+
+// ======================================================================
+/*
+ * First half of a command: counts it and translates its address through
+ * the TLB hierarchy. A context switch is done here: it has no second half.
+ */
+static int sim_translate(sim_t * sim, const command_t * command, sim_access_t * access)
+{
+	M_REQUIRE(command->order == READ || command->order == WRITE || command->order == SWITCH,
+	          ERR_BAD_PARAMETER, "%d: unknown order", command->order);
+
+	access->order = (uint8_t) command->order;
+	if (command->order == SWITCH)
+		{
+			M_EXIT_IF_ERR(tlb_hrchy_switch(&sim->tlbs, command->write_data), "switching address space");
+			++sim->switches;
+			return ERR_NONE;
+		}
+
+	int hit = 0;
+	phy_addr_t paddr;
+	tlb_outcome_t outcome;
+	M_EXIT_IF_ERR(tlb_search(sim->mem_space, &command->vaddr, &paddr, command->type,
+	                         &sim->tlbs, &hit, NULL, &outcome),
+	              "translating the address");
+	sim_count_access(sim, command, &paddr, &outcome, access);
+	return ERR_NONE;
+}
+
+// ======================================================================
+/*
+ * Second half of a command: the access to the cache hierarchy.
+ */
+static int sim_cache_access(void * mem_space, const sim_access_t * access,
+                            cache_level_t * l1_icache, cache_level_t * l1_dcache, cache_level_t * l2_cache)
+{
+	cache_level_t * l1_cache = (access->type == INSTRUCTION) ? l1_icache : l1_dcache;
+	phy_addr_t paddr = access->paddr; // the cache functions take it non-const
+	if (access->order == READ)
+		{
+			if (access->data_size == 1)
+				{
+					uint8_t byte = 0;
+					M_EXIT_IF_ERR(cache_read_byte(mem_space, &paddr, (mem_access_t) access->type, l1_cache, l2_cache, &byte),
+					              "reading a byte");
+				}
+			else
+				{
+					word_t word = 0;
+					M_EXIT_IF_ERR(cache_read(mem_space, &paddr, (mem_access_t) access->type, l1_cache, l2_cache, &word),
+					              "reading a word");
+				}
+		}
+	else
+		{
+			if (access->data_size == 1)
+				{
+					uint8_t byte = (uint8_t) access->data;
+					M_EXIT_IF_ERR(cache_write_byte(mem_space, &paddr, l1_dcache, l2_cache, &byte),
+					              "writing a byte");
+				}
+			else
+				{
+					M_EXIT_IF_ERR(cache_write(mem_space, &paddr, l1_dcache, l2_cache, &access->data),
+					              "writing a word");
+				}
+		}
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see sim_mng.h
+int sim_execute(sim_t * sim, const command_t * command)
+{
+	M_REQUIRE_NON_NULL(sim);
+	M_REQUIRE_NON_NULL(command);
+
+	sim_access_t access;
+	M_EXIT_IF_ERR(sim_translate(sim, command, &access), "translating the address");
+	if (access.order != SWITCH)
+		{
+			M_EXIT_IF_ERR(sim_cache_access(sim->mem_space, &access, &sim->l1_icache, &sim->l1_dcache, &sim->l2_cache),
+			              "accessing the caches");
+			if (sim->timed)
+				sim->last_latency = sim_time_access(&sim->latency, &sim->latency_stats, &access,
+				                                    &sim->l1_icache, &sim->l1_dcache);
+		}
+	++sim->commands;
+	return ERR_NONE;
+}
+
+// ======================================================================
+/*
+ * Blocks of commands.
+ *
+ * The reads of a block are translated together (tlb_search_batch()), then
+ * served by the caches. A block ends after its first command that is not
+ * a read: a write may change the page tables the next translations walk,
+ * and a context switch changes the address space they are done in. With
+ * write-back caches, a read may also write memory (the dirty line it
+ * evicts), so every command is a block of its own. The result of every
+ * command is thus the one of sim_execute(), in order.
+ */
+#define sim_ends_block(SIM, COMMAND) \
+	((COMMAND)->order != READ || (SIM)->l1_icache.config.write_back || (SIM)->l1_dcache.config.write_back)
+
+// ----------------------------------------------------------------------
+// number of commands of the block starting at commands, out of n
+static size_t sim_block_length(const sim_t * sim, const command_t * commands, size_t n)
+{
+	size_t length = 0;
+	while (length < n && length < SIM_BLOCK_SIZE)
+		if (sim_ends_block(sim, &commands[length++])) break;
+	return length;
+}
+
+// ----------------------------------------------------------------------
+static int sim_run_block(sim_t * sim, const command_t * commands, size_t n)
+{
+	virt_addr_t vaddrs[SIM_BLOCK_SIZE];
+	mem_access_t accesses[SIM_BLOCK_SIZE];
+	phy_addr_t paddrs[SIM_BLOCK_SIZE];
+	tlb_outcome_t outcomes[SIM_BLOCK_SIZE];
+
+	size_t nb_accesses = 0;
+	for (; nb_accesses < n && (commands[nb_accesses].order == READ || commands[nb_accesses].order == WRITE); ++nb_accesses)
+		{
+			vaddrs[nb_accesses] = commands[nb_accesses].vaddr;
+			accesses[nb_accesses] = commands[nb_accesses].type;
+		}
+
+	size_t translated = 0;
+	const int err = tlb_search_batch(sim->mem_space, vaddrs, accesses, paddrs, nb_accesses, &sim->tlbs, NULL,
+	                                 sim->timed ? outcomes : NULL, &translated);
+	for (size_t i = 0; i < translated; ++i)
+		{
+			sim_access_t access;
+			sim_count_access(sim, &commands[i], &paddrs[i], &outcomes[i], &access);
+			M_EXIT_IF_ERR(sim_cache_access(sim->mem_space, &access, &sim->l1_icache, &sim->l1_dcache, &sim->l2_cache),
+			              "accessing the caches");
+			if (sim->timed)
+				sim->last_latency = sim_time_access(&sim->latency, &sim->latency_stats, &access,
+				                                    &sim->l1_icache, &sim->l1_dcache);
+			++sim->commands;
+		}
+	M_EXIT_IF_ERR(err, "translating the addresses");
+
+	// the context switch ending the block, if any
+	if (nb_accesses < n) M_EXIT_IF_ERR(sim_execute(sim, &commands[nb_accesses]), "executing a command");
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see sim_mng.h
+int sim_run(sim_t * sim, const program_t * program)
+{
+	M_REQUIRE_NON_NULL(sim);
+	M_REQUIRE_NON_NULL(program);
+
+	size_t length = 0;
+	for (size_t line = 0; line < program->nb_lines; line += length)
+		{
+			length = sim_block_length(sim, &program->listing[line], program->nb_lines - line);
+			M_EXIT_IF_ERR(sim_run_block(sim, &program->listing[line], length), "executing commands");
+		}
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see sim_mng.h
+int sim_run_source(sim_t * sim, cmd_source_t * source)
+{
+	M_REQUIRE_NON_NULL(sim);
+	M_REQUIRE_NON_NULL(source);
+
+	command_t block[SIM_BLOCK_SIZE];
+	size_t length = 0;
+	int err = ERR_NONE;
+	while ((err = cmd_source_next(source, &block[length])) == ERR_NONE)
+		{
+			if (sim_ends_block(sim, &block[length++]) || length == SIM_BLOCK_SIZE)
+				{
+					M_EXIT_IF_ERR(sim_run_block(sim, block, length), "executing commands");
+					length = 0;
+				}
+		}
+	// the commands read before the end (or an error) of the source
+	if (length > 0) M_EXIT_IF_ERR(sim_run_block(sim, block, length), "executing commands");
+	return err == ERR_EOF ? ERR_NONE : err;
+}
+
+// ======================================================================
+/*
+ * Parallel runs.
+ *
+ * Sets are independent in the cache hierarchy: the only movement between
+ * sets is an L1 victim going to L2, and an L1 set only sends victims to
+ * the L2 sets that share its low index bits. Shard k of n (n a power of
+ * 2, at most the number of lines of every cache) is thus made of the
+ * sets whose index is k modulo n, in all three caches: the accesses of
+ * a shard never touch the sets of another one.
+ *
+ * The calling thread translates every command (the TLB hierarchy is
+ * shared), then sends the access to the worker of its shard. Each worker
+ * runs its accesses in order on a copy of the cache_level_t's: same
+ * storage, its own statistics. After a command that may write memory
+ * (see sim_ends_block()), the calling thread waits for every worker to
+ * be done before walking the page tables again, as a block ends in the
+ * sequential run. The result of every access is thus the one of the
+ * sequential run; the statistics are summed at the end.
+ * (The back-invalidations of an inclusive L2 or L3 go through the inner
+ * caches of the copy, i.e. those of the machine: they only touch their
+ * storage, in the sets of the shard. The slice of an L3 line is in the
+ * high bits of its set index, so L3 shards by its low bits as well.)
+ */
+typedef struct
+{
+	uint32_t count; // 0 for the last batch of a run
+	sim_access_t accesses[SIM_BATCH_SIZE];
+} sim_batch_t;
+
+typedef struct
+{
+	spsc_queue_t queue; // of sim_batch_t
+	void * mem_space;
+	cache_level_t l1_icache;
+	cache_level_t l1_dcache;
+	cache_level_t l2_cache;
+	cache_level_t l3_cache;
+	const sim_latency_t * latency; // NULL without latency model
+	sim_latency_stats_t latency_stats;
+	atomic_int * failed; // shared by all the workers of a run
+	int err;
+	pthread_t thread;
+} sim_worker_t;
+
+// ======================================================================
+static void * sim_worker_run(void * arg)
+{
+	sim_worker_t * const worker = arg;
+	for (;;)
+		{
+			const sim_batch_t * const batch = spsc_pop_slot(&worker->queue);
+			const uint32_t count = batch->count;
+			// after a failure, only drains its queue
+			for (uint32_t i = 0; i < count && worker->err == ERR_NONE; ++i)
+				{
+					worker->err = sim_cache_access(worker->mem_space, &batch->accesses[i],
+					                               &worker->l1_icache, &worker->l1_dcache, &worker->l2_cache);
+					if (worker->err != ERR_NONE) atomic_store(worker->failed, 1);
+					else if (worker->latency != NULL)
+						sim_time_access(worker->latency, &worker->latency_stats, &batch->accesses[i],
+						                &worker->l1_icache, &worker->l1_dcache);
+				}
+			spsc_pop(&worker->queue);
+			if (count == 0) return NULL;
+		}
+}
+
+// ======================================================================
+// the batch being filled for a worker is always the slot after the queue head
+#define sim_batch_of(WORKER) ((sim_batch_t *) spsc_push_slot(&(WORKER)->queue))
+
+// ----------------------------------------------------------------------
+// sends the batches being filled, then waits for the workers to run them all
+static void sim_workers_drain(sim_worker_t * workers, unsigned nb_workers)
+{
+	for (unsigned i = 0; i < nb_workers; ++i)
+		if (sim_batch_of(&workers[i])->count > 0)
+			{
+				spsc_push(&workers[i].queue);
+				sim_batch_of(&workers[i])->count = 0;
+			}
+	for (unsigned i = 0; i < nb_workers; ++i) spsc_drain(&workers[i].queue);
+}
+
+// ======================================================================
+static int sim_check_shards(const sim_t * sim, unsigned nb_threads)
+{
+	M_REQUIRE(nb_threads > 0 && nb_threads <= SIM_MAX_THREADS && (nb_threads & (nb_threads - 1)) == 0,
+	          ERR_BAD_PARAMETER, "%u: number of threads not a power of 2 up to %u", nb_threads, SIM_MAX_THREADS);
+
+	const cache_level_t * const caches[] = { &sim->l1_icache, &sim->l1_dcache, &sim->l2_cache, &sim->l3_cache };
+	for (size_t i = 0; i < sizeof(caches) / sizeof(caches[0]); ++i)
+		{
+			if (caches[i]->tags == NULL) continue; // no L3
+			M_REQUIRE((1u << caches[i]->index_bits) >= nb_threads, ERR_BAD_PARAMETER,
+			          "%u threads but only %u lines (per slice)", nb_threads, 1u << caches[i]->index_bits);
+			// a generator shared by all the sets would depend on the interleaving of the shards
+			M_REQUIRE(caches[i]->config.replace != RANDOM && caches[i]->config.replace != BRRIP, ERR_POLICY,
+			          "%s", "randomized replacement policy");
+			// the streams of a prefetcher and its prefetches span all the sets
+			M_REQUIRE(caches[i]->prefetch == NULL, ERR_POLICY, "%s", "prefetcher");
+		}
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see sim_mng.h
+int sim_run_parallel(sim_t * sim, cmd_source_t * source, unsigned nb_threads)
+{
+	M_REQUIRE_NON_NULL(sim);
+	M_REQUIRE_NON_NULL(source);
+	M_EXIT_IF_ERR(sim_check_shards(sim, nb_threads), "sharding the caches");
+	if (nb_threads == 1) return sim_run_source(sim, source);
+
+	sim_worker_t * const workers = calloc(nb_threads, sizeof(sim_worker_t));
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(workers, ERR_MEM);
+	atomic_int failed;
+	atomic_init(&failed, 0);
+
+	int err = ERR_NONE;
+	unsigned started = 0;
+	for (; started < nb_threads; ++started)
+		{
+			sim_worker_t * const worker = &workers[started];
+			if ((err = spsc_init(&worker->queue, SIM_QUEUE_BATCHES, sizeof(sim_batch_t))) != ERR_NONE) break;
+			worker->mem_space = sim->mem_space;
+			worker->l1_icache = sim->l1_icache;
+			worker->l1_dcache = sim->l1_dcache;
+			worker->l2_cache = sim->l2_cache;
+			worker->l3_cache = sim->l3_cache;
+			if (worker->l2_cache.next != NULL) worker->l2_cache.next = &worker->l3_cache; // counts in its own L3 copy
+			stats_reset(&worker->l1_icache.stats);
+			stats_reset(&worker->l1_dcache.stats);
+			stats_reset(&worker->l2_cache.stats);
+			stats_reset(&worker->l3_cache.stats);
+			worker->latency = sim->timed ? &sim->latency : NULL;
+			worker->failed = &failed;
+			sim_batch_of(worker)->count = 0;
+			if (pthread_create(&worker->thread, NULL, sim_worker_run, worker) != 0)
+				{
+					spsc_free(&worker->queue);
+					err = ERR_MEM;
+					break;
+				}
+		}
+
+	// shard of an access: the low bits of its set index
+	const uint32_t shard_mask = nb_threads - 1;
+	const uint8_t line_bits = sim->l1_icache.line_bits;
+
+	command_t command;
+	int drain = 0; // the previous command may have written memory
+	while (err == ERR_NONE && (err = cmd_source_next(source, &command)) == ERR_NONE)
+		{
+			if (drain) sim_workers_drain(workers, started);
+			drain = sim_ends_block(sim, &command) && command.order != SWITCH;
+
+			sim_access_t access;
+			if ((err = sim_translate(sim, &command, &access)) != ERR_NONE) break;
+			if (access.order == SWITCH)
+				{
+					++sim->commands;
+					continue;
+				}
+
+			sim_worker_t * const worker = &workers[(phy_addr_t_to_uint32_t(&access.paddr) >> line_bits) & shard_mask];
+			sim_batch_t * const batch = sim_batch_of(worker);
+			batch->accesses[batch->count++] = access;
+			++sim->commands;
+			if (batch->count == SIM_BATCH_SIZE)
+				{
+					spsc_push(&worker->queue);
+					sim_batch_of(worker)->count = 0;
+					if (atomic_load_explicit(&failed, memory_order_relaxed)) break;
+				}
+		}
+	if (err == ERR_EOF) err = ERR_NONE;
+
+	// flushes the last batches, then an empty one to stop each worker
+	for (unsigned i = 0; i < started; ++i)
+		{
+			if (sim_batch_of(&workers[i])->count > 0)
+				{
+					spsc_push(&workers[i].queue);
+					sim_batch_of(&workers[i])->count = 0;
+				}
+			spsc_push(&workers[i].queue);
+		}
+	for (unsigned i = 0; i < started; ++i)
+		{
+			sim_worker_t * const worker = &workers[i];
+			pthread_join(worker->thread, NULL);
+			if (err == ERR_NONE) err = worker->err;
+			stats_add(&sim->l1_icache.stats, &worker->l1_icache.stats);
+			stats_add(&sim->l1_dcache.stats, &worker->l1_dcache.stats);
+			stats_add(&sim->l2_cache.stats, &worker->l2_cache.stats);
+			stats_add(&sim->l3_cache.stats, &worker->l3_cache.stats);
+			sim_latency_add(&sim->latency_stats, &worker->latency_stats);
+			spsc_free(&worker->queue);
+		}
+	free(workers);
+	return err;
+}
+
+// ======================================================================
+// see sim_mng.h
+int sim_write_back(sim_t * sim)
+{
+	M_REQUIRE_NON_NULL(sim);
+
+	// outer levels first: a line in L3 and in L2 or L1 is newer in the inner cache
+	if (sim->l3_cache.tags != NULL)
+		M_EXIT_IF_ERR(cache_write_back(sim->mem_space, &sim->l3_cache), "writing L3 CACHE back");
+	M_EXIT_IF_ERR(cache_write_back(sim->mem_space, &sim->l2_cache), "writing L2 CACHE back");
+	M_EXIT_IF_ERR(cache_write_back(sim->mem_space, &sim->l1_icache), "writing L1 ICACHE back");
+	M_EXIT_IF_ERR(cache_write_back(sim->mem_space, &sim->l1_dcache), "writing L1 DCACHE back");
+	return ERR_NONE;
+}
+
+// ======================================================================
+/*
+ * Prints a counter that is not in the statistics tables (see stat_t),
+ * for each cache, of all kinds of access.
+ */
+static void sim_print_counter(FILE * output, stats_format_t format, const sim_t * sim, const char * name, stat_t stat)
+{
+	const cache_level_t * const caches[] = { &sim->l1_icache, &sim->l1_dcache, &sim->l2_cache, &sim->l3_cache };
+	const char * const names[] = { "L1_ICACHE", "L1_DCACHE", "L2_CACHE", "L3_CACHE" };
+	if (format == STATS_TEXT) fprintf(output, "\n%s\n", name);
+	else fprintf(output, "\nlevel,%s\n", name);
+	for (size_t i = 0; i < sizeof(caches) / sizeof(caches[0]); ++i)
+		if (caches[i]->tags != NULL)
+			fprintf(output, format == STATS_TEXT ? "  %-12s %12" PRIu64 "\n" : "%s,%" PRIu64 "\n", names[i],
+			        stats_get(&caches[i]->stats, INSTRUCTION, stat) + stats_get(&caches[i]->stats, DATA, stat));
+}
+
+// ======================================================================
+// average of a sum over n, 0 if n is 0
+static double sim_average(uint64_t sum, uint64_t n)
+{
+	return n == 0 ? 0.0 : (double) sum / (double) n;
+}
+
+// ----------------------------------------------------------------------
+/*
+ * Prints the average memory access time (AMAT) of instructions, data and
+ * all accesses, split into translation and caches, then the histogram of
+ * the latencies.
+ */
+static void sim_print_latency(FILE * output, stats_format_t format, const sim_latency_stats_t * stats)
+{
+	const char * const names[] = { "instruction", "data", "total" };
+	uint64_t accesses[3] = { stats->accesses[INSTRUCTION], stats->accesses[DATA], 0 };
+	uint64_t tlb_cycles[3] = { stats->tlb_cycles[INSTRUCTION], stats->tlb_cycles[DATA], 0 };
+	uint64_t cache_cycles[3] = { stats->cache_cycles[INSTRUCTION], stats->cache_cycles[DATA], 0 };
+	accesses[2] = accesses[0] + accesses[1];
+	tlb_cycles[2] = tlb_cycles[0] + tlb_cycles[1];
+	cache_cycles[2] = cache_cycles[0] + cache_cycles[1];
+
+	if (format == STATS_TEXT)
+		fprintf(output, "\n%-14s %12s %12s %12s %12s\n", "latency", "accesses", "translation", "cache", "AMAT");
+	else
+		fputs("\nlatency,accesses,translation,cache,amat\n", output);
+	for (size_t i = 0; i < 3; ++i)
+		fprintf(output, format == STATS_TEXT ? "  %-12s %12" PRIu64 " %12.2f %12.2f %12.2f\n"
+		        : "%s,%" PRIu64 ",%.2f,%.2f,%.2f\n", names[i], accesses[i],
+		        sim_average(tlb_cycles[i], accesses[i]), sim_average(cache_cycles[i], accesses[i]),
+		        sim_average(tlb_cycles[i] + cache_cycles[i], accesses[i]));
+
+	size_t last = 0;
+	for (size_t b = 0; b < SIM_LATENCY_BUCKETS; ++b)
+		if (stats->histogram[INSTRUCTION][b] + stats->histogram[DATA][b] > 0) last = b;
+
+	if (format == STATS_TEXT)
+		fprintf(output, "\n%-14s %12s %12s\n", "cycles", "instruction", "data");
+	else
+		fputs("\ncycles,instruction,data\n", output);
+	for (size_t b = 0; b <= last; ++b)
+		{
+			// bucket b > 0 holds [2^(b-1), 2^b), the last one has no bound
+			char range[32];
+			const unsigned low = b == 0 ? 0u : 1u << (b - 1);
+			const unsigned high = b == 0 ? 0u : (1u << b) - 1u;
+			if (b == SIM_LATENCY_BUCKETS - 1) snprintf(range, sizeof(range), "%u-", low);
+			else if (low == high) snprintf(range, sizeof(range), "%u", low);
+			else snprintf(range, sizeof(range), "%u-%u", low, high);
+			fprintf(output, format == STATS_TEXT ? "  %-12s %12" PRIu64 " %12" PRIu64 "\n"
+			        : "%s,%" PRIu64 ",%" PRIu64 "\n", range,
+			        stats->histogram[INSTRUCTION][b], stats->histogram[DATA][b]);
+		}
+}
+
+// ======================================================================
+// see sim_mng.h
+int sim_print_summary(FILE * output, stats_format_t format, const sim_t * sim)
+{
+	M_REQUIRE_NON_NULL(output);
+	M_REQUIRE_NON_NULL(sim);
+
+	if (format == STATS_TEXT)
+		{
+			fprintf(output, "commands: %" PRIu64 " (%" PRIu64 " reads, %" PRIu64 " writes",
+			        sim->commands, sim->reads, sim->writes);
+			if (sim->switches > 0) fprintf(output, ", %" PRIu64 " switches", sim->switches);
+			fputs(")\n\n", output);
+		}
+
+	M_EXIT_IF_ERR(stats_print_header(output, format), "printing header");
+	M_EXIT_IF_ERR(tlb_hrchy_stats_print(output, format, &sim->tlbs), "printing TLB stats");
+	M_EXIT_IF_ERR(cache_stats_print(output, format, &sim->l1_icache), "printing L1 ICACHE stats");
+	M_EXIT_IF_ERR(cache_stats_print(output, format, &sim->l1_dcache), "printing L1 DCACHE stats");
+	M_EXIT_IF_ERR(cache_stats_print(output, format, &sim->l2_cache), "printing L2 CACHE stats");
+	if (sim->l3_cache.tags != NULL)
+		M_EXIT_IF_ERR(cache_stats_print(output, format, &sim->l3_cache), "printing L3 CACHE stats");
+
+	if (sim->l1_icache.config.write_back || sim->l1_dcache.config.write_back)
+		sim_print_counter(output, format, sim, "writebacks", STAT_WRITEBACKS);
+	if (sim->l2_cache.config.inclusion == INCLUSIVE
+	    || (sim->l3_cache.tags != NULL && sim->l3_cache.config.inclusion == INCLUSIVE))
+		sim_print_counter(output, format, sim, "back_invalidations", STAT_BACK_INVALIDATIONS);
+	if (sim->l1_icache.prefetch != NULL || sim->l1_dcache.prefetch != NULL
+	    || sim->l2_cache.prefetch != NULL || sim->l3_cache.prefetch != NULL)
+		{
+			sim_print_counter(output, format, sim, "prefetches", STAT_PREFETCHES);
+			sim_print_counter(output, format, sim, "useful_prefetches", STAT_PREFETCH_USEFUL);
+			sim_print_counter(output, format, sim, "late_prefetches", STAT_PREFETCH_LATE);
+			sim_print_counter(output, format, sim, "polluting_prefetches", STAT_PREFETCH_POLLUTING);
+		}
+	if (sim->timed) sim_print_latency(output, format, &sim->latency_stats);
+
+	if (sim->stack_dist_ways > 0)
+		{
+			fputc('\n', output);
+			M_EXIT_IF_ERR(stack_dist_print_header(output, format), "printing header");
+			M_EXIT_IF_ERR(stack_dist_print(output, format, "L1_ICACHE", &sim->sd_l1_icache), "printing L1 ICACHE distances");
+			if (format == STATS_TEXT) fputc('\n', output);
+			M_EXIT_IF_ERR(stack_dist_print(output, format, "L1_DCACHE", &sim->sd_l1_dcache), "printing L1 DCACHE distances");
+			if (format == STATS_TEXT) fputc('\n', output);
+			M_EXIT_IF_ERR(stack_dist_print(output, format, "L2_CACHE", &sim->sd_l2_cache), "printing L2 CACHE distances");
+		}
+	return ERR_NONE;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+/**
+ * @file sim_mng.h
+ * @brief running commands on a simulated machine
+ *
+ * @date 2019
+ */
+
+#include "sim.h"
+#include "commands.h"
+#include "cmd_source.h"
+#include <stdio.h> // FILE
+
+//=========================================================================
+/**
+ * @brief "Constructor" for sim_t: empty TLBs and caches, counters at 0.
+ *
+ * @param sim (modified) the machine to be initialized
+ * @param mem_space the memory of the machine (see memory.h), kept by the caller
+ * @param mem_size its size in bytes
+ * @param config the geometry and policies of the caches
+ * @return error code
+ */
+int sim_init(sim_t * sim, void * mem_space, size_t mem_size, const sim_config_t * config);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for sim_t: free the caches (not the memory).
+ * @param sim the machine to be freed
+ */
+void sim_free(sim_t * sim);
+
+//=========================================================================
+/**
+ * @brief Executes one command: translation (tlb_search()) then
+ * cache access (cache_read(), cache_write() or their byte variants).
+ * With the latency model, its cycles are left in sim->last_latency.
+ *
+ * @param sim the machine
+ * @param command the command to execute
+ * @return error code
+ */
+int sim_execute(sim_t * sim, const command_t * command);
+
+//=========================================================================
+/**
+ * @brief Executes all the commands of a program, in order, as
+ * sim_run_source() does; stops at the first error.
+ *
+ * @param sim the machine
+ * @param program the commands to execute
+ * @return error code
+ */
+int sim_run(sim_t * sim, const program_t * program);
+
+//=========================================================================
+/**
+ * @brief Executes all the commands of a source, pulling them up to its
+ * end; stops at the first error. The addresses are translated in blocks
+ * of commands (see SIM_BLOCK_SIZE), with the results of sim_execute() on
+ * each command in order.
+ *
+ * @param sim the machine
+ * @param source the opened source (see cmd_source_mng.h)
+ * @return error code
+ */
+int sim_run_source(sim_t * sim, cmd_source_t * source);
+
+//=========================================================================
+/**
+ * @brief Executes all the commands of a source as sim_run_source() does,
+ * with the caches split by set index across nb_threads threads.
+ *
+ * The calling thread translates the addresses, in order, and sends each
+ * access to the thread owning its set; every thread serves its accesses
+ * in order. The results are those of sim_run_source(), provided that the
+ * program does not write its own page tables. On error, accesses that
+ * follow the failing one may have been counted.
+ *
+ * @param sim the machine
+ * @param source the opened source (see cmd_source_mng.h)
+ * @param nb_threads a power of 2, at most SIM_MAX_THREADS and the number
+ *        of lines of every cache
+ * @return error code (ERR_POLICY for RANDOM and BRRIP caches, whose
+ *         shared generator would depend on the interleaving of threads)
+ */
+int sim_run_parallel(sim_t * sim, cmd_source_t * source, unsigned nb_threads);
+
+//=========================================================================
+/**
+ * @brief Writes the dirty lines of the caches back to memory, at the end
+ * of a run with write-back caches (see cache_write_back()).
+ *
+ * @param sim the machine
+ * @return error code
+ */
+int sim_write_back(sim_t * sim);
+
+//=========================================================================
+/**
+ * @brief Prints the counters of the machine: number of commands, then the
+ * statistics of every TLB and cache, then the writebacks of every cache
+ * if they are write-back, the back-invalidations if L2 or L3 is
+ * inclusive, the prefetch counters if a cache prefetches, and the average
+ * memory access time and histogram of latencies with the latency model
+ * (see sim_latency_t).
+ *
+ * @param output the stream to print to
+ * @param format text or CSV (see stats_print())
+ * @param sim the machine
+ * @return error code
+ */
+int sim_print_summary(FILE * output, stats_format_t format, const sim_t * sim);
@@ -0,0 +1,104 @@
+/**
+ * @file spsc.c
+ * @brief lock-free single-producer single-consumer queue
+ *
+ * @date 2019
+ */
+
+#define _POSIX_C_SOURCE 200809L // sched_yield
+
+#include "spsc.h"
+#include "error.h"
+
+#include <stdlib.h> // aligned_alloc
+#include <sched.h>  // sched_yield
+
+// spins before yielding the CPU while waiting on the other side
+#define SPSC_SPINS 256
+
+// ======================================================================
+// see spsc.h
+int spsc_init(spsc_queue_t * queue, size_t capacity, size_t slot_size)
+{
+	M_REQUIRE_NON_NULL(queue);
+	M_REQUIRE(capacity > 0 && (capacity & (capacity - 1)) == 0, ERR_BAD_PARAMETER, "%zu: capacity not a power of 2", capacity);
+	M_REQUIRE(slot_size > 0, ERR_BAD_PARAMETER, "%s", "empty slots");
+
+	// whole host cache lines per slot: no false sharing between neighbours
+	queue->slot_size = (slot_size + SPSC_CACHE_LINE - 1) / SPSC_CACHE_LINE * SPSC_CACHE_LINE;
+	queue->slots = aligned_alloc(SPSC_CACHE_LINE, capacity * queue->slot_size);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(queue->slots, ERR_MEM);
+	queue->mask = capacity - 1;
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->tail, 0);
+	return ERR_NONE;
+}
+
+// ======================================================================
+static void spsc_wait(unsigned * spins)
+{
+	if (++*spins >= SPSC_SPINS)
+		{
+			*spins = 0;
+			sched_yield();
+		}
+}
+
+// ======================================================================
+// see spsc.h
+void * spsc_push_slot(spsc_queue_t * queue)
+{
+	const size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	unsigned spins = 0;
+	while (head - atomic_load_explicit(&queue->tail, memory_order_acquire) > queue->mask)
+		spsc_wait(&spins);
+	return queue->slots + (head & queue->mask) * queue->slot_size;
+}
+
+// ======================================================================
+// see spsc.h
+void spsc_push(spsc_queue_t * queue)
+{
+	const size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+}
+
+// ======================================================================
+// see spsc.h
+void spsc_drain(spsc_queue_t * queue)
+{
+	const size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	unsigned spins = 0;
+	while (atomic_load_explicit(&queue->tail, memory_order_acquire) != head)
+		spsc_wait(&spins);
+}
+
+// ======================================================================
+// see spsc.h
+void * spsc_pop_slot(spsc_queue_t * queue)
+{
+	const size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	unsigned spins = 0;
+	while (atomic_load_explicit(&queue->head, memory_order_acquire) == tail)
+		spsc_wait(&spins);
+	return queue->slots + (tail & queue->mask) * queue->slot_size;
+}
+
+// ======================================================================
+// see spsc.h
+void spsc_pop(spsc_queue_t * queue)
+{
+	const size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+// ======================================================================
+// see spsc.h
+void spsc_free(spsc_queue_t * queue)
+{
+	if (queue != NULL)
+		{
+			free(queue->slots);
+			queue->slots = NULL;
+		}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * @file spsc.h
+ * @brief lock-free single-producer single-consumer queue of fixed-size slots
+ *
+ * The producer fills the slot returned by spsc_push_slot() in place, then
+ * publishes it with spsc_push(); the consumer reads the slot returned by
+ * spsc_pop_slot() in place, then frees it with spsc_pop(). Only one thread
+ * may push and only one may pop.
+ *
+ * @date 2019
+ */
+
+#include <stddef.h> // size_t
+#include <stdatomic.h>
+#include <stdalign.h>
+
+#define SPSC_CACHE_LINE 64
+
+/**
+ * @brief A queue. head and tail only grow; their difference is the number
+ * of slots in use. They live on separate host cache lines.
+ */
+typedef struct
+{
+	unsigned char * slots;
+	size_t slot_size;
+	size_t mask; // capacity - 1
+	alignas(SPSC_CACHE_LINE) atomic_size_t head; // next slot to push, written by the producer
+	alignas(SPSC_CACHE_LINE) atomic_size_t tail; // next slot to pop, written by the consumer
+} spsc_queue_t;
+
+//=========================================================================
+/**
+ * @brief Creates an empty queue.
+ * @param queue (modified) the queue
+ * @param capacity number of slots, a power of 2
+ * @param slot_size size of a slot in bytes
+ * @return error code
+ */
+int spsc_init(spsc_queue_t * queue, size_t capacity, size_t slot_size);
+
+//=========================================================================
+/**
+ * @brief Producer side: the next free slot, waiting for one if the queue is full.
+ */
+void * spsc_push_slot(spsc_queue_t * queue);
+
+//=========================================================================
+/**
+ * @brief Producer side: publishes the slot returned by spsc_push_slot().
+ */
+void spsc_push(spsc_queue_t * queue);
+
+//=========================================================================
+/**
+ * @brief Producer side: waits until the consumer has freed every published slot.
+ */
+void spsc_drain(spsc_queue_t * queue);
+
+//=========================================================================
+/**
+ * @brief Consumer side: the oldest published slot, waiting for one if the queue is empty.
+ */
+void * spsc_pop_slot(spsc_queue_t * queue);
+
+//=========================================================================
+/**
+ * @brief Consumer side: frees the slot returned by spsc_pop_slot().
+ */
+void spsc_pop(spsc_queue_t * queue);
+
+//=========================================================================
+/**
+ * @brief Frees the slots of a queue.
+ */
+void spsc_free(spsc_queue_t * queue);
@@ -0,0 +1,32 @@
+#pragma once
+
+/**
+ * @file stack_dist.h
+ * @brief LRU stack distances (Mattson et al., 1970) of a stream of accesses
+ *
+ * For a given number of sets and line size, each set keeps its lines from
+ * the most to the least recently used. The stack distance of an access is
+ * the position of its line in the stack of its set. As an LRU cache of w
+ * ways holds exactly the first w lines of every stack, an access hits in
+ * it if and only if its distance is below w: one pass over a stream gives
+ * the hits of every associativity from 1 to the depth of the stacks.
+ *
+ * @date 2019
+ */
+
+#include <stdint.h>
+
+#define STACK_DIST_MAX_WAYS 256u
+
+/**
+ * @brief Stack distances of one geometry.
+ */
+typedef struct
+{
+	uint16_t lines;     // number of sets, a power of 2
+	uint16_t ways;      // depth of the stacks: associativities 1 to ways are known
+	uint8_t line_bits;  // log_2 of the line size in bytes
+	uint32_t * stacks;  // lines stacks of ways entries, most recent first; owns all the storage
+	uint64_t * distances; // ways + 1 counters: accesses at distance d, then accesses beyond (or first ones)
+	uint64_t accesses;
+} stack_dist_t;
@@ -0,0 +1,129 @@
+/**
+ * @file stack_dist_mng.c
+ * @brief computing and printing LRU stack distances
+ *
+ * @date 2019
+ */
+
+#include "stack_dist_mng.h"
+#include "cache_mng.h" // phy_addr_t_to_uint32_t
+#include "error.h"
+#include "util.h" // zero_init_ptr
+
+#include <stdlib.h> // calloc
+#include <string.h> // memmove
+#include <inttypes.h> // PRIu64
+
+// a line in a stack: its address without the offset, with this bit set
+#define STACK_DIST_VALID 0x80000000u
+
+// --------------------------------------------------
+#define stack_of(SD, LINE_INDEX) \
+        ((SD)->stacks + (size_t) (LINE_INDEX) * (SD)->ways)
+
+// ======================================================================
+// see stack_dist_mng.h
+int stack_dist_init(stack_dist_t * sd, uint16_t lines, uint16_t ways, uint32_t line_bytes)
+{
+	M_REQUIRE_NON_NULL(sd);
+	M_REQUIRE(lines > 0 && (lines & (lines - 1)) == 0, ERR_SIZE, "%u: not a power of 2", lines);
+	M_REQUIRE(ways > 0 && ways <= STACK_DIST_MAX_WAYS, ERR_SIZE, "%u ways", ways);
+	M_REQUIRE(line_bytes > 0 && (line_bytes & (line_bytes - 1)) == 0, ERR_SIZE, "%" PRIu32 ": not a power of 2", line_bytes);
+
+	zero_init_ptr(sd);
+	sd->lines = lines;
+	sd->ways = ways;
+	while ((1u << sd->line_bits) < line_bytes) ++sd->line_bits;
+
+	// stacks then counters
+	const size_t nb_entries = (size_t) lines * ways;
+	sd->stacks = calloc(nb_entries * sizeof(uint32_t) + (ways + 1u) * sizeof(uint64_t), 1);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(sd->stacks, ERR_MEM);
+	sd->distances = (uint64_t *) (sd->stacks + nb_entries + (nb_entries & 1u));
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see stack_dist_mng.h
+void stack_dist_access(stack_dist_t * sd, const phy_addr_t * paddr)
+{
+	const uint32_t line = phy_addr_t_to_uint32_t(paddr) >> sd->line_bits;
+	const uint32_t entry = line | STACK_DIST_VALID;
+	uint32_t * const stack = stack_of(sd, line & (sd->lines - 1u));
+
+	// an empty entry ends the stack: nothing follows it
+	uint16_t d = 0;
+	while (d < sd->ways && stack[d] != entry && stack[d] != 0) ++d;
+
+	if (d < sd->ways && stack[d] == entry)
+		++sd->distances[d];
+	else
+		{
+			++sd->distances[sd->ways];
+			if (d == sd->ways) --d; // the least recent line goes out
+		}
+	memmove(stack + 1, stack, d * sizeof(uint32_t));
+	stack[0] = entry;
+	++sd->accesses;
+}
+
+// ======================================================================
+// see stack_dist_mng.h
+uint64_t stack_dist_hits(const stack_dist_t * sd, uint16_t ways)
+{
+	uint64_t hits = 0;
+	for (uint16_t d = 0; d < ways && d < sd->ways; ++d)
+		hits += sd->distances[d];
+	return hits;
+}
+
+// ======================================================================
+// see stack_dist_mng.h
+int stack_dist_print_header(FILE * output, stats_format_t format)
+{
+	M_REQUIRE_NON_NULL(output);
+	if (format == STATS_CSV)
+		fputs("level,sets,line_bytes,ways,accesses,hits,misses\n", output);
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see stack_dist_mng.h
+int stack_dist_print(FILE * output, stats_format_t format, const char * level, const stack_dist_t * sd)
+{
+	M_REQUIRE_NON_NULL(output);
+	M_REQUIRE_NON_NULL(level);
+	M_REQUIRE_NON_NULL(sd);
+
+	const unsigned line_bytes = 1u << sd->line_bits;
+	if (format == STATS_TEXT)
+		{
+			fprintf(output, "%s, LRU, %u sets of %u bytes:\n", level, sd->lines, line_bytes);
+			fprintf(output, "%-14s %12s %12s %12s %9s\n", "ways", "accesses", "hits", "misses", "hit_rate");
+		}
+
+	uint64_t hits = 0;
+	for (uint16_t w = 1; w <= sd->ways; ++w)
+		{
+			hits += sd->distances[w - 1];
+			const uint64_t misses = sd->accesses - hits;
+			if (format == STATS_TEXT)
+				fprintf(output, "%-14u %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %8.2f%%\n", w, sd->accesses, hits, misses,
+				        sd->accesses > 0 ? 100.0 * (double) hits / (double) sd->accesses : 0.0);
+			else
+				fprintf(output, "%s,%u,%u,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", level, sd->lines, line_bytes, w,
+				        sd->accesses, hits, misses);
+		}
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see stack_dist_mng.h
+void stack_dist_free(stack_dist_t * sd)
+{
+	if (sd != NULL)
+		{
+			free(sd->stacks);
+			zero_init_ptr(sd);
+		}
+}
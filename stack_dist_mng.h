@@ -0,0 +1,69 @@
+#pragma once
+
+/**
+ * @file stack_dist_mng.h
+ * @brief computing and printing LRU stack distances
+ *
+ * @date 2019
+ */
+
+#include "stack_dist.h"
+#include "addr.h"
+#include "stats.h" // stats_format_t
+#include <stdio.h> // FILE
+
+//=========================================================================
+/**
+ * @brief Creates the (empty) stacks of a geometry.
+ * @param sd (modified) the stack distances to initialize
+ * @param lines number of sets, a power of 2
+ * @param ways depth of the stacks, from 1 to STACK_DIST_MAX_WAYS
+ * @param line_bytes size of a line, a power of 2
+ * @return error code (ERR_SIZE for an unsupported geometry)
+ */
+int stack_dist_init(stack_dist_t * sd, uint16_t lines, uint16_t ways, uint32_t line_bytes);
+
+//=========================================================================
+/**
+ * @brief Counts the stack distance of an access, then makes its line the
+ * most recently used of its set.
+ * @param sd the stack distances
+ * @param paddr the accessed address
+ */
+void stack_dist_access(stack_dist_t * sd, const phy_addr_t * paddr);
+
+//=========================================================================
+/**
+ * @brief Number of hits of an LRU cache of the geometry with a given associativity.
+ * @param sd the stack distances
+ * @param ways the associativity, from 1 to sd->ways
+ * @return the number of hits
+ */
+uint64_t stack_dist_hits(const stack_dist_t * sd, uint16_t ways);
+
+//=========================================================================
+/**
+ * @brief Prints the hits and misses of every associativity.
+ * @param output the stream to print to
+ * @param format the output format
+ * @param level the name of the stream (e.g. "L1_ICACHE")
+ * @param sd the stack distances
+ * @return error code
+ */
+int stack_dist_print(FILE * output, stats_format_t format, const char * level, const stack_dist_t * sd);
+
+//=========================================================================
+/**
+ * @brief Prints what comes before the geometries in CSV: the column names.
+ * @param output the stream to print to
+ * @param format the output format; nothing is printed in STATS_TEXT
+ * @return error code
+ */
+int stack_dist_print_header(FILE * output, stats_format_t format);
+
+//=========================================================================
+/**
+ * @brief Frees the stacks.
+ * @param sd the stack distances
+ */
+void stack_dist_free(stack_dist_t * sd);
@@ -0,0 +1,135 @@
+/**
+ * @file stats.c
+ * @brief access counters of one level of a cache or TLB hierarchy
+ *
+ * @date 2019
+ */
+
+#include "stats.h"
+#include "error.h"
+#include "util.h" // zero_init_ptr
+#include <inttypes.h> // PRIu64
+
+static const char * const stat_names[NB_STATS] =
+{
+	[STAT_ACCESSES]     = "accesses",
+	[STAT_HITS]         = "hits",
+	[STAT_MISSES]       = "misses",
+	[STAT_EVICTIONS]    = "evictions",
+	[STAT_VICTIMS]      = "victims",
+	[STAT_PROMOTIONS]   = "promotions",
+	[STAT_WRITE_HITS]   = "write_hits",
+	[STAT_WRITE_MISSES] = "write_misses",
+};
+
+static const char * const access_names[NB_MEM_ACCESS] =
+{
+	[INSTRUCTION] = "instruction",
+	[DATA]        = "data",
+};
+
+// ======================================================================
+// see stats.h
+int stats_reset(level_stats_t * stats)
+{
+	M_REQUIRE_NON_NULL(stats);
+	zero_init_ptr(stats);
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see stats.h
+int stats_add(level_stats_t * total, const level_stats_t * stats)
+{
+	M_REQUIRE_NON_NULL(total);
+	M_REQUIRE_NON_NULL(stats);
+
+	for (int a = 0; a < NB_MEM_ACCESS; ++a)
+		for (int s = 0; s < NB_COUNTERS; ++s)
+			total->count[a][s] += stats->count[a][s];
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see stats.h
+int stats_print_header(FILE * output, stats_format_t format)
+{
+	M_REQUIRE_NON_NULL(output);
+
+	switch (format)
+		{
+		case STATS_TEXT:
+			fprintf(output, "%-14s", "");
+			for (int s = 0; s < NB_STATS; ++s)
+				fprintf(output, " %12s", stat_names[s]);
+			fprintf(output, " %9s\n", "hit_rate");
+			break;
+
+		case STATS_CSV:
+			fputs("level,access", output);
+			for (int s = 0; s < NB_STATS; ++s)
+				fprintf(output, ",%s", stat_names[s]);
+			putc('\n', output);
+			break;
+
+		default:
+			M_EXIT(ERR_BAD_PARAMETER, "%d: unknown format", format);
+		}
+	return ERR_NONE;
+}
+
+// ======================================================================
+static void print_text_line(FILE * output, const char * name, const uint64_t * count)
+{
+	fprintf(output, "  %-12s", name);
+	for (int s = 0; s < NB_STATS; ++s)
+		fprintf(output, " %12" PRIu64, count[s]);
+	const double hit_rate = count[STAT_ACCESSES] == 0 ? 0.0
+	                        : 100.0 * (double) count[STAT_HITS] / (double) count[STAT_ACCESSES];
+	fprintf(output, " %8.2f%%\n", hit_rate);
+}
+
+// ======================================================================
+// see stats.h
+int stats_print(FILE * output, stats_format_t format, const char * level, const level_stats_t * stats)
+{
+	M_REQUIRE_NON_NULL(output);
+	M_REQUIRE_NON_NULL(level);
+	M_REQUIRE_NON_NULL(stats);
+
+	switch (format)
+		{
+		case STATS_TEXT:
+			{
+				// only the kinds of access the level has seen, and their total if both
+				uint64_t total[NB_STATS] = { 0 };
+				int kinds = 0;
+				fprintf(output, "%s\n", level);
+				for (int a = 0; a < NB_MEM_ACCESS; ++a)
+					{
+						if (stats->count[a][STAT_ACCESSES] == 0) continue;
+						print_text_line(output, access_names[a], stats->count[a]);
+						for (int s = 0; s < NB_STATS; ++s)
+							total[s] += stats->count[a][s];
+						++kinds;
+					}
+				if (kinds != 1)
+					print_text_line(output, "total", total);
+			}
+			break;
+
+		case STATS_CSV:
+			for (int a = 0; a < NB_MEM_ACCESS; ++a)
+				{
+					fprintf(output, "%s,%s", level, access_names[a]);
+					for (int s = 0; s < NB_STATS; ++s)
+						fprintf(output, ",%" PRIu64, stats->count[a][s]);
+					putc('\n', output);
+				}
+			break;
+
+		default:
+			M_EXIT(ERR_BAD_PARAMETER, "%d: unknown format", format);
+		}
+	return ERR_NONE;
+}
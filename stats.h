@@ -0,0 +1,108 @@
+#pragma once
+
+/**
+ * @file stats.h
+ * @brief access counters of one level of a cache or TLB hierarchy
+ *
+ * Counters are split by kind of access (instruction fetch or data access)
+ * and incremented in place with stats_inc(), so that counting costs one
+ * add on the access path.
+ *
+ * @date 2019
+ */
+
+#include "mem_access.h"
+#include <stdint.h>
+#include <stdio.h> // FILE
+
+/**
+ * @brief What is counted.
+ * Each miss counter follows its hit counter, so that the outcome of an
+ * access can index the counter (see cache_mng.c).
+ */
+typedef enum
+{
+	STAT_ACCESSES,
+	STAT_HITS,
+	STAT_MISSES,
+	STAT_EVICTIONS,    // valid entries replaced by another one
+	STAT_VICTIMS,      // L1 victims sent to L2 (counted in L1)
+	STAT_PROMOTIONS,   // entries sent from L2 to L1 on an L2 hit (counted in L2)
+	STAT_WRITE_HITS,
+	STAT_WRITE_MISSES,
+	NB_STATS,          // not a counter, the number of counters printed by stats_print()
+	/*
+	 * Counters only some configurations use, printed by their owner.
+	 */
+	STAT_WRITEBACKS = NB_STATS, // dirty lines sent to the next level (write-back caches)
+	STAT_BACK_INVALIDATIONS,    // lines of the inner caches invalidated on an eviction (inclusive caches)
+	STAT_PREFETCHES,            // lines brought in by the prefetcher (see cache_prefetch.h)
+	STAT_PREFETCH_USEFUL,       // prefetched lines hit by a demand access
+	STAT_PREFETCH_LATE,         // demand misses on lines waiting to be prefetched
+	STAT_PREFETCH_POLLUTING,    // demand misses on lines evicted by a prefetch
+	NB_COUNTERS        // not a counter, the number of counters
+} stat_t;
+
+#define NB_MEM_ACCESS (DATA + 1)
+
+/**
+ * @brief The counters of one level, by kind of access (mem_access_t).
+ */
+typedef struct
+{
+	uint64_t count[NB_MEM_ACCESS][NB_COUNTERS];
+} level_stats_t;
+
+/**
+ * @brief Output formats of stats_print().
+ */
+typedef enum
+{
+	STATS_TEXT, // for humans: a table, one row per kind of access seen
+	STATS_CSV   // one line per level and kind of access, see stats_print_header()
+} stats_format_t;
+
+// --------------------------------------------------
+#define stats_inc(STATS, ACCESS, STAT) \
+        (++(STATS)->count[ACCESS][STAT])
+
+// --------------------------------------------------
+#define stats_get(STATS, ACCESS, STAT) \
+        ((STATS)->count[ACCESS][STAT])
+
+//=========================================================================
+/**
+ * @brief Sets all the counters of a level to 0.
+ * @param stats the counters
+ * @return error code
+ */
+int stats_reset(level_stats_t * stats);
+
+//=========================================================================
+/**
+ * @brief Adds the counters of a level to those of another one.
+ * @param total (modified) the counters to add to
+ * @param stats the counters to add
+ * @return error code
+ */
+int stats_add(level_stats_t * total, const level_stats_t * stats);
+
+//=========================================================================
+/**
+ * @brief Prints what comes before the levels: the column names.
+ * @param output the stream to print to
+ * @param format the output format
+ * @return error code
+ */
+int stats_print_header(FILE * output, stats_format_t format);
+
+//=========================================================================
+/**
+ * @brief Prints the counters of one level.
+ * @param output the stream to print to
+ * @param format the output format
+ * @param level the name of the level (e.g. "L1_ICACHE")
+ * @param stats the counters of the level
+ * @return error code
+ */
+int stats_print(FILE * output, stats_format_t format, const char * level, const level_stats_t * stats);
@@ -40,15 +40,15 @@ static void error(const char* pgm, const char* msg)
 // ======================================================================
 void execute_command(void *mem_space,
                      const command_t* command,
-                     l1_icache_entry_t *l1_icache,
-                     l1_icache_entry_t *l1_dcache,
-                     l2_cache_entry_t *l2_cache)
+                     cache_level_t *l1_icache,
+                     cache_level_t *l1_dcache,
+                     cache_level_t *l2_cache)
 {
     phy_addr_t paddr;
     assert(page_walk(mem_space, &command->vaddr, &paddr) == ERR_NONE);
     uint8_t byte;
     uint32_t word;
-    void *l1_cache;
+    cache_level_t *l1_cache;
 
     switch (command->order)
         {
@@ -56,18 +56,21 @@ void execute_command(void *mem_space,
             l1_cache = (command->type == INSTRUCTION) ? l1_icache : l1_dcache;
             if (command->data_size == 4)
                 cache_read(mem_space, &paddr, command->type, l1_cache,
-                           l2_cache, &word, LRU);
+                           l2_cache, &word);
             else
                 cache_read_byte(mem_space, &paddr, command->type, l1_cache,
-                                l2_cache, &byte, LRU);
+                                l2_cache, &byte);
             break;
         case WRITE:
             if (command->data_size == 4)
                 cache_write(mem_space, &paddr, l1_dcache,
-                            l2_cache, &command->write_data, LRU);
+                            l2_cache, &command->write_data);
             else
-                cache_write_byte(mem_space, &paddr, l1_dcache,
-                                 l2_cache, (uint8_t)command->write_data, LRU);
+                {
+                    byte = (uint8_t)command->write_data;
+                    cache_write_byte(mem_space, &paddr, l1_dcache,
+                                     l2_cache, &byte);
+                }
             break;
         default:
             assert(0);
@@ -107,30 +110,32 @@ int main(int argc, char *argv[])
         {
             if (program_read(argv[3], &pgm) == ERR_NONE)
                 {
-                    l1_icache_entry_t l1_icache[L1_ICACHE_LINES * L1_ICACHE_WAYS];
-                    l1_icache_entry_t l1_dcache[L1_DCACHE_LINES * L1_DCACHE_WAYS];
-                    l2_cache_entry_t l2_cache[L2_CACHE_LINES * L2_CACHE_WAYS];
-                    memset(l1_icache, 0, sizeof(l1_icache));
-                    memset(l1_dcache, 0, sizeof(l1_dcache));
-                    memset(l2_cache,  0, sizeof(l2_cache));
+                    cache_level_t l1_icache, l1_dcache, l2_cache;
+                    assert(cache_init(&l1_icache, L1_ICACHE, &L1_ICACHE_CONFIG) == ERR_NONE);
+                    assert(cache_init(&l1_dcache, L1_DCACHE, &L1_DCACHE_CONFIG) == ERR_NONE);
+                    assert(cache_init(&l2_cache, L2_CACHE, &L2_CACHE_CONFIG) == ERR_NONE);
 
                     /* Flush caches before use */
-                    assert(cache_flush(l1_icache, L1_ICACHE) == ERR_NONE);
-                    assert(cache_flush(l1_dcache, L1_DCACHE) == ERR_NONE);
-                    assert(cache_flush(l2_cache, L2_CACHE) == ERR_NONE);
+                    assert(cache_flush(&l1_icache) == ERR_NONE);
+                    assert(cache_flush(&l1_dcache) == ERR_NONE);
+                    assert(cache_flush(&l2_cache) == ERR_NONE);
 
                     for_all_lines(line, &pgm)
                     {
-                        execute_command(mem_space, line, l1_icache, l1_dcache, l2_cache);
+                        execute_command(mem_space, line, &l1_icache, &l1_dcache, &l2_cache);
 
                         printf("L1_ICACHE: \n\n");
-                        cache_dump(stdout, l1_icache, L1_ICACHE);
+                        cache_dump(stdout, &l1_icache);
                         printf("L1_DCACHE: \n\n");
-                        cache_dump(stdout, l1_dcache, L1_DCACHE);
+                        cache_dump(stdout, &l1_dcache);
                         printf("L2_CACHE: \n\n");
-                        cache_dump(stdout, l2_cache, L2_CACHE);
+                        cache_dump(stdout, &l2_cache);
                         printf("\n=======================================\n\n");
                     }
+
+                    cache_free(&l1_icache);
+                    cache_free(&l1_dcache);
+                    cache_free(&l2_cache);
                 }
             else
                 {
@@ -145,6 +150,6 @@ int main(int argc, char *argv[])
         }
 
     (void)program_free(&pgm);
-    free(mem_space);
+    mem_free(mem_space, mem_size);
     return 0;
 }
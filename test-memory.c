@@ -84,7 +84,7 @@ int main(int argc, char *argv[]) {
             const int error = init_virt_addr64(&vaddr, vaddr64);
             if (error != ERR_NONE) {
                 puts("Mauvaise adresse ==> Abandon");
-                free(mem_space);
+                mem_free(mem_space, mem_size);
                 return 2; }
 
             vmem_page_dump_with_options(mem_space, &vaddr, t_fmt, 16, argv[4]);
@@ -96,5 +96,5 @@ int main(int argc, char *argv[]) {
         error(argv[0], "problem initializing memory from provided file.");
         return 3; }
 
-    free(mem_space);
+    mem_free(mem_space, mem_size);
     return 0; }
@@ -22,20 +22,19 @@
 #include <inttypes.h> // for PRIx macros
 
 // --------------------------------------------------
-#define print_all_tlb_entries(tlb, TYPE, N)                                      \
+#define print_all_tlb_entries(tlb)                                               \
     do {                                                                         \
         fputc('\n', f_out); fputc('\n', f_out);                                  \
-        for (int tlb_line_index = 0; tlb_line_index < (N); tlb_line_index++) {   \
-            if(((TYPE *) (tlb) + tlb_line_index)->v)                             \
-                fprintf(f_out, "%d; %08X; %05X;\n" ,                             \
-                        ((TYPE *) (tlb) + tlb_line_index)->v,                    \
-                        ((TYPE *) (tlb) + tlb_line_index)->tag,                  \
-                        ((TYPE *) (tlb) + tlb_line_index)->phy_page_num          \
+        for (uint16_t tlb_line_index = 0; tlb_line_index < (tlb)->config.lines; tlb_line_index++) \
+        for (uint8_t tlb_way = 0; tlb_way < (tlb)->config.ways; tlb_way++) {     \
+            if(tlb_valid(tlb, tlb_line_index, tlb_way))                          \
+                fprintf(f_out, "%d; %08" PRIX64 "; %05" PRIX32 ";\n" ,           \
+                        1,                                                       \
+                        tlb_tag(tlb, tlb_line_index, tlb_way),                   \
+                        tlb_phy_page_num(tlb, tlb_line_index, tlb_way)           \
                 );                                                               \
             else                                                                 \
-                fprintf(f_out, "%d; --------; -----;\n" ,                        \
-                        ((TYPE *) (tlb) + tlb_line_index)->v                     \
-                );                                                               \
+                fprintf(f_out, "%d; --------; -----;\n" , 0);                    \
         }} while(0)
 
 // ======================================================================
@@ -70,20 +69,20 @@ int main(int argc, char* argv[]) {
         return 4; }
 
     /**
-     * Statically allocate space for the L1-ITLB, L1-DTLB, and L2-TLB
+     * Allocate the L1-ITLB, L1-DTLB, and L2-TLB
      *
-     * Specs:
+     * Specs (default configuration):
      *  -- Direct mapped
      *  -- 16 lines for L1, 64 lines for L2
      */
 
-    l1_itlb_entry_t l1_itlb[L1_ITLB_LINES];
-    l1_dtlb_entry_t l1_dtlb[L1_DTLB_LINES];
-    l2_tlb_entry_t l2_tlb[L2_TLB_LINES];
-
-    tlb_flush((void *)l1_itlb, L1_ITLB);
-    tlb_flush((void *)l1_dtlb, L1_DTLB);
-    tlb_flush((void *)l2_tlb, L2_TLB);
+    const tlb_hrchy_config_t config = TLB_HRCHY_DEFAULT_CONFIG;
+    tlb_hrchy_t tlbs;
+    if (tlb_hrchy_init(&tlbs, &config) != ERR_NONE) {
+        fclose(f_out);
+        mem_free(mem_space, mem_size);
+        fputs("Cannot create the TLBs.\n", stderr);
+        return 5; }
 
     phy_addr_t paddr;
     zero_init_var(paddr);
@@ -92,7 +91,7 @@ int main(int argc, char* argv[]) {
 
         int hit = 0;
         fprintf(f_out, "\n" SIZE_T_FMT ": DATA/INSTRUCTION = %d\n", prog_line_index, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION);
-        tlb_search(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION, l1_itlb, l1_dtlb, l2_tlb, &hit);
+        tlb_search(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION, &tlbs, &hit, NULL, NULL);
 
         fprintf(f_out, "-------------------------------------------------------------------\n");
         fprintf(f_out, "After program line " SIZE_T_FMT "...\n\n", prog_line_index);
@@ -107,11 +106,11 @@ int main(int argc, char* argv[]) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wconversion"
         fprintf(f_out, "\n\nL1_ITLB:");
-        print_all_tlb_entries(l1_itlb, l1_itlb_entry_t, L1_ITLB_LINES);
+        print_all_tlb_entries(&tlbs.l1_itlb);
         fprintf(f_out, "\n\nL1_DTLB:");
-        print_all_tlb_entries(l1_dtlb, l1_dtlb_entry_t, L1_DTLB_LINES);
+        print_all_tlb_entries(&tlbs.l1_dtlb);
         fprintf(f_out, "\n\nL2_TLB:");
-        print_all_tlb_entries(l2_tlb, l2_tlb_entry_t, L2_TLB_LINES);
+        print_all_tlb_entries(&tlbs.l2_tlb);
 #pragma GCC diagnostic pop
 
         fprintf(f_out, "-------------------------------------------------------------------\n"); }
@@ -120,7 +119,8 @@ int main(int argc, char* argv[]) {
      * Garbage collecting
      */
     fclose(f_out);
-    free(mem_space);
+    tlb_hrchy_free(&tlbs);
+    mem_free(mem_space, mem_size);
 
     return EXIT_SUCCESS; }
 
@@ -22,6 +22,13 @@
 
 #include <inttypes.h> // for PRIx macros
 
+// copies the LRU order of the lines, from the least recently used, to a list to print
+static void lru_to_list(const replacement_policy_t * replacement_policy, list_t * ll) {
+    clear_list(ll);
+    for (uint8_t link = replacement_policy->lru; link != 0; link = replacement_policy->next[link - 1]) {
+        const list_content_t line_index = (list_content_t) (link - 1);
+        (void)push_back(ll, &line_index); } }
+
 int main(int argc, char* argv[]) {
     if (argc < 4) {
         fprintf(stderr, "please provide 3 filenames:\n");
@@ -52,22 +59,13 @@ int main(int argc, char* argv[]) {
     tlb_entry_t tlb[TLB_LINES];
     tlb_flush(tlb);
 
-    // fill in the linked-list with all tlb line indices
+    // all lines in order, line 0 being the least recently used
+    replacement_policy_t replacement_policy;
+    replacement_policy_init(&replacement_policy);
+
+    // only to print the LRU order
     list_t ll;
     init_list(&ll);
-    for (list_content_t line_index = 0; line_index < TLB_LINES; line_index++) {
-        (void)push_back(&ll, &line_index); 
-        }
-        
-
-    /*
-    * Create the object replacement policy.
-    *
-    */
-    replacement_policy_t replacement_policy = {
-        .ll             = &ll,
-        .move_back      = move_back,
-        .push_back      = push_back };
 
     phy_addr_t paddr;
     zero_init_var(paddr);
@@ -93,6 +91,7 @@ int main(int argc, char* argv[]) {
                         (uint64_t) tlb[tlb_line_index].tag,
                         tlb[tlb_line_index].phy_page_num
                        ); }
+            lru_to_list(&replacement_policy, &ll);
             print_list(f_out, &ll); }
         else {
             fprintf(f_out, "error with tlb_search(): %s\n", ERR_MESSAGES[err - ERR_NONE]); }
@@ -103,7 +102,7 @@ int main(int argc, char* argv[]) {
      */
     fclose(f_out);
     clear_list(&ll);
-    free(mem_space);
+    mem_free(mem_space, mem_size);
 
     return EXIT_SUCCESS; }
 
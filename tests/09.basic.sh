@@ -38,5 +38,8 @@ check_output_with_file() {
 printf "Test %1d (test-tlb_hrchy 1): " $((++test))
 check_output_with_file test-tlb_hrchy commands02.txt memory-dump-01.mem output/tlb-hrchy-01-out.txt
 
+printf "Test %1d (test-tlb_simple 1): " $((++test))
+check_output_with_file test-tlb_simple commands02.txt memory-dump-01.mem output/tlb-simple-01-out.txt
+
 # ======================================================================
 echo "SUCCESS"
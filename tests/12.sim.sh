@@ -0,0 +1,114 @@
+#!/bin/bash
+
+## Simulator: TLB hierarchy then cache hierarchy, statistics at the end
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_output_with_file() {
+
+    checkX "Simulator" "$1"
+
+    ref='tests/files'
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$4"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    refoutput="${ref}/$5"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stderr in case of error
+    ACTUAL_OUTPUT="$("$1" $2 "$memfile" "$cmdfile" 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ----------------------------------------------------------------------
+# the simulation must fail (e.g. on a malformed page table)
+check_rejected() {
+
+    checkX "Simulator" "$1"
+
+    ref='tests/files'
+    if "$1" $2 "${ref}/$3" "${ref}/$4" >/dev/null 2>&1; then
+        echo "FAIL"
+        exit 1
+    fi
+    echo "PASS"
+}
+
+# ======================================================================
+printf "Test %1d (cache-sim 1): " $((++test))
+check_output_with_file cache-sim dump memory-dump-01.mem commands01.txt output/sim-01-out.txt
+
+printf "Test %1d (cache-sim 2): " $((++test))
+check_output_with_file cache-sim "--csv dump" memory-dump-01.mem commands02.txt output/sim-02-out.csv
+
+printf "Test %1d (cache-sim 3, 4 threads): " $((++test))
+check_output_with_file cache-sim "--threads 4 dump" memory-dump-01.mem commands01.txt output/sim-01-out.txt
+
+printf "Test %1d (cache-sim 4, stack distances): " $((++test))
+check_output_with_file cache-sim "--csv --stack-dist 4 dump" memory-dump-01.mem commands02.txt output/sim-03-out.csv
+
+printf "Test %1d (cache-sim 5, set-associative TLBs): " $((++test))
+check_output_with_file cache-sim "--itlb 16x8 --dtlb 16x4 --l2-tlb 128x12 dump" memory-dump-01.mem commands02.txt output/sim-04-out.txt
+
+printf "Test %1d (cache-sim 6, paging-structure caches): " $((++test))
+check_output_with_file cache-sim "--kaby-lake-tlbs dump" memory-dump-01.mem commands02.txt output/sim-05-out.txt
+
+printf "Test %1d (cache-sim 7, context switches flush the TLBs): " $((++test))
+check_output_with_file cache-sim "--itlb 16x8 --dtlb 16x4 --l2-tlb 128x12 dump" memory-dump-01.mem commands03.txt output/sim-06-out.txt
+
+printf "Test %1d (cache-sim 8, PCID-tagged TLBs): " $((++test))
+check_output_with_file cache-sim "--pcid --itlb 16x8 --dtlb 16x4 --l2-tlb 128x12 dump" memory-dump-01.mem commands03.txt output/sim-07-out.txt
+
+printf "Test %1d (cache-sim 9, mapped memory dump): " $((++test))
+check_output_with_file cache-sim "--mmap-tables dump" memory-dump-01.mem commands01.txt output/sim-01-out.txt
+
+printf "Test %1d (cache-sim 10, memory from its description): " $((++test))
+check_output_with_file cache-sim desc memory-desc-01.txt commands01.txt output/sim-01-out.txt
+
+printf "Test %1d (cache-sim 11, write-back caches): " $((++test))
+check_output_with_file cache-sim "--write-back dump" memory-dump-01.mem commands01.txt output/sim-08-out.txt
+
+printf "Test %1d (cache-sim 12, inclusive L2): " $((++test))
+check_output_with_file cache-sim "--inclusion inclusive --write-back dump" memory-dump-01.mem commands01.txt output/sim-09-out.txt
+
+printf "Test %1d (cache-sim 13, sliced L3): " $((++test))
+check_output_with_file cache-sim "--l3 1024x16 --l3-slices 4 --write-back dump" memory-dump-01.mem commands01.txt output/sim-10-out.txt
+
+printf "Test %1d (cache-sim 14, prefetchers): " $((++test))
+check_output_with_file cache-sim "--l1d-prefetch stride --l2-prefetch streamer:2:4 dump" memory-dump-01.mem commands04.txt output/sim-11-out.txt
+
+printf "Test %1d (cache-sim 15, latency model): " $((++test))
+check_output_with_file cache-sim "--kaby-lake-tlbs --l3 1024x16 --latency --latency-of memory=200 dump" memory-dump-01.mem commands03.txt output/sim-12-out.txt
+
+printf "Test %1d (cache-sim 16, prefetches are not promotions): " $((++test))
+check_output_with_file cache-sim "--l1d-prefetch stride:2:1 dump" memory-dump-01.mem commands05.txt output/sim-13-out.txt
+
+printf "Test %1d (cache-sim 17, 2 MiB and 1 GiB pages): " $((++test))
+check_output_with_file cache-sim desc memory-desc-03.txt commands06.txt output/sim-14-out.txt
+
+printf "Test %1d (cache-sim 18, huge pages in the TLBs of Kaby Lake): " $((++test))
+check_output_with_file cache-sim "--kaby-lake-tlbs desc" memory-desc-03.txt commands06.txt output/sim-15-out.txt
+
+printf "Test %1d (cache-sim 19, huge page not aligned on its size): " $((++test))
+check_rejected cache-sim desc memory-desc-03.txt commands07.txt
+
+printf "Test %1d (cache-sim 20, write to a page table): " $((++test))
+check_output_with_file cache-sim desc memory-desc-03.txt commands08.txt output/sim-16-out.txt
+
+printf "Test %1d (cache-sim 21, write to a page table, 2 threads): " $((++test))
+check_output_with_file cache-sim "--threads 2 desc" memory-desc-03.txt commands08.txt output/sim-16-out.txt
+
+# ======================================================================
+echo "SUCCESS"
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+## Binary traces: converted from text, simulated as the text programs
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_trace_with_file() {
+
+    checkX "Trace converter" trace-convert
+    checkX "Simulator" cache-sim
+
+    ref='tests/files'
+    memfile="${ref}/$2"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$3"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    refoutput="${ref}/$4"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    tracefile="$(new_tmp_file)"
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stderr in case of error
+    ACTUAL_OUTPUT="$(trace-convert "$cmdfile" "$tracefile" 2>"$mytmp" \
+                     && cache-sim $1 "$memfile" "$tracefile" 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ----------------------------------------------------------------------
+# a trace whose first record is patched to flags $3 must be rejected,
+# as the text parser rejects the same command
+check_trace_rejected() {
+
+    checkX "Trace converter" trace-convert
+    checkX "Simulator" cache-sim
+
+    ref='tests/files'
+    tracefile="$(new_tmp_file)"
+    trace-convert "${ref}/$2" "$tracefile" 2>/dev/null || error "cannot convert \"${ref}/$2\"."
+    # the flags of the first record, just after the 16 bytes of the header
+    printf "\\x$3" | dd of="$tracefile" bs=1 seek=16 conv=notrunc 2>/dev/null
+
+    if cache-sim dump "${ref}/$1" "$tracefile" >/dev/null 2>&1; then
+        echo "FAIL"
+        exit 1
+    fi
+    echo "PASS"
+}
+
+# ======================================================================
+printf "Test %1d (trace 1): " $((++test))
+check_trace_with_file dump memory-dump-01.mem commands01.txt output/sim-01-out.txt
+
+printf "Test %1d (trace 2): " $((++test))
+check_trace_with_file "--csv dump" memory-dump-01.mem commands02.txt output/sim-02-out.csv
+
+printf "Test %1d (trace 3, context switches): " $((++test))
+check_trace_with_file "--pcid --itlb 16x8 --dtlb 16x4 --l2-tlb 128x12 dump" memory-dump-01.mem commands03.txt output/sim-07-out.txt
+
+printf "Test %1d (trace 4, write of an instruction): " $((++test))
+check_trace_rejected memory-dump-01.mem commands01.txt 01
+
+printf "Test %1d (trace 5, data read of 0 bytes): " $((++test))
+check_trace_rejected memory-dump-01.mem commands01.txt 02
+
+# ======================================================================
+echo "SUCCESS"
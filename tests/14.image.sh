@@ -0,0 +1,46 @@
+#!/bin/bash
+
+## Packed memory images: converted from dumps and descriptions, simulated as them
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function
+check_image_with_file() {
+
+    checkX "Image converter" image-convert
+    checkX "Simulator" cache-sim
+
+    ref='tests/files'
+    memfile="${ref}/$2"
+    [ -f "$memfile" ] || error "Expected memory file \"$memfile\" not found."
+
+    cmdfile="${ref}/$3"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    refoutput="${ref}/$4"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    imagefile="$(new_tmp_file)"
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stderr in case of error
+    ACTUAL_OUTPUT="$(image-convert $1 "$memfile" "$imagefile" 2>"$mytmp" \
+                     && cache-sim image "$imagefile" "$cmdfile" 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# ======================================================================
+printf "Test %1d (image 1, from a dump): " $((++test))
+check_image_with_file dump memory-dump-01.mem commands01.txt output/sim-01-out.txt
+
+printf "Test %1d (image 2, from a description): " $((++test))
+check_image_with_file desc memory-desc-01.txt commands01.txt output/sim-01-out.txt
+
+# ======================================================================
+echo "SUCCESS"
@@ -14,9 +14,28 @@
 
 #define TLB_LINES 128 // the number of entries
 
+#define TLB_HASH_BITS 8 // log_2 of the number of hash buckets, 2 per line
+#define TLB_HASH_SIZE (1u << TLB_HASH_BITS)
+
 typedef struct 
 {
 	uint64_t tag : VIRT_PAGE_NUM;
 	uint32_t phy_page_num : PHY_PAGE_NUM;
 	uint8_t v: 1;
 }tlb_entry_t;
+
+/**
+ * @brief Index of the valid lines of a TLB by virtual page number, so that
+ * a lookup costs a hash instead of a scan of the TLB.
+ *
+ * Each bucket chains its lines through next[]; the links are line indexes
+ * plus one, 0 ending a chain, so that an index filled with zeros is empty.
+ * A line found in the index still has its tag checked in the TLB, which
+ * keeps lookups right after a tlb_flush().
+ */
+typedef struct
+{
+	uint16_t buckets[TLB_HASH_SIZE];    // first line of each chain
+	uint16_t next[TLB_LINES];           // next line in the chain of each line
+	uint16_t bucket_of[TLB_LINES];      // the bucket chaining each line, plus one
+} tlb_index_t;
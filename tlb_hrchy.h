@@ -9,59 +9,206 @@
  */
 
 #include "addr.h"
+#include "cache.h" // cache_replace_t
+#include "stats.h"
+#include "walk_cache.h"
 
 #include <stdint.h>
 
+/*
+ * Default geometry of each TLB: direct-mapped; the actual geometry of a
+ * TLB is given at run time by a tlb_config_t (see tlb_init()).
+ */
 #define L1_ITLB_WAYS    1   // Direct mapped
-// Do not modify the number of lines.
-// It directly affects the tag field size.
 #define L1_ITLB_LINES   16
 #define L1_ITLB_LINES_BITS 4  // log_2(L1_ITLB_LINES)
 
 #define L1_DTLB_WAYS    L1_ITLB_WAYS
-// Do not modify the number of lines.
-// It directly affects the tag field size.
 #define L1_DTLB_LINES   L1_ITLB_LINES
 #define L1_DTLB_LINES_BITS L1_ITLB_LINES_BITS // log_2(L1_DTLB_LINES)
 
 #define L2_TLB_WAYS     1   // Direct mapped
-#define L2_TLB_LINES    64  // 64, Do not modify this!
+#define L2_TLB_LINES    64
 #define L2_TLB_LINES_BITS 6  // log_2(L2_TLB_LINES)
 
+/*
+ * Bounds on run-time geometries.
+ */
+#define TLB_MAX_WAYS    16u
+#define TLB_MAX_LINES   4096u
+
 /**
- * L1 ITLB, L1 DTLB, and L2 TLB are all direct-mapped.
+ * L1 ITLB, L1 DTLB and L2 TLB are set-associative (direct-mapped by
+ * default), each with its own replacement policy among LRU, FIFO and
+ * RANDOM (see cache.h).
+ *
+ * The hierarchy is inclusive: an entry evicted from L2 is invalidated in
+ * both L1 TLBs.
+ *
+ * Each level has a main TLB and up to TLB_LARGE_ARRAYS more for huge pages
+ * (see tlb_hrchy_config_t); a TLB holds the pages of the sizes of its
+ * config.page_sizes, all of them in one array when it holds several, as
+ * the Kaby Lake STLB does with 4 kiB and 2 MiB pages.
  */
-/* TODO WEEK 09:
- * Définir ici les types :
- *    - l1_itlb_entry_t;
- *    - l1_dtlb_entry_t;
- *    - l2_tlb_entry_t;
- *    - et tlb_t;
- * (et supprimer ces huit lignes de commentaire).
+typedef enum {
+    L1_ITLB, L1_DTLB, L2_TLB, NB_TLBS } tlb_t;
+
+// masks of page sizes (see page_size_t in addr.h)
+#define TLB_PAGES(SIZE)  ((uint8_t) (1u << (SIZE)))
+#define TLB_ALL_PAGES    ((uint8_t) (TLB_PAGES(NB_PAGE_SIZES) - 1u))
+
+/**
+ * @brief Run-time geometry and replacement policy of one TLB.
+ * lines must be a power of 2.
  */
 typedef struct {
+    uint16_t lines;     // number of sets
+    uint8_t ways;       // associativity, at most TLB_MAX_WAYS
+    cache_replace_t replace; // LRU, FIFO or RANDOM
+    uint8_t page_sizes; // mask of TLB_PAGES() of the pages it holds
+} tlb_config_t;
 
-    uint32_t tag: 32;
-uint32_t phy_page_num: PHY_PAGE_NUM;
-    uint8_t v: 1;
+#define L1_ITLB_CONFIG ((tlb_config_t) { L1_ITLB_LINES, L1_ITLB_WAYS, LRU, TLB_ALL_PAGES })
+#define L1_DTLB_CONFIG ((tlb_config_t) { L1_DTLB_LINES, L1_DTLB_WAYS, LRU, TLB_ALL_PAGES })
+#define L2_TLB_CONFIG  ((tlb_config_t) { L2_TLB_LINES,  L2_TLB_WAYS,  LRU, TLB_ALL_PAGES })
 
-} l1_itlb_entry_t;
+// at most one array per page size and level
+#define TLB_LARGE_ARRAYS (NB_PAGE_SIZES - 1u)
+
+/**
+ * @brief Run-time configuration of the hierarchy.
+ *
+ * The main TLBs are looked up first, then the large-page ones of the same
+ * level; a large-page TLB with 0 lines does not exist. A page of a size no
+ * TLB of a level holds is cached there as the 4 kiB page of the access,
+ * if the main TLB holds 4 kiB pages ("splintered"); when the page leaves
+ * L2, all its splinters leave the L1 TLB.
+ *
+ * The page walks of L2 misses go through the paging-structure caches of
+ * walk, none by default (see walk_cache.h).
+ *
+ * Entries are tagged with the PCID of their address space (see CR3 in
+ * addr.h). With pcids, a context switch keeps the entries of the other
+ * address spaces, as a switch to a PCID without flush does on x86-64;
+ * without, it flushes all the TLBs and paging-structure caches.
+ */
+typedef struct {
+    tlb_config_t l1_itlb;
+    tlb_config_t l1_dtlb;
+    tlb_config_t l2_tlb;
+    tlb_config_t large[NB_TLBS][TLB_LARGE_ARRAYS]; // indexed by tlb_t
+    walk_cache_config_t walk[NB_WALK_CACHES];      // indexed by walk_cache_type_t
+    uint8_t pcids;  // 1: context switches keep the entries, 0: they flush them
+} tlb_hrchy_config_t;
+
+// direct-mapped TLBs holding pages of any size
+#define TLB_HRCHY_DEFAULT_CONFIG ((tlb_hrchy_config_t) { \
+        L1_ITLB_CONFIG, L1_DTLB_CONFIG, L2_TLB_CONFIG, { { { 0 } } }, { { 0 } }, 0 })
+
+/*
+ * Kaby Lake: ITLB of 128 4 kiB entries (8-way) and 8 2 MiB ones (fully
+ * associative); DTLB of 64 4 kiB entries (4-way), 32 2 MiB ones (4-way)
+ * and 4 1 GiB ones (fully associative); STLB of 1536 entries (12-way)
+ * shared by 4 kiB and 2 MiB pages and of 16 1 GiB entries (4-way); and
+ * its paging-structure caches.
+ */
+#define TLB_HRCHY_KABY_LAKE_CONFIG ((tlb_hrchy_config_t) { \
+        { 16, 8, LRU, TLB_PAGES(PAGE_4K) }, \
+        { 16, 4, LRU, TLB_PAGES(PAGE_4K) }, \
+        { 128, 12, LRU, TLB_PAGES(PAGE_4K) | TLB_PAGES(PAGE_2M) }, { \
+            { { 1, 8, LRU, TLB_PAGES(PAGE_2M) }, { 0 } }, \
+            { { 8, 4, LRU, TLB_PAGES(PAGE_2M) }, { 1, 4, LRU, TLB_PAGES(PAGE_1G) } }, \
+            { { 4, 4, LRU, TLB_PAGES(PAGE_1G) }, { 0 } } }, \
+        WALK_CACHE_KABY_LAKE_CONFIG, 1 })
+
+/*
+ * In the tag store, a valid entry holds its tag (the virtual page number
+ * of its page size without its index bits), its PCID from bit
+ * TLB_TAG_PCID_SHIFT on and its page size from bit TLB_TAG_SIZE_SHIFT on,
+ * with TLB_TAG_VALID set; an invalid one holds 0: one compare checks
+ * validity, size, address space and tag at once.
+ */
+#define TLB_TAG_VALID (UINT64_C(1) << 63)
+#define TLB_TAG_SIZE_SHIFT 61
+#define TLB_TAG_PCID_SHIFT 48
+#define TLB_TAG_MASK  ((UINT64_C(1) << TLB_TAG_PCID_SHIFT) - 1u)
 
+/**
+ * @brief What a TLB entry translates: a page of an address space.
+ */
 typedef struct {
+    uint64_t virt_page_num; // of its first 4 kiB page
+    page_size_t size;
+    uint16_t pcid;
+} tlb_page_t;
 
-    uint32_t tag: 32;
-uint32_t phy_page_num: PHY_PAGE_NUM;
-    uint8_t v: 1;
+// each row of tags is padded to a multiple of this number of ways (see tlb_hit())
+#define TLB_TAG_GROUP 4u
 
-} l1_dtlb_entry_t;
+/**
+ * @brief One TLB: its geometry and its entries, stored as a structure of arrays.
+ * The fields after config are derived from it by tlb_init().
+ */
+typedef struct {
+    tlb_t type;
+    tlb_config_t config;
+    uint8_t index_bits; // log_2(config.lines)
+    uint8_t tag_ways;   // config.ways rounded up to TLB_TAG_GROUP
+    uint64_t rng;       // state of the RANDOM generator
+    uint64_t * tags;    // config.lines rows of tag_ways tags; owns the whole storage
+    uint32_t * phy_page_nums; // config.lines * config.ways physical numbers of the first 4 kiB page
+    uint8_t * ages;     // config.lines * config.ways ages (LRU, FIFO)
+    level_stats_t stats; // counted by tlb_search()
+} tlb_level_t;
 
+/**
+ * @brief The hierarchy.
+ * The TLBs do not distinguish reads from writes. There are no L1 victims,
+ * and the L2 promotions are the L2 hits that refill an L1 TLB. All the
+ * statistics of a level are counted in its main TLB.
+ */
+typedef struct {
+    tlb_level_t l1_itlb;
+    tlb_level_t l1_dtlb;
+    tlb_level_t l2_tlb;
+    tlb_level_t large[NB_TLBS][TLB_LARGE_ARRAYS]; // see tlb_hrchy_config_t
+    walk_cache_t walk[NB_WALK_CACHES];
+    uint8_t pcids;  // see tlb_hrchy_config_t
+    uint32_t cr3;   // the current address space
+} tlb_hrchy_t;
 
+/**
+ * @brief Where a translation was found (see tlb_search()), for a latency model.
+ */
 typedef struct {
-    uint32_t tag: 30;
-uint32_t phy_page_num: PHY_PAGE_NUM;
-    uint8_t v: 1;
+    tlb_t level;        // the L1 TLB of the access, L2_TLB, or NB_TLBS for a page walk
+    uint8_t walk_reads; // page-table entries read by the walk, 0 without a walk
+} tlb_outcome_t;
 
-} l2_tlb_entry_t;
+// --------------------------------------------------
+#define tlb_slot(TLB, LINE_INDEX, WAY) \
+        ((size_t) (LINE_INDEX) * (TLB)->config.ways + (WAY))
 
-typedef enum {
-    L1_ITLB, L1_DTLB, L2_TLB } tlb_t;
\ No newline at end of file
+// --------------------------------------------------
+#define tlb_tags(TLB, LINE_INDEX) \
+        ((TLB)->tags + (size_t) (LINE_INDEX) * (TLB)->tag_ways)
+
+// --------------------------------------------------
+#define tlb_valid(TLB, LINE_INDEX, WAY) \
+        ((uint8_t) (tlb_tags(TLB, LINE_INDEX)[WAY] >> 63))
+
+// --------------------------------------------------
+#define tlb_tag(TLB, LINE_INDEX, WAY) \
+        (tlb_tags(TLB, LINE_INDEX)[WAY] & TLB_TAG_MASK)
+
+// --------------------------------------------------
+#define tlb_page_size(TLB, LINE_INDEX, WAY) \
+        ((page_size_t) ((tlb_tags(TLB, LINE_INDEX)[WAY] & ~TLB_TAG_VALID) >> TLB_TAG_SIZE_SHIFT))
+
+// --------------------------------------------------
+#define tlb_pcid(TLB, LINE_INDEX, WAY) \
+        ((uint16_t) (tlb_tags(TLB, LINE_INDEX)[WAY] >> TLB_TAG_PCID_SHIFT & CR3_PCID_MASK))
+
+// --------------------------------------------------
+#define tlb_phy_page_num(TLB, LINE_INDEX, WAY) \
+        (TLB)->phy_page_nums[tlb_slot(TLB, LINE_INDEX, WAY)]
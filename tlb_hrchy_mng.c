@@ -1,287 +1,531 @@
 #include "tlb_hrchy_mng.h"
 #include "stdlib.h"
+#include "string.h"
 #include "error.h"
 #include "addr.h"
 #include "memory.h"
 #include "addr_mng.h"
 #include "page_walk.h"
+#include "walk_cache_mng.h"
+#include "cache_mng.h" // foreach_way, and cache_age for lru.h
+#include "lru.h"
+#include "util.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
+#define TLB_STORAGE_ALIGN  64 // a host cache line
+#define TLB_DEFAULT_SEED   UINT64_C(0x9E3779B97F4A7C15)
 
-#define init(TYPE,LINES) \
-((TYPE *)tlb_entry)->tag =  (virtual_page_number >> LINES);\
-((TYPE *)tlb_entry)->phy_page_num = phy_page_num;\
-((TYPE *)tlb_entry)->v = 1;\
-return ERR_NONE;
+// --------------------------------------------------
+#define tlb_index_of(TLB, VPN) \
+        ((VPN) & ((TLB)->config.lines - 1u))
 
-int tlb_entry_init( const virt_addr_t * vaddr,
-                    const phy_addr_t * paddr,
-                    void * tlb_entry,
-                    tlb_t tlb_type)
-{
-
-    M_REQUIRE_NON_NULL(vaddr);//check validity of arguments
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(tlb_entry);
+// --------------------------------------------------
+#define tlb_key_of(TLB, VPN, SIZE, PCID) \
+        (((VPN) >> (TLB)->index_bits) | (uint64_t) (PCID) << TLB_TAG_PCID_SHIFT \
+         | (uint64_t) (SIZE) << TLB_TAG_SIZE_SHIFT | TLB_TAG_VALID)
 
-    uint64_t phy_page_num = paddr->phy_page_num;
-    uint64_t virtual_page_number = virt_addr_t_to_virtual_page_number(vaddr);
-
-    switch (tlb_type)
-        {
-        case L1_ITLB:
-            init(l1_itlb_entry_t, L1_ITLB_LINES_BITS);
-        case L1_DTLB:
-            init(l1_dtlb_entry_t, L1_DTLB_LINES_BITS);
-        case L2_TLB:
-            init(l2_tlb_entry_t, L2_TLB_LINES_BITS);
-        default:
-            return ERR_BAD_PARAMETER;
-        }
+// --------------------------------------------------
+#define page_size_mask(SIZE) \
+        ((UINT64_C(1) << page_size_order(SIZE)) - 1u)
 
+//=========================================================================
+static size_t tlb_storage_size(const tlb_level_t * tlb)
+{
+    const size_t slots = (size_t) tlb->config.lines * tlb->config.ways;
+    const size_t size = (size_t) tlb->config.lines * tlb->tag_ways * sizeof(uint64_t)
+                        + slots * (sizeof(uint32_t) + sizeof(uint8_t));
+    // aligned_alloc() wants a multiple of the alignment
+    return (size + TLB_STORAGE_ALIGN - 1) / TLB_STORAGE_ALIGN * TLB_STORAGE_ALIGN;
 }
 
-#define flush(TYPE,LINES)\
-for (int i = 0; i < LINES; ++i){\
-                    ((TYPE *)tlb)[i].v = 0;\
-                    ((TYPE *)tlb)[i].tag = 0;\
-                    ((TYPE *)tlb)[i].phy_page_num = 0;\
-                }\
-return ERR_NONE;\
-
-int tlb_flush(void *tlb, tlb_t tlb_type)
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_init(tlb_level_t * tlb, tlb_t tlb_type, const tlb_config_t * config)
 {
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE(tlb_type == L1_ITLB || tlb_type == L1_DTLB || tlb_type == L2_TLB, ERR_BAD_PARAMETER, "%d: unknown TLB", tlb_type);
+    M_REQUIRE(config->lines > 0 && config->lines <= TLB_MAX_LINES && (config->lines & (config->lines - 1)) == 0,
+              ERR_SIZE, "%u lines: not a power of 2 up to %u", config->lines, TLB_MAX_LINES);
+    M_REQUIRE(config->ways > 0 && config->ways <= TLB_MAX_WAYS, ERR_SIZE, "%u ways", config->ways);
+    M_REQUIRE(config->replace == LRU || config->replace == FIFO || config->replace == RANDOM,
+              ERR_POLICY, "%d: not a TLB replacement policy", config->replace);
+    M_REQUIRE(config->page_sizes != 0 && (config->page_sizes & ~TLB_ALL_PAGES) == 0,
+              ERR_BAD_PARAMETER, "0x%x: not a mask of page sizes", config->page_sizes);
+
+    zero_init_ptr(tlb);
+    tlb->type = tlb_type;
+    tlb->config = *config;
+    while ((1u << tlb->index_bits) < config->lines) ++tlb->index_bits;
+    tlb->tag_ways = (uint8_t) ((config->ways + TLB_TAG_GROUP - 1) / TLB_TAG_GROUP * TLB_TAG_GROUP);
+    tlb->rng = TLB_DEFAULT_SEED;
+
+    // one block: tags first, so that rows of tags are aligned on host cache lines
+    const size_t size = tlb_storage_size(tlb);
+    tlb->tags = aligned_alloc(TLB_STORAGE_ALIGN, size);
+    M_EXIT_IF_NULL(tlb->tags, size);
+    memset(tlb->tags, 0, size);
+    tlb->phy_page_nums = (uint32_t *) (tlb->tags + (size_t) config->lines * tlb->tag_ways);
+    tlb->ages = (uint8_t *) (tlb->phy_page_nums + (size_t) config->lines * config->ways);
+    return ERR_NONE;
+}
 
-    M_REQUIRE_NON_NULL(tlb);//check validity of arguments
-
-    switch (tlb_type)
+//=========================================================================
+// see tlb_hrchy_mng.h
+void tlb_free(tlb_level_t * tlb)
+{
+    if (tlb != NULL)
         {
-        case L1_ITLB:
-            flush(l1_itlb_entry_t, L1_ITLB_LINES);
-        case L1_DTLB:
-            flush(l1_dtlb_entry_t, L1_DTLB_LINES);
-        case L2_TLB:
-            flush(l2_tlb_entry_t, L2_TLB_LINES);
-        default:
-            return ERR_BAD_PARAMETER;
+            free(tlb->tags);
+            tlb->tags = NULL;
+            tlb->phy_page_nums = NULL;
+            tlb->ages = NULL;
         }
-
 }
 
-
-#define insert(TYPE,LINES)\
-if (line_index >= LINES)\
-                {\
-                    return ERR_BAD_PARAMETER;\
-                }\
-            ((TYPE *)tlb)[line_index] = *((TYPE *)tlb_entry);\
-            return ERR_NONE;\
-
-
-int tlb_insert( uint32_t line_index,
-                const void * tlb_entry,
-                void * tlb,
-                tlb_t tlb_type)
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_flush(tlb_level_t * tlb)
 {
-
     M_REQUIRE_NON_NULL(tlb);//check validity of arguments
-    M_REQUIRE_NON_NULL(tlb_entry);
+    M_REQUIRE_NON_NULL(tlb->tags);
 
+    memset(tlb->tags, 0, tlb_storage_size(tlb));
+    return ERR_NONE;
+}
 
-    switch (tlb_type)
+//=========================================================================
+/**
+ * @brief Compares a key against a whole row of tags.
+ * @return the mask of the ways holding key (bit i for way i)
+ */
+static inline uint32_t tlb_tag_match(const uint64_t * tags, uint64_t key, uint8_t tag_ways)
+{
+    uint32_t mask = 0;
+    uint8_t w = 0;
+#if defined(__AVX2__)
+    const __m256i key4 = _mm256_set1_epi64x((long long) key);
+    for (; w < tag_ways; w += 4)
         {
-        case L1_ITLB:
-            insert(l1_itlb_entry_t, L1_ITLB_LINES);
-        case L1_DTLB:
-            insert(l1_dtlb_entry_t, L1_DTLB_LINES);
-        case L2_TLB:
-            insert(l2_tlb_entry_t, L2_TLB_LINES);
-        default:
-            return ERR_BAD_PARAMETER;
+            const __m256i eq = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *) (tags + w)), key4);
+            mask |= (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(eq)) << w;
         }
-
-
+#elif defined(__SSE2__)
+    // no 64-bit compare in SSE2: a way matches when both of its halves do
+    const __m128i key2 = _mm_set1_epi64x((long long) key);
+    for (; w < tag_ways; w += 2)
+        {
+            const __m128i eq = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *) (tags + w)), key2);
+            const uint32_t halves = (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(eq));
+            mask |= ((halves & (halves >> 1) & 1u) | ((halves >> 1) & (halves >> 2) & 2u)) << w;
+        }
+#else
+    for (; w < tag_ways; ++w)
+        mask |= (uint32_t) (tags[w] == key) << w;
+#endif
+    return mask;
 }
 
-#define hit(TYPE,LINES,BITS)\
-line_index = virt_page_num % LINES;\
-tag = virt_page_num >> BITS;\
-if (((TYPE *)tlb)[line_index].v && tag == ((TYPE *)tlb)[line_index].tag )\
-    {\
-        paddr->phy_page_num =  ((TYPE *)tlb)[line_index].phy_page_num ;\
-        paddr->page_offset =  vaddr->page_offset;\
-        return 1;\
-    }\
-return 0;\
-
+//=========================================================================
+// see tlb_hrchy_mng.h
 int tlb_hit( const virt_addr_t * vaddr,
+             uint16_t pcid,
              phy_addr_t * paddr,
-             const void  * tlb,
-             tlb_t tlb_type)
+             tlb_level_t * tlb,
+             page_size_t * page_size)
 {
+    if (vaddr == NULL || paddr == NULL || tlb == NULL || tlb->tags == NULL) return 0;
 
-    M_REQUIRE_NON_NULL(vaddr);
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(tlb);
-
-    uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr);
-    uint64_t line_index = 0;
-    uint64_t tag = 0;
-
-    switch (tlb_type)
+    const uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr);
+    for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size)
         {
-        case L1_ITLB:
-            hit(l1_itlb_entry_t, L1_ITLB_LINES, L1_ITLB_LINES_BITS);
-        case L1_DTLB:
-            hit(l1_dtlb_entry_t, L1_DTLB_LINES, L1_DTLB_LINES_BITS);
-        case L2_TLB:
-            hit(l2_tlb_entry_t, L2_TLB_LINES, L2_TLB_LINES_BITS);
-        default:
-            return 0;
+            if ((tlb->config.page_sizes & TLB_PAGES(size)) == 0) continue;
+
+            const uint64_t page_num = virt_page_num >> page_size_order(size);
+            const uint32_t line_index = (uint32_t) tlb_index_of(tlb, page_num);
+            const uint32_t mask = tlb_tag_match(tlb_tags(tlb, line_index), tlb_key_of(tlb, page_num, size, pcid), tlb->tag_ways);
+            if (mask == 0) continue;
+
+            const uint8_t way = (uint8_t) __builtin_ctz(mask);
+            // the 4 kiB page of vaddr within the page of the entry
+            paddr->phy_page_num = tlb_phy_page_num(tlb, line_index, way) + (uint32_t) (virt_page_num & page_size_mask(size));
+            paddr->page_offset = vaddr->page_offset;
+            if (page_size != NULL) *page_size = size;
+            if (tlb->config.replace == LRU)
+                LRU_age_update(tlb, tlb->config.ways, way, line_index);
+            return 1;
         }
+    return 0;
 }
 
+//=========================================================================
+// the way to fill in a set: an invalid one if any, the policy's choice otherwise
+static uint8_t tlb_victim(tlb_level_t * tlb, uint32_t line_index)
+{
+    const uint32_t invalid = tlb_tag_match(tlb_tags(tlb, line_index), 0, tlb->tag_ways)
+                             & ((1u << tlb->config.ways) - 1u);
+    if (invalid != 0) return (uint8_t) __builtin_ctz(invalid);
 
+    if (tlb->config.replace == RANDOM)
+        {
+            uint64_t x = tlb->rng;
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            tlb->rng = x;
+            return (uint8_t) (x % tlb->config.ways);
+        }
 
-#define search_invalid(L1,LINES)\
-tl1_vaddr = (L1[tl1_index].tag << LINES) | tl1_index;\
-if ( L1[tl1_index].v == 1  && tl1_vaddr == tl2_vaddr)\
-    {\
-        L1[tl1_index].v = 0;\
-    }\
-return ERR_NONE;\
+    // LRU and FIFO: the oldest
+    uint8_t victim = 0;
+    foreach_way(way, tlb->config.ways)
+        if (cache_age(tlb, line_index, way) > cache_age(tlb, line_index, victim))
+            victim = way;
+    return victim;
+}
 
-int tlb_search_invalid(l1_itlb_entry_t* l1_itlb,
-                       l1_dtlb_entry_t* l1_dtlb,
-                       uint64_t virt_page_number,
-                       mem_access_t access,
-                       l2_tlb_entry_t* l2_tlb)
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_insert( const virt_addr_t * vaddr,
+                uint16_t pcid,
+                const phy_addr_t * paddr,
+                page_size_t page_size,
+                tlb_level_t * tlb,
+                tlb_page_t * evicted)
 {
+    if (vaddr == NULL || paddr == NULL || tlb == NULL || tlb->tags == NULL
+        || page_size >= NB_PAGE_SIZES || (tlb->config.page_sizes & TLB_PAGES(page_size)) == 0) return 0;
 
-    M_REQUIRE_NON_NULL(l1_dtlb);//checks validity of the arguments
-    M_REQUIRE_NON_NULL(l1_itlb);
-    M_REQUIRE_NON_NULL(l2_tlb);
+    const uint64_t page_num = virt_addr_t_to_virtual_page_number(vaddr) >> page_size_order(page_size);
+    const uint32_t line_index = (uint32_t) tlb_index_of(tlb, page_num);
+    const uint8_t way = tlb_victim(tlb, line_index);
 
+    uint64_t * const tag = &tlb_tags(tlb, line_index)[way];
+    const int replaced = (*tag & TLB_TAG_VALID) != 0;
+    if (replaced && evicted != NULL)
+        {
+            evicted->size = tlb_page_size(tlb, line_index, way);
+            evicted->pcid = tlb_pcid(tlb, line_index, way);
+            evicted->virt_page_num = ((*tag & TLB_TAG_MASK) << tlb->index_bits | line_index) << page_size_order(evicted->size);
+        }
 
+    *tag = tlb_key_of(tlb, page_num, page_size, pcid);
+    tlb_phy_page_num(tlb, line_index, way) = paddr->phy_page_num & ~(uint32_t) page_size_mask(page_size);
+    // RANDOM keeps no state
+    if (tlb->config.replace != RANDOM)
+        LRU_age_increase(tlb, tlb->config.ways, way, line_index);
+    return replaced;
+}
 
-    uint8_t tl2_index = virt_page_number & 0b111111; //apply mask
-    uint32_t tl2_vaddr = (l2_tlb[tl2_index].tag << L2_TLB_LINES_BITS) | tl2_index;
-    uint8_t tl1_index  =  virt_page_number % L1_ITLB_LINES;
-    uint32_t tl1_vaddr;
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_invalidate(const tlb_page_t * page, tlb_level_t * tlb)
+{
+    if (page == NULL || tlb == NULL || tlb->tags == NULL
+        || page->size >= NB_PAGE_SIZES || (tlb->config.page_sizes & TLB_PAGES(page->size)) == 0) return 0;
 
-    switch (access)
-        {
-        case INSTRUCTION:
-            search_invalid(l1_dtlb, L1_DTLB_LINES_BITS);
-        case DATA:
-            search_invalid(l1_itlb, L1_ITLB_LINES_BITS);
-        default:
-            return ERR_BAD_PARAMETER;
-        }
+    const uint64_t page_num = page->virt_page_num >> page_size_order(page->size);
+    const uint32_t line_index = (uint32_t) tlb_index_of(tlb, page_num);
+    const uint32_t mask = tlb_tag_match(tlb_tags(tlb, line_index), tlb_key_of(tlb, page_num, page->size, page->pcid),
+                                        tlb->tag_ways);
+    if (mask == 0) return 0;
 
+    tlb_tags(tlb, line_index)[__builtin_ctz(mask)] = 0;
+    return 1;
+}
 
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_hrchy_init(tlb_hrchy_t * tlbs, const tlb_hrchy_config_t * config)
+{
+    M_REQUIRE_NON_NULL(tlbs);
+    M_REQUIRE_NON_NULL(config);
+    zero_init_ptr(tlbs);
+    tlbs->pcids = config->pcids;
+
+    int err = tlb_init(&tlbs->l1_itlb, L1_ITLB, &config->l1_itlb);
+    if (err == ERR_NONE) err = tlb_init(&tlbs->l1_dtlb, L1_DTLB, &config->l1_dtlb);
+    if (err == ERR_NONE) err = tlb_init(&tlbs->l2_tlb, L2_TLB, &config->l2_tlb);
+    for (tlb_t level = L1_ITLB; level < NB_TLBS && err == ERR_NONE; ++level)
+        for (size_t i = 0; i < TLB_LARGE_ARRAYS && err == ERR_NONE; ++i)
+            if (config->large[level][i].lines > 0)
+                err = tlb_init(&tlbs->large[level][i], level, &config->large[level][i]);
+    for (walk_cache_type_t type = PML4E_CACHE; type < NB_WALK_CACHES && err == ERR_NONE; ++type)
+        err = walk_cache_init(&tlbs->walk[type], type, &config->walk[type]);
+    if (err != ERR_NONE) tlb_hrchy_free(tlbs);
+    return err;
 }
 
+//=========================================================================
+// see tlb_hrchy_mng.h
+void tlb_hrchy_free(tlb_hrchy_t * tlbs)
+{
+    if (tlbs != NULL)
+        {
+            tlb_free(&tlbs->l1_itlb);
+            tlb_free(&tlbs->l1_dtlb);
+            tlb_free(&tlbs->l2_tlb);
+            for (tlb_t level = L1_ITLB; level < NB_TLBS; ++level)
+                for (size_t i = 0; i < TLB_LARGE_ARRAYS; ++i)
+                    tlb_free(&tlbs->large[level][i]);
+            for (walk_cache_type_t type = PML4E_CACHE; type < NB_WALK_CACHES; ++type)
+                walk_cache_free(&tlbs->walk[type]);
+        }
+}
 
-int tlb_search( const void * mem_space,
-                const virt_addr_t * vaddr,
-                phy_addr_t * paddr,
-                mem_access_t access,
-                l1_itlb_entry_t * l1_itlb,
-                l1_dtlb_entry_t * l1_dtlb,
-                l2_tlb_entry_t * l2_tlb,
-                int* hit_or_miss)
+//=========================================================================
+// the main TLB of a level
+static tlb_level_t * tlb_main(tlb_hrchy_t * tlbs, tlb_t level)
 {
+    return level == L1_ITLB ? &tlbs->l1_itlb : level == L1_DTLB ? &tlbs->l1_dtlb : &tlbs->l2_tlb;
+}
 
-    M_REQUIRE_NON_NULL(mem_space);
-    M_REQUIRE_NON_NULL(vaddr);
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(l1_itlb);
-    M_REQUIRE_NON_NULL(l1_dtlb);
-    M_REQUIRE_NON_NULL(l2_tlb);
-    M_REQUIRE_NON_NULL(hit_or_miss);
+//=========================================================================
+// the TLB of a level holding the pages of a size, NULL if none
+static tlb_level_t * tlb_holding(tlb_hrchy_t * tlbs, tlb_t level, page_size_t size)
+{
+    tlb_level_t * const tlb = tlb_main(tlbs, level);
+    if (tlb->config.page_sizes & TLB_PAGES(size)) return tlb;
+    for (size_t i = 0; i < TLB_LARGE_ARRAYS; ++i)
+        if (tlbs->large[level][i].tags != NULL && (tlbs->large[level][i].config.page_sizes & TLB_PAGES(size)))
+            return &tlbs->large[level][i];
+    return NULL;
+}
 
+//=========================================================================
+// looks vaddr up in every TLB of a level, in the current address space
+static int tlb_level_hit(tlb_hrchy_t * tlbs, tlb_t level, const virt_addr_t * vaddr,
+                         phy_addr_t * paddr, page_size_t * page_size)
+{
+    const uint16_t pcid = cr3_pcid(tlbs->cr3);
+    if (tlb_hit(vaddr, pcid, paddr, tlb_main(tlbs, level), page_size)) return 1;
+    for (size_t i = 0; i < TLB_LARGE_ARRAYS; ++i)
+        if (tlb_hit(vaddr, pcid, paddr, &tlbs->large[level][i], page_size)) return 1;
+    return 0;
+}
 
-    if (access == INSTRUCTION)
+//=========================================================================
+// fills the TLB of a level holding pages of the size of the page of vaddr,
+// or splinters the page into its 4 kiB page of vaddr; see tlb_insert()
+// (*inserted, if not NULL, tells if a TLB of the level could hold it)
+static int tlb_level_insert(tlb_hrchy_t * tlbs, tlb_t level, const virt_addr_t * vaddr,
+                            const phy_addr_t * paddr, page_size_t page_size, tlb_page_t * evicted, int * inserted)
+{
+    tlb_level_t * tlb = tlb_holding(tlbs, level, page_size);
+    if (tlb == NULL)
         {
-            *hit_or_miss = tlb_hit(vaddr, paddr, l1_itlb, L1_ITLB); //assigns value to hit or miss
+            page_size = PAGE_4K;
+            tlb = tlb_holding(tlbs, level, page_size);
         }
-    else if (access == DATA)
+    if (inserted != NULL) *inserted = tlb != NULL;
+    return tlb != NULL && tlb_insert(vaddr, cr3_pcid(tlbs->cr3), paddr, page_size, tlb, evicted);
+}
+
+//=========================================================================
+// removes a page that left L2 from an L1 level: from the TLB holding its
+// size, or, if none, its 4 kiB splinters from the TLB holding those
+static void tlb_level_invalidate(tlb_hrchy_t * tlbs, tlb_t level, const tlb_page_t * page)
+{
+    tlb_level_t * const tlb = tlb_holding(tlbs, level, page->size);
+    if (tlb != NULL)
         {
-            *hit_or_miss = tlb_hit(vaddr, paddr, l1_dtlb, L1_DTLB);//assigns value to hit or miss
+            tlb_invalidate(page, tlb);
+            return;
         }
+
+    tlb_level_t * const splinters = tlb_holding(tlbs, level, PAGE_4K);
+    if (splinters == NULL) return;
+    const uint64_t last = page->virt_page_num + (UINT64_C(1) << page_size_order(page->size));
+    for (uint32_t line_index = 0; line_index < splinters->config.lines; ++line_index)
+        foreach_way(way, splinters->config.ways)
+            {
+                uint64_t * const tag = &tlb_tags(splinters, line_index)[way];
+                if (!(*tag & TLB_TAG_VALID) || tlb_page_size(splinters, line_index, way) != PAGE_4K
+                    || tlb_pcid(splinters, line_index, way) != page->pcid) continue;
+                const uint64_t page_num = (*tag & TLB_TAG_MASK) << splinters->index_bits | line_index;
+                if (page_num >= page->virt_page_num && page_num < last) *tag = 0;
+            }
+}
+
+//=========================================================================
+// tlb_search() on checked arguments; *in_l1 (if not NULL) tells if the
+// translation is in the L1 TLB of the access afterwards (hit or filled)
+static int tlb_translate(const void * mem_space, const virt_addr_t * vaddr, phy_addr_t * paddr,
+                         mem_access_t access, tlb_hrchy_t * tlbs, int * hit_or_miss, page_size_t * page_size,
+                         tlb_outcome_t * outcome, int * in_l1)
+{
+    const tlb_t l1_level = (access == INSTRUCTION) ? L1_ITLB : L1_DTLB;
+    // all the statistics of a level are in its main TLB
+    level_stats_t * const l1_stats = &tlb_main(tlbs, l1_level)->stats;
+    level_stats_t * const l2_stats = &tlbs->l2_tlb.stats;
+    page_size_t size = PAGE_4K;
+    tlb_outcome_t found = { l1_level, 0 };
+
+    *hit_or_miss = tlb_level_hit(tlbs, l1_level, vaddr, paddr, &size); //assigns value to hit or miss
+    stats_inc(l1_stats, access, STAT_ACCESSES);
     if (*hit_or_miss)
         {
+            stats_inc(l1_stats, access, STAT_HITS);
+            if (page_size != NULL) *page_size = size;
+            if (outcome != NULL) *outcome = found;
+            if (in_l1 != NULL) *in_l1 = 1;
             return ERR_NONE; //returns if it is a hit
         }
+    stats_inc(l1_stats, access, STAT_MISSES);
 
-    *hit_or_miss = tlb_hit(vaddr, paddr, l2_tlb, L2_TLB);
-    uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr); //extract virtual page number
+    *hit_or_miss = tlb_level_hit(tlbs, L2_TLB, vaddr, paddr, &size);
+    stats_inc(l2_stats, access, STAT_ACCESSES);
 
+    int l2_evicted = 0;
+    tlb_page_t evicted;
+    zero_init_var(evicted);
     if (*hit_or_miss)
         {
-            uint64_t line_index = 0;
-
-            if (access == INSTRUCTION)
-                {
-
-                    line_index = virt_page_num % L1_ITLB_LINES; //computes line index
-                    void* new_tlb =  malloc(sizeof(l1_itlb_entry_t));//Allocates enough space
-                    M_REQUIRE_NON_NULL(new_tlb);
-                    tlb_entry_init(vaddr, paddr, new_tlb, L1_ITLB);//initializes the new tlb
-                    tlb_insert(line_index, new_tlb, l1_itlb, L1_ITLB);//inserts it at the corresponding place
-                    return ERR_NONE;
-
-                }
+            stats_inc(l2_stats, access, STAT_HITS);
+            stats_inc(l2_stats, access, STAT_PROMOTIONS);
+            found.level = L2_TLB;
+        }
+    else
+        {
+            stats_inc(l2_stats, access, STAT_MISSES);
 
-            else if (access == DATA)
-                {
+            *hit_or_miss = 0;//sets hit or miss to 0
+            M_REQUIRE(page_walk_cached(mem_space, tlbs->cr3, vaddr, paddr, &size, tlbs->walk, access, &found.walk_reads) == ERR_NONE, ERR_BAD_PARAMETER, " ",);
+            found.level = NB_TLBS;
+            l2_evicted = tlb_level_insert(tlbs, L2_TLB, vaddr, paddr, size, &evicted, NULL);
+            if (l2_evicted) stats_inc(l2_stats, access, STAT_EVICTIONS);
+        }
 
-                    line_index = virt_page_num % L1_DTLB_LINES;//computes line index
-                    void* new_tlb =  malloc(sizeof(l1_itlb_entry_t));//Allocates enough space
-                    M_REQUIRE_NON_NULL(new_tlb);
-                    tlb_entry_init(vaddr, paddr, new_tlb, L1_ITLB);//initializes the new tlb
-                    tlb_insert(line_index, new_tlb, l1_itlb, L1_ITLB);//inserts it at the corresponding place
+    // (re)fill the L1 TLB of the access, from L2 or after the page walk
+    if (tlb_level_insert(tlbs, l1_level, vaddr, paddr, size, NULL, in_l1)) stats_inc(l1_stats, access, STAT_EVICTIONS);
 
-                    return ERR_NONE;
-                }
+    // inclusion: what left L2 leaves both L1 TLBs, splinters included (if still there, it was not just replaced)
+    if (l2_evicted)
+        {
+            tlb_level_invalidate(tlbs, L1_ITLB, &evicted);
+            tlb_level_invalidate(tlbs, L1_DTLB, &evicted);
         }
+    if (page_size != NULL) *page_size = size;
+    if (outcome != NULL) *outcome = found;
+    return ERR_NONE;
 
-    else
-        {
+}
 
-            *hit_or_miss = 0;//sets hit or miss to 0
-            M_REQUIRE(page_walk(mem_space, vaddr, paddr) == ERR_NONE, ERR_BAD_PARAMETER, " ",);
-            M_REQUIRE(tlb_search_invalid(l1_itlb, l1_dtlb, virt_page_num,  access, l2_tlb) == ERR_NONE, ERR_BAD_PARAMETER, "BAd parameter"); //call the invalidation function
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_search( const void * mem_space,
+                const virt_addr_t * vaddr,
+                phy_addr_t * paddr,
+                mem_access_t access,
+                tlb_hrchy_t * tlbs,
+                int* hit_or_miss,
+                page_size_t * page_size,
+                tlb_outcome_t * outcome)
+{
 
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(vaddr);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(tlbs);
+    M_REQUIRE_NON_NULL(hit_or_miss);
+    M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "%s", "Wrong access");
 
-            void* new_tlb =  malloc(sizeof(l2_tlb_entry_t));//Allocates enough space
-            M_REQUIRE_NON_NULL(new_tlb);
-            tlb_entry_init(vaddr, paddr, new_tlb, L2_TLB);//initializes the new l2_tlb
-            uint64_t line_index = virt_page_num % L2_TLB_LINES;
-            tlb_insert(line_index, new_tlb, l2_tlb, L2_TLB);//inserts it at the corresponding place
+    return tlb_translate(mem_space, vaddr, paddr, access, tlbs, hit_or_miss, page_size, outcome, NULL);
+}
 
-            if (access == INSTRUCTION)
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_search_batch( const void * mem_space,
+                      const virt_addr_t * vaddrs,
+                      const mem_access_t * accesses,
+                      phy_addr_t * paddrs,
+                      size_t n,
+                      tlb_hrchy_t * tlbs,
+                      int * hits,
+                      tlb_outcome_t * outcomes,
+                      size_t * translated)
+{
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(vaddrs);
+    M_REQUIRE_NON_NULL(accesses);
+    M_REQUIRE_NON_NULL(paddrs);
+    M_REQUIRE_NON_NULL(tlbs);
+
+    size_t i = 0;
+    int err = ERR_NONE;
+    uint64_t last_page = 0;
+    int last_in_l1 = 0; // the previous translation is in its L1 TLB
+    for (; i < n; ++i)
+        {
+            const mem_access_t access = accesses[i];
+            if (access != INSTRUCTION && access != DATA)
                 {
-                    void* new_itlb = malloc(sizeof(l1_itlb_entry_t));//Allocates enough space
-                    M_REQUIRE_NON_NULL(new_itlb);
-                    tlb_entry_init(vaddr, paddr, new_itlb, L1_ITLB);//initializes the new itlb
-                    uint8_t line_index = virt_page_num % L1_ITLB_LINES;
-                    tlb_insert(line_index, new_itlb, l1_itlb, L1_ITLB);
+                    err = ERR_BAD_PARAMETER;
+                    break;
                 }
-            else if (access == DATA)
+            const uint64_t page = virt_addr_t_to_virtual_page_number(&vaddrs[i]);
+
+            /*
+             * Same 4 kiB page and L1 TLB as the previous translation, which
+             * hit in its L1 TLB or filled it: the entry is there, most
+             * recently used, so this one is a hit changing nothing but the
+             * statistics.
+             */
+            if (i > 0 && last_in_l1 && page == last_page && access == accesses[i - 1])
                 {
-                    void* new_dtlb = malloc(sizeof(l1_dtlb_entry_t));//Allocates enough space
-                    M_REQUIRE_NON_NULL(new_dtlb);
-                    tlb_entry_init(vaddr, paddr, new_dtlb, L1_DTLB);//initializes the new dtlb
-                    uint8_t line_index = virt_page_num % L1_DTLB_LINES;
-                    tlb_insert(line_index, new_dtlb, l1_dtlb, L1_DTLB);//inserts it at the corresponding place
+                    level_stats_t * const l1_stats = &tlb_main(tlbs, access == INSTRUCTION ? L1_ITLB : L1_DTLB)->stats;
+                    stats_inc(l1_stats, access, STAT_ACCESSES);
+                    stats_inc(l1_stats, access, STAT_HITS);
+                    paddrs[i].phy_page_num = paddrs[i - 1].phy_page_num;
+                    paddrs[i].page_offset = vaddrs[i].page_offset;
+                    if (hits != NULL) hits[i] = 1;
+                    if (outcomes != NULL) outcomes[i] = (tlb_outcome_t) { access == INSTRUCTION ? L1_ITLB : L1_DTLB, 0 };
+                    continue;
                 }
 
+            int hit = 0;
+            if ((err = tlb_translate(mem_space, &vaddrs[i], &paddrs[i], access, tlbs, &hit, NULL,
+                                     outcomes != NULL ? &outcomes[i] : NULL, &last_in_l1)) != ERR_NONE) break;
+            if (hits != NULL) hits[i] = hit;
+            last_page = page;
         }
-    return ERR_NONE;
-
+    if (translated != NULL) *translated = i;
+    return err;
 }
 
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_hrchy_switch(tlb_hrchy_t * tlbs, uint32_t cr3)
+{
+    M_REQUIRE_NON_NULL(tlbs);
+
+    tlbs->cr3 = cr3;
+    if (tlbs->pcids) return ERR_NONE;
+
+    // untagged: nothing of the previous address space may be used
+    tlb_level_t * const mains[] = { &tlbs->l1_itlb, &tlbs->l1_dtlb, &tlbs->l2_tlb };
+    for (size_t i = 0; i < sizeof(mains) / sizeof(mains[0]); ++i)
+        M_EXIT_IF_ERR(tlb_flush(mains[i]), "flushing a TLB");
+    for (tlb_t level = L1_ITLB; level < NB_TLBS; ++level)
+        for (size_t i = 0; i < TLB_LARGE_ARRAYS; ++i)
+            if (tlbs->large[level][i].tags != NULL)
+                M_EXIT_IF_ERR(tlb_flush(&tlbs->large[level][i]), "flushing a large-page TLB");
+    for (walk_cache_type_t type = PML4E_CACHE; type < NB_WALK_CACHES; ++type)
+        walk_cache_flush(&tlbs->walk[type]);
+    return ERR_NONE;
+}
 
+//=========================================================================
+// see tlb_hrchy_mng.h
+int tlb_hrchy_stats_print(FILE * output, stats_format_t format, const tlb_hrchy_t * tlbs)
+{
+    M_REQUIRE_NON_NULL(tlbs);
 
+    M_EXIT_IF_ERR(stats_print(output, format, "L1_ITLB", &tlbs->l1_itlb.stats), "printing L1 ITLB stats");
+    M_EXIT_IF_ERR(stats_print(output, format, "L1_DTLB", &tlbs->l1_dtlb.stats), "printing L1 DTLB stats");
+    M_EXIT_IF_ERR(stats_print(output, format, "L2_TLB", &tlbs->l2_tlb.stats), "printing L2 TLB stats");
+    return walk_cache_stats_print(output, format, tlbs->walk);
+}
@@ -12,80 +12,122 @@
 #include "mem_access.h"
 #include "addr.h"
 
+#include <stdio.h> // FILE
+
+//=========================================================================
+/**
+ * @brief Create a TLB of a given geometry and replacement policy. The TLB is flushed.
+ *
+ * @param tlb (modified) the TLB to be initialized
+ * @param tlb_type to distinguish between different TLBs
+ * @param config geometry, policy and page sizes of the TLB, see tlb_config_t
+ * @return error code (ERR_SIZE if the geometry is not supported,
+ *         ERR_POLICY if the policy is not LRU, FIFO or RANDOM,
+ *         ERR_BAD_PARAMETER if it holds no page size)
+ */
+int tlb_init(tlb_level_t * tlb, tlb_t tlb_type, const tlb_config_t * config);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for tlb_level_t: free its entries.
+ * @param tlb the TLB
+ */
+void tlb_free(tlb_level_t * tlb);
+
 //=========================================================================
 /**
  * @brief Clean a TLB (invalidate, reset...).
  *
- * This function erases all TLB data.
- * @param  tlb (generic) pointer to the TLB
- * @param tlb_type an enum to distinguish between different TLBs
+ * This function erases all TLB data; the statistics are kept.
+ * @param tlb the TLB
  * @return  error code
  */
-
-int tlb_flush(void *tlb, tlb_t tlb_type);
+int tlb_flush(tlb_level_t * tlb);
 
 //=========================================================================
 /**
  * @brief Check if a TLB entry exists in the TLB.
  *
- * On hit, return success (1) and update the physical page number passed as the pointer to the function.
+ * The pages of every size the TLB holds are looked up, 4 kiB ones first.
+ * On hit, return success (1), update the physical page number passed as
+ * the pointer to the function and the replacement state of the set.
  * On miss, return miss (0).
  *
  * @param vaddr pointer to virtual address
+ * @param pcid the address space of vaddr
  * @param paddr (modified) pointer to physical address
- * @param tlb pointer to the beginning of the tlb
- * @param tlb_type to distinguish between different TLBs
+ * @param tlb the TLB
+ * @param page_size (modified) on hit, the size of the page; may be NULL
  * @return hit (1) or miss (0)
  */
-
 int tlb_hit( const virt_addr_t * vaddr,
+             uint16_t pcid,
              phy_addr_t * paddr,
-             const void  * tlb,
-             tlb_t tlb_type);
+             tlb_level_t * tlb,
+             page_size_t * page_size);
 
 //=========================================================================
 /**
- * @brief Insert an entry to a tlb. Eviction policy is simple since
- *        direct mapping is used.
- * @param line_index the number of the line to overwrite
- * @param tlb_entry pointer to the tlb entry to insert
- * @param tlb pointer to the TLB
- * @param tlb_type to distinguish between different TLBs
- * @return  error code
+ * @brief Insert the translation of a virtual page in its set of a TLB:
+ * in an invalid way if any, in the way chosen by the replacement
+ * policy otherwise.
+ * @param vaddr pointer to virtual address, to extract the tag and set
+ * @param pcid the address space of vaddr
+ * @param paddr pointer to physical address, to extract physical page number
+ * @param page_size size of the page of vaddr; nothing is inserted if the
+ *        TLB does not hold pages of that size
+ * @param tlb the TLB
+ * @param evicted (modified) the page of the entry replaced, if it was
+ *        valid; may be NULL
+ * @return 1 if a valid entry was replaced, 0 otherwise
  */
+int tlb_insert( const virt_addr_t * vaddr,
+                uint16_t pcid,
+                const phy_addr_t * paddr,
+                page_size_t page_size,
+                tlb_level_t * tlb,
+                tlb_page_t * evicted);
 
-int tlb_insert( uint32_t line_index,
-                const void * tlb_entry,
-                void * tlb,
-                tlb_t tlb_type);
+//=========================================================================
+/**
+ * @brief Invalidate the entry of a virtual page in a TLB, if any.
+ * @param page the page (its virt_page_num may be any of its 4 kiB pages)
+ * @param tlb the TLB; may be NULL
+ * @return 1 if an entry was invalidated, 0 otherwise
+ */
+int tlb_invalidate(const tlb_page_t * page, tlb_level_t * tlb);
 
 //=========================================================================
 /**
- * @brief Initialize a TLB entry
- * @param vaddr pointer to virtual address, to extract tlb tag
- * @param paddr pointer to physical address, to extract physical page number
- * @param tlb_entry pointer to the entry to be initialized
- * @param tlb_type to distinguish between different TLBs
- * @return  error code
+ * @brief Create the TLBs of a hierarchy: the three main ones and the
+ * large-page ones of the configuration, and its paging-structure caches.
+ * @param tlbs (modified) the hierarchy
+ * @param config geometries and policies
+ * @return error code, see tlb_init()
  */
+int tlb_hrchy_init(tlb_hrchy_t * tlbs, const tlb_hrchy_config_t * config);
 
-int tlb_entry_init( const virt_addr_t * vaddr,
-                    const phy_addr_t * paddr,
-                    void * tlb_entry,
-                    tlb_t tlb_type);
+//=========================================================================
+/**
+ * @brief Free the TLBs and paging-structure caches of a hierarchy.
+ * @param tlbs the hierarchy
+ */
+void tlb_hrchy_free(tlb_hrchy_t * tlbs);
 
 //=========================================================================
 /**
- * @brief Ask TLB for the translation.
+ * @brief Ask TLB for the translation, in the current address space.
  *
  * @param mem_space pointer to the memory space
  * @param vaddr pointer to virtual address
  * @param paddr (modified) pointer to physical address (returned from TLB)
  * @param access to distinguish between fetching instructions and reading/writing data
- * @param l1_itlb pointer to the beginning of L1 ITLB
- * @param l1_dtlb pointer to the beginning of L1 DTLB
- * @param l2_tlb pointer to the beginning of L2 TLB
+ * @param tlbs the hierarchy; its statistics are counted
  * @param hit_or_miss (modified) hit (1) or miss (0)
+ * @param page_size (modified) size of the page of the entry translating
+ *        vaddr (4 kiB for a huge page splintered by a level, see
+ *        tlb_hrchy_config_t); may be NULL
+ * @param outcome (modified) the level that translated vaddr; may be NULL
  * @return error code
  */
 
@@ -93,7 +135,58 @@ int tlb_search( const void * mem_space,
                 const virt_addr_t * vaddr,
                 phy_addr_t * paddr,
                 mem_access_t access,
-                l1_itlb_entry_t * l1_itlb,
-                l1_dtlb_entry_t * l1_dtlb,
-                l2_tlb_entry_t * l2_tlb,
-                int* hit_or_miss);
+                tlb_hrchy_t * tlbs,
+                int* hit_or_miss,
+                page_size_t * page_size,
+                tlb_outcome_t * outcome);
+
+//=========================================================================
+/**
+ * @brief Ask TLB for the translations of a block of addresses, in order:
+ * same results and statistics as a tlb_search() for each of them, with
+ * the arguments checked once. An address in the same 4 kiB page as the
+ * previous one of the same access hits its L1 TLB without a lookup.
+ *
+ * @param mem_space pointer to the memory space
+ * @param vaddrs the n virtual addresses
+ * @param accesses their n kinds of access
+ * @param paddrs (modified) their n physical addresses
+ * @param n the number of addresses
+ * @param tlbs the hierarchy; its statistics are counted
+ * @param hits (modified) hit (1) or miss (0) of each of them; may be NULL
+ * @param outcomes (modified) the level that translated each of them; may be NULL
+ * @param translated (modified) the number of addresses translated, n
+ *        unless there was an error; may be NULL
+ * @return error code of the first translation that failed, if any
+ */
+int tlb_search_batch( const void * mem_space,
+                      const virt_addr_t * vaddrs,
+                      const mem_access_t * accesses,
+                      phy_addr_t * paddrs,
+                      size_t n,
+                      tlb_hrchy_t * tlbs,
+                      int * hits,
+                      tlb_outcome_t * outcomes,
+                      size_t * translated);
+
+//=========================================================================
+/**
+ * @brief Context switch: make cr3 the current address space. Without
+ * PCIDs (see tlb_hrchy_config_t), all the TLBs and paging-structure
+ * caches are flushed; their statistics are kept.
+ * @param tlbs the hierarchy
+ * @param cr3 the address space: address of its PGD and PCID (see addr.h)
+ * @return error code
+ */
+int tlb_hrchy_switch(tlb_hrchy_t * tlbs, uint32_t cr3);
+
+//=========================================================================
+/**
+ * @brief Print the statistics of the TLB hierarchy to a stream, those
+ * of its paging-structure caches last.
+ * @param output the stream to print to
+ * @param format text or CSV (see stats_print())
+ * @param tlbs the hierarchy
+ * @return error code
+ */
+int tlb_hrchy_stats_print(FILE * output, stats_format_t format, const tlb_hrchy_t * tlbs);
@@ -4,6 +4,7 @@
 #include "error.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h> // memset
 
 #include "page_walk.h"
 
@@ -22,35 +23,135 @@ int tlb_entry_init( const virt_addr_t * vaddr, const phy_addr_t * paddr, tlb_ent
 	return ERR_NONE;
 }
 
-int tlb_insert( uint32_t line_index, const tlb_entry_t * tlb_entry, tlb_entry_t * tlb)
+int tlb_flush(tlb_entry_t * tlb)
 {
 
-	M_REQUIRE(line_index < TLB_LINES, ERR_BAD_PARAMETER, "index bigger than size");
-	M_REQUIRE_NON_NULL(tlb_entry);
 	M_REQUIRE_NON_NULL(tlb);
 
-	tlb[line_index].phy_page_num = tlb_entry->phy_page_num;//inserts everything at the given index
-	tlb[line_index].tag = tlb_entry->tag;
-	tlb[line_index].v = tlb_entry->v;
-
+	for (int i = 0 ; i < TLB_LINES; ++i) //loops through the array and sets everything to 0
+		{
+			tlb[i].phy_page_num = 0;
+			tlb[i].tag = 0;
+			tlb[i].v = 0;
+		}
 	return ERR_NONE;
+
 }
 
-int tlb_flush(tlb_entry_t * tlb)
+// --------------------------------------------------
+#define tlb_hash(VPN) \
+	((uint32_t) (((VPN) * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - TLB_HASH_BITS)))
+
+
+/**
+ * @brief      Removes a line from the chain of its bucket, if any
+ *
+ * @param      index       The index
+ * @param[in]  line_index  The line
+ */
+static void tlb_index_remove(tlb_index_t * index, uint16_t line_index)
 {
+	if (index->bucket_of[line_index] == 0) return;
 
-	M_REQUIRE_NON_NULL(tlb);
+	uint16_t * link = &index->buckets[index->bucket_of[line_index] - 1];
+	while (*link != line_index + 1u) link = &index->next[*link - 1];
+	*link = index->next[line_index];
+	index->next[line_index] = 0;
+	index->bucket_of[line_index] = 0;
+}
 
-	for (int i = 0 ; i < TLB_LINES; ++i) //loops through the array and sets everything to 0
+
+/**
+ * @brief      Chains a line in the bucket of its virtual page number
+ */
+static void tlb_index_add(tlb_index_t * index, uint16_t line_index, uint64_t page_number)
+{
+	const uint32_t bucket = tlb_hash(page_number);
+	index->next[line_index] = index->buckets[bucket];
+	index->buckets[bucket] = (uint16_t) (line_index + 1u);
+	index->bucket_of[line_index] = (uint16_t) (bucket + 1u);
+}
+
+
+/**
+ * @brief      Finds the valid line of a virtual page number
+ *
+ * @return     the line, or TLB_LINES if none
+ */
+static uint16_t tlb_index_find(const tlb_index_t * index, const tlb_entry_t * tlb, uint64_t page_number)
+{
+	for (uint16_t link = index->buckets[tlb_hash(page_number)]; link != 0; link = index->next[link - 1])
 		{
-			tlb[i].phy_page_num = 0;
-			tlb[i].tag = 0;
-			tlb[i].v = 0;
+			if (tlb[link - 1].v && tlb[link - 1].tag == page_number) return (uint16_t) (link - 1);
+		}
+	return TLB_LINES;
+}
+
+
+/**
+ * @brief      Makes a line the most recently used, in constant time
+ *
+ * @param      replacement_policy  The LRU order
+ * @param[in]  line_index          The line
+ */
+static void lru_move_back(replacement_policy_t * replacement_policy, uint8_t line_index)
+{
+	const uint8_t link = (uint8_t) (line_index + 1u);
+	if (replacement_policy->mru == link) return;
+
+	// unlink the line (it has a successor, not being the most recently used)
+	const uint8_t prev = replacement_policy->prev[line_index];
+	const uint8_t next = replacement_policy->next[line_index];
+	if (prev == 0) replacement_policy->lru = next;
+	else replacement_policy->next[prev - 1] = next;
+	replacement_policy->prev[next - 1] = prev;
+
+	// append it after the most recently used
+	replacement_policy->prev[line_index] = replacement_policy->mru;
+	replacement_policy->next[line_index] = 0;
+	replacement_policy->next[replacement_policy->mru - 1] = link;
+	replacement_policy->mru = link;
+}
+
+
+int replacement_policy_init(replacement_policy_t * replacement_policy)
+{
+
+	M_REQUIRE_NON_NULL(replacement_policy);
+
+	memset(replacement_policy, 0, sizeof(*replacement_policy));
+	for (uint8_t line_index = 0; line_index < TLB_LINES; ++line_index) //line 0 first, as the least recently used
+		{
+			replacement_policy->prev[line_index] = line_index;
+			replacement_policy->next[line_index] = (uint8_t) (line_index + 1u < TLB_LINES ? line_index + 2u : 0);
 		}
+	replacement_policy->lru = 1;
+	replacement_policy->mru = TLB_LINES;
 	return ERR_NONE;
+}
+
+
+int tlb_insert( uint32_t line_index, const tlb_entry_t * tlb_entry, tlb_entry_t * tlb,
+                replacement_policy_t * replacement_policy)
+{
+
+	M_REQUIRE(line_index < TLB_LINES, ERR_BAD_PARAMETER, "index bigger than size");
+	M_REQUIRE_NON_NULL(tlb_entry);
+	M_REQUIRE_NON_NULL(tlb);
+	M_REQUIRE_NON_NULL(replacement_policy);
+
+	tlb[line_index].phy_page_num = tlb_entry->phy_page_num;//inserts everything at the given index
+	tlb[line_index].tag = tlb_entry->tag;
+	tlb[line_index].v = tlb_entry->v;
+
+	tlb_index_remove(&replacement_policy->index, (uint16_t) line_index);
+	if (tlb_entry->v) tlb_index_add(&replacement_policy->index, (uint16_t) line_index, tlb_entry->tag);
 
+	return ERR_NONE;
 }
 
+
+
 int tlb_hit(const virt_addr_t * vaddr,
             phy_addr_t * paddr,
             const tlb_entry_t * tlb,
@@ -63,20 +164,16 @@ int tlb_hit(const virt_addr_t * vaddr,
 	M_REQUIRE_NON_NULL(replacement_policy);
 
 	uint64_t page_number = virt_addr_t_to_virtual_page_number(vaddr); //extract virtual page number
+	const uint16_t line_index = tlb_index_find(&replacement_policy->index, tlb, page_number);
+	if (line_index == TLB_LINES)
+		{
+			return 0; //return 0 if we didnt hit
+		}
 
-	for_all_nodes_reverse( node, replacement_policy->ll) //loops trough all the nodes
-	{
-
-		if ( tlb[ node->value].tag == page_number && tlb[node->value].v) //checks if the validity node==1 and that we have the corresponding tag
-			{
-
-				paddr->phy_page_num = tlb[node->value].phy_page_num;
-				paddr->page_offset =  vaddr->page_offset;
-				replacement_policy->move_back(replacement_policy->ll,  node);
-				return 1; //return 1 if everything goes well and we hit
-			}
-	}
-	return 0; //return 0 if we didnt hit
+	paddr->phy_page_num = tlb[line_index].phy_page_num;
+	paddr->page_offset =  vaddr->page_offset;
+	lru_move_back(replacement_policy, (uint8_t) line_index);
+	return 1; //return 1 if everything goes well and we hit
 
 }
 
@@ -98,14 +195,14 @@ int tlb_search( const void * mem_space, const virt_addr_t * vaddr, phy_addr_t *
 		{
 			M_REQUIRE(page_walk(mem_space, vaddr, paddr) == ERR_NONE, ERR_MEM, "");
 
-			tlb_entry_t * tlb_entry = malloc(sizeof(tlb_entry_t));//allocates enough space
-			M_REQUIRE_NON_NULL(tlb_entry);
+			tlb_entry_t tlb_entry;
+			M_REQUIRE(tlb_entry_init( vaddr, paddr, &tlb_entry) == ERR_NONE, ERR_MEM, "");
 
-			M_REQUIRE(tlb_entry_init( vaddr, paddr, tlb_entry) == ERR_NONE, ERR_MEM, "");
-			M_REQUIRE(tlb_insert(replacement_policy->ll->front->value, tlb_entry, tlb) == ERR_NONE, ERR_MEM, "");
+			const uint8_t lru = (uint8_t) (replacement_policy->lru - 1u);
+			M_REQUIRE(tlb_insert(lru, &tlb_entry, tlb, replacement_policy) == ERR_NONE, ERR_MEM, "");
 
-			replacement_policy->move_back(replacement_policy->ll, replacement_policy->ll->front);
+			lru_move_back(replacement_policy, lru);
 
 		}
 	return ERR_NONE;
-}
\ No newline at end of file
+}
@@ -10,15 +10,33 @@
 
 #include "tlb.h"
 #include "addr.h"
-#include "list.h"
 
 
+/**
+ * @brief LRU replacement: the lines of the TLB in a doubly linked order,
+ * from the least (lru) to the most (mru) recently used, held in arrays.
+ * The links are line indexes plus one, 0 ending the order. index finds
+ * the valid lines; tlb_insert() keeps it up to date.
+ * Must be set up by replacement_policy_init().
+ */
 typedef struct{
-    list_t * ll;
-    node_t * (*push_back)(list_t * this , const list_content_t * value) ;
-    void  (*move_back)(list_t * this, node_t * node );
+    uint8_t lru;               // least recently used line, plus one
+    uint8_t mru;               // most recently used line, plus one
+    uint8_t prev[TLB_LINES];   // the line used just before each line, plus one
+    uint8_t next[TLB_LINES];   // the line used just after each line, plus one
+    tlb_index_t index;
 
 }replacement_policy_t;
+
+//=========================================================================
+/**
+ * @brief Sets up the LRU order of an empty TLB, from line 0 (least
+ * recently used) to line TLB_LINES - 1, and its empty index.
+ * @param replacement_policy the policy to set up
+ * @return error code
+ */
+int replacement_policy_init(replacement_policy_t * replacement_policy);
+
 //=========================================================================
 /**
  * @brief Clean a TLB (invalidate, reset...).
@@ -35,10 +53,13 @@ int tlb_flush(tlb_entry_t * tlb);
  *
  * On hit, return success (1) and update the physical page number passed as the pointer to the function.
  * On miss, return miss (0).
+ * The line is found through the index of the replacement policy, in constant time.
  *
  * @param vaddr pointer to virtual address
  * @param paddr (modified) pointer to physical address
  * @param tlb pointer to the beginning of the tlb
+ * @param replacement_policy the LRU order of the lines, and their index
+ * (the line hit becomes the most recently used)
  * @return hit (1) or miss (0)
  */
 int tlb_hit(const virt_addr_t * vaddr,
@@ -48,17 +69,19 @@ int tlb_hit(const virt_addr_t * vaddr,
 
 //=========================================================================
 /**
- * @brief Insert an entry to a tlb.
- * Eviction policy is least recently used (LRU).
+ * @brief Insert an entry to a tlb, and index it (the LRU order is left to
+ * the caller).
  *
  * @param line_index the number of the line to overwrite
  * @param tlb_entry pointer to the tlb entry to insert
  * @param tlb pointer to the TLB
+ * @param replacement_policy the index of the TLB
  * @return  error code
  */
 int tlb_insert( uint32_t line_index,
                 const tlb_entry_t * tlb_entry,
-                tlb_entry_t * tlb);
+                tlb_entry_t * tlb,
+                replacement_policy_t * replacement_policy);
 
 //=========================================================================
 /**
@@ -0,0 +1,31 @@
+/**
+ * @file trace-convert.c
+ * @brief converts a program in text format into a binary trace (see trace.h)
+ *
+ * usage: trace-convert text_filename trace_filename
+ *
+ * @date 2019
+ */
+
+#include "error.h"
+#include "trace_mng.h"
+
+#include <stdio.h>
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+        {
+            fprintf(stderr, "usage: %s text_filename trace_filename\n", argv[0]);
+            return 1;
+        }
+
+    const int err = trace_from_text(argv[1], argv[2]);
+    if (err != ERR_NONE)
+        {
+            fprintf(stderr, "ERROR: cannot convert \"%s\" into \"%s\": %s\n", argv[1], argv[2], ERR_MESSAGES[err]);
+            return 2;
+        }
+    return 0;
+}
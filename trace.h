@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * @file trace.h
+ * @brief binary trace of commands (see commands.h)
+ *
+ * A trace file is a header followed by fixed-size records, one per
+ * command, all little-endian:
+ *
+ *    header (TRACE_HEADER_SIZE bytes):
+ *      [0..7]   TRACE_MAGIC
+ *      [8..9]   TRACE_VERSION
+ *      [10..11] TRACE_RECORD_SIZE
+ *      [12..15] 0
+ *
+ *    record (TRACE_RECORD_SIZE bytes):
+ *      [0]      bit 0: order (0: READ, 1: WRITE)
+ *               bit 1: type (0: INSTRUCTION, 1: DATA)
+ *               bits 2-4: data size in bytes (0 to 4)
+ *               bit 5: context switch (then bits 0-4 are 0)
+ *               bits 6-7: 0
+ *      [1]      0
+ *      [2..7]   virtual address (48 bits: the reserved bits of virt_addr_t are 0)
+ *      [8..11]  data to write (0 for reads), CR3 for a context switch
+ *
+ * Traces are read through mmap(), one record at a time, so that a whole
+ * program never has to be in memory.
+ *
+ * @date 2019
+ */
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+#define TRACE_MAGIC        "CMDTRACE" // 8 bytes, no terminating 0 in the file
+#define TRACE_MAGIC_SIZE   8
+#define TRACE_VERSION      1
+#define TRACE_HEADER_SIZE  16
+#define TRACE_RECORD_SIZE  12
+
+#define TRACE_VADDR_BITS   48
+
+/**
+ * @brief A record, as stored in the file.
+ */
+typedef struct
+{
+	uint8_t bytes[TRACE_RECORD_SIZE];
+} trace_record_t;
+
+/**
+ * @brief A trace opened for reading.
+ */
+typedef struct
+{
+	const uint8_t * map;  // the whole file
+	size_t map_size;
+	const uint8_t * next; // next record to read
+	const uint8_t * end;  // end of the records
+} trace_t;
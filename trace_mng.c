@@ -0,0 +1,220 @@
+/**
+ * @file trace_mng.c
+ * @brief reading and writing binary traces
+ *
+ * @date 2019
+ */
+
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise, fstat
+
+#include "trace_mng.h"
+#include "cmd_source_mng.h"
+#include "addr_mng.h"
+#include "error.h"
+#include "util.h" // zero_init_ptr
+
+#include <string.h> // memcmp, memcpy
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_ORDER_BIT  0x01u
+#define TRACE_TYPE_BIT   0x02u
+#define TRACE_SIZE_SHIFT 2
+#define TRACE_SIZE_MASK  0x07u
+#define TRACE_SWITCH_BIT 0x20u
+
+// ======================================================================
+static void put_le(uint8_t * bytes, uint64_t value, int nb_bytes)
+{
+	for (int i = 0; i < nb_bytes; ++i, value >>= 8)
+		bytes[i] = (uint8_t) value;
+}
+
+static uint64_t get_le(const uint8_t * bytes, int nb_bytes)
+{
+	uint64_t value = 0;
+	for (int i = nb_bytes - 1; i >= 0; --i)
+		value = (value << 8) | bytes[i];
+	return value;
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_record_encode(const command_t * command, trace_record_t * record)
+{
+	M_REQUIRE_NON_NULL(command);
+	M_REQUIRE_NON_NULL(record);
+	M_REQUIRE(command->data_size <= sizeof(word_t), ERR_SIZE, "%zu: data size too large", command->data_size);
+
+	const uint64_t vaddr = virt_addr_t_to_uint64_t(&command->vaddr);
+	M_REQUIRE((vaddr >> TRACE_VADDR_BITS) == 0, ERR_ADDR, "0x%016" PRIx64 ": more than 48 bits", vaddr);
+
+	if (command->order == SWITCH)
+		record->bytes[0] = TRACE_SWITCH_BIT;
+	else
+		record->bytes[0] = (uint8_t) ((command->order == WRITE ? TRACE_ORDER_BIT : 0u)
+		                              | (command->type == DATA ? TRACE_TYPE_BIT : 0u)
+		                              | (unsigned) command->data_size << TRACE_SIZE_SHIFT);
+	record->bytes[1] = 0;
+	put_le(record->bytes + 2, vaddr, 6);
+	put_le(record->bytes + 8, command->write_data, 4);
+
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_record_decode(const trace_record_t * record, command_t * command)
+{
+	M_REQUIRE_NON_NULL(record);
+	M_REQUIRE_NON_NULL(command);
+
+	const uint8_t flags = record->bytes[0];
+	const size_t data_size = (flags >> TRACE_SIZE_SHIFT) & TRACE_SIZE_MASK;
+	M_REQUIRE((flags >> 6) == 0 && record->bytes[1] == 0 && data_size <= sizeof(word_t)
+	          && ((flags & TRACE_SWITCH_BIT) == 0 || flags == TRACE_SWITCH_BIT),
+	          ERR_BAD_PARAMETER, "%s", "malformed record");
+
+	command->order = (flags & TRACE_SWITCH_BIT) ? SWITCH : (flags & TRACE_ORDER_BIT) ? WRITE : READ;
+	command->type = (flags & TRACE_TYPE_BIT) ? DATA : INSTRUCTION;
+	command->data_size = data_size;
+	command->write_data = (word_t) get_le(record->bytes + 8, 4);
+	M_EXIT_IF_ERR(init_virt_addr64(&command->vaddr, get_le(record->bytes + 2, 6)), "decoding the address");
+	// the commands a text source would reject (see cmd_source_mng.c)
+	return command_check(command);
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_write_header(FILE * output)
+{
+	M_REQUIRE_NON_NULL(output);
+
+	uint8_t header[TRACE_HEADER_SIZE] = { 0 };
+	memcpy(header, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+	put_le(header + 8, TRACE_VERSION, 2);
+	put_le(header + 10, TRACE_RECORD_SIZE, 2);
+	M_REQUIRE(fwrite(header, sizeof(header), 1, output) == 1, ERR_IO, "%s", "writing trace header");
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_write_command(FILE * output, const command_t * command)
+{
+	M_REQUIRE_NON_NULL(output);
+
+	trace_record_t record;
+	M_EXIT_IF_ERR(trace_record_encode(command, &record), "encoding command");
+	M_REQUIRE(fwrite(record.bytes, sizeof(record.bytes), 1, output) == 1, ERR_IO, "%s", "writing trace record");
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_from_text(const char * text_filename, const char * trace_filename)
+{
+	M_REQUIRE_NON_NULL(text_filename);
+	M_REQUIRE_NON_NULL(trace_filename);
+
+	cmd_source_t source;
+	M_EXIT_IF_ERR(cmd_source_open_text(&source, text_filename), "opening text program");
+
+	FILE * output = fopen(trace_filename, "wb");
+	if (output == NULL)
+		{
+			cmd_source_close(&source);
+			M_EXIT(ERR_IO, "%s: cannot open for writing", trace_filename);
+		}
+
+	// one command at a time: any length of program
+	command_t command;
+	int err = trace_write_header(output);
+	while (err == ERR_NONE && (err = cmd_source_next(&source, &command)) == ERR_NONE)
+		err = trace_write_command(output, &command);
+	if (err == ERR_EOF) err = ERR_NONE;
+
+	if (fclose(output) != 0 && err == ERR_NONE) err = ERR_IO;
+	cmd_source_close(&source);
+	return err;
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_open(const char * filename, trace_t * trace)
+{
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL(trace);
+	zero_init_ptr(trace);
+
+	const int fd = open(filename, O_RDONLY);
+	M_REQUIRE(fd >= 0, ERR_IO, "%s: cannot open", filename);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < TRACE_HEADER_SIZE)
+		{
+			close(fd);
+			M_EXIT(ERR_IO, "%s: not a trace", filename);
+		}
+
+	const size_t size = (size_t) st.st_size;
+	void * map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays valid
+	M_REQUIRE(map != MAP_FAILED, ERR_IO, "%s: cannot map", filename);
+	(void) posix_madvise(map, size, POSIX_MADV_SEQUENTIAL); // only a hint
+
+	const uint8_t * bytes = map;
+	int err = ERR_NONE;
+	if (memcmp(bytes, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0
+	    || get_le(bytes + 8, 2) != TRACE_VERSION
+	    || get_le(bytes + 10, 2) != TRACE_RECORD_SIZE)
+		err = ERR_IO;
+	else if ((size - TRACE_HEADER_SIZE) % TRACE_RECORD_SIZE != 0)
+		err = ERR_SIZE;
+	if (err != ERR_NONE)
+		{
+			munmap(map, size);
+			M_EXIT(err, "%s: not a trace, or truncated", filename);
+		}
+
+	trace->map = bytes;
+	trace->map_size = size;
+	trace->next = bytes + TRACE_HEADER_SIZE;
+	trace->end = bytes + size;
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see trace_mng.h
+int trace_next(trace_t * trace, command_t * command)
+{
+	M_REQUIRE_NON_NULL(trace);
+	M_REQUIRE_NON_NULL(command);
+
+	if (trace->next >= trace->end) return ERR_EOF;
+
+	const trace_record_t * record = (const trace_record_t *) trace->next; // only bytes: no alignment needed
+	trace->next += TRACE_RECORD_SIZE;
+	return trace_record_decode(record, command);
+}
+
+// ======================================================================
+// see trace_mng.h
+size_t trace_length(const trace_t * trace)
+{
+	if (trace == NULL || trace->map == NULL) return 0;
+	return (trace->map_size - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE;
+}
+
+// ======================================================================
+// see trace_mng.h
+void trace_close(trace_t * trace)
+{
+	if (trace != NULL && trace->map != NULL)
+		{
+			munmap((void *) trace->map, trace->map_size);
+			zero_init_ptr(trace);
+		}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * @file trace_mng.h
+ * @brief reading and writing binary traces (see trace.h)
+ *
+ * @date 2019
+ */
+
+#include "trace.h"
+#include "commands.h"
+#include <stdio.h> // FILE
+
+//=========================================================================
+/**
+ * @brief Packs a command into a record.
+ * @param command the command
+ * @param record (modified) the record
+ * @return error code (ERR_ADDR if the address needs more than TRACE_VADDR_BITS)
+ */
+int trace_record_encode(const command_t * command, trace_record_t * record);
+
+//=========================================================================
+/**
+ * @brief Unpacks a record into a command.
+ * @param record the record
+ * @param command (modified) the command
+ * @return error code (ERR_BAD_PARAMETER if the record is malformed, or
+ * its command fails command_check())
+ */
+int trace_record_decode(const trace_record_t * record, command_t * command);
+
+//=========================================================================
+/**
+ * @brief Writes the header of a trace, to be followed by records.
+ * @param output the (binary) stream to write to
+ * @return error code
+ */
+int trace_write_header(FILE * output);
+
+//=========================================================================
+/**
+ * @brief Appends a command to a trace.
+ * @param output the (binary) stream to write to
+ * @param command the command to write
+ * @return error code
+ */
+int trace_write_command(FILE * output, const command_t * command);
+
+//=========================================================================
+/**
+ * @brief Converts a program in text format (see program_read()) to a trace.
+ * @param text_filename the program to read
+ * @param trace_filename the trace to write
+ * @return error code
+ */
+int trace_from_text(const char * text_filename, const char * trace_filename);
+
+//=========================================================================
+/**
+ * @brief Opens a trace for reading (mmap).
+ * @param filename the trace
+ * @param trace (modified) the opened trace, positioned on the first record
+ * @return error code (ERR_IO if the file is not a trace, ERR_SIZE if truncated)
+ */
+int trace_open(const char * filename, trace_t * trace);
+
+//=========================================================================
+/**
+ * @brief Reads the next command of a trace.
+ * @param trace the trace
+ * @param command (modified) the command
+ * @return error code, ERR_EOF after the last record
+ */
+int trace_next(trace_t * trace, command_t * command);
+
+//=========================================================================
+/**
+ * @brief Number of records of a trace.
+ */
+size_t trace_length(const trace_t * trace);
+
+//=========================================================================
+/**
+ * @brief Unmaps a trace.
+ * @param trace the trace to close
+ */
+void trace_close(trace_t * trace);
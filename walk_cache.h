@@ -0,0 +1,66 @@
+#pragma once
+
+/**
+ * @file walk_cache.h
+ * @brief paging-structure caches: the page tables a page walk went through
+ *
+ * A PML4E cache maps the PGD index of an address to its PUD table, a PDPTE
+ * cache its PGD and PUD indexes to its PMD table and a PDE cache its PGD,
+ * PUD and PMD indexes to its page table. A walk starts from the deepest
+ * table found, which saves it one to three reads of the page tables; the
+ * entries mapping huge pages are left to the TLBs.
+ *
+ * @date 2019
+ */
+
+#include "stats.h"
+
+#include <stdint.h>
+
+#define WALK_CACHE_MAX_WAYS  16u
+#define WALK_CACHE_MAX_LINES 256u
+
+/**
+ * @brief The caches, by the entry whose table they hold: the PML4E cache
+ * holds what a PGD entry points to, the PDPTE cache what a PUD entry
+ * points to and the PDE cache what a PMD entry points to.
+ */
+typedef enum
+{
+	PML4E_CACHE, PDPTE_CACHE, PDE_CACHE, NB_WALK_CACHES
+} walk_cache_type_t;
+
+/**
+ * @brief Run-time geometry of one cache, replaced in LRU order.
+ * A cache of 0 lines does not exist; lines must be a power of 2.
+ */
+typedef struct
+{
+	uint16_t lines;  // number of sets
+	uint8_t ways;    // associativity, at most WALK_CACHE_MAX_WAYS
+} walk_cache_config_t;
+
+// Skylake/Kaby Lake: 2 PML4E, 4 PDPTE and 32 PDE entries
+#define WALK_CACHE_KABY_LAKE_CONFIG { { 1, 2 }, { 1, 4 }, { 8, 4 } }
+
+/*
+ * A valid entry holds the indexes of its tables, without its index bits,
+ * and the PCID of its address space from bit WALK_CACHE_PCID_SHIFT on,
+ * with WALK_CACHE_VALID set; an invalid one holds 0.
+ */
+#define WALK_CACHE_VALID (UINT64_C(1) << 63)
+#define WALK_CACHE_PCID_SHIFT 48
+
+/**
+ * @brief One cache: its geometry and its entries, stored as a structure of arrays.
+ */
+typedef struct
+{
+	walk_cache_type_t type;
+	walk_cache_config_t config;
+	uint8_t index_bits; // log_2(config.lines)
+	uint64_t * tags;    // config.lines * config.ways tags; owns the whole storage
+	uint32_t * tables;  // the physical addresses of the tables
+	uint8_t * ages;     // LRU ages
+	level_stats_t stats;
+} walk_cache_t;
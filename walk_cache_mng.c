@@ -0,0 +1,144 @@
+/**
+ * @file walk_cache_mng.c
+ * @brief paging-structure caches
+ *
+ * @date 2019
+ */
+
+#include "walk_cache_mng.h"
+#include "addr.h" // PTE_ENTRY
+#include "cache_mng.h" // foreach_way, and cache_age for lru.h
+#include "lru.h"
+#include "error.h"
+#include "util.h" // zero_init_ptr
+
+#include <stdlib.h> // calloc
+#include <string.h> // memset
+
+// --------------------------------------------------
+// the indexes of the tables walked before the one a cache holds
+#define walk_prefix_of(CACHE, VPN) \
+        ((VPN) >> (PTE_ENTRY * (NB_WALK_CACHES - (CACHE)->type)))
+
+// --------------------------------------------------
+#define walk_key_of(CACHE, PREFIX, PCID) \
+        ((PREFIX) >> (CACHE)->index_bits | (uint64_t) (PCID) << WALK_CACHE_PCID_SHIFT | WALK_CACHE_VALID)
+
+// --------------------------------------------------
+#define walk_slot(CACHE, LINE_INDEX, WAY) \
+        ((size_t) (LINE_INDEX) * (CACHE)->config.ways + (WAY))
+
+static const char * const WALK_CACHE_NAMES[NB_WALK_CACHES] = { "PML4E_CACHE", "PDPTE_CACHE", "PDE_CACHE" };
+
+// ======================================================================
+// see walk_cache_mng.h
+int walk_cache_init(walk_cache_t * cache, walk_cache_type_t type, const walk_cache_config_t * config)
+{
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(config);
+	M_REQUIRE(type < NB_WALK_CACHES, ERR_BAD_PARAMETER, "%d: unknown paging-structure cache", type);
+	M_REQUIRE(config->lines <= WALK_CACHE_MAX_LINES && (config->lines & (config->lines - 1)) == 0,
+	          ERR_SIZE, "%u lines: not a power of 2 up to %u", config->lines, WALK_CACHE_MAX_LINES);
+	M_REQUIRE(config->lines == 0 || (config->ways > 0 && config->ways <= WALK_CACHE_MAX_WAYS),
+	          ERR_SIZE, "%u ways", config->ways);
+
+	zero_init_ptr(cache);
+	cache->type = type;
+	cache->config = *config;
+	if (config->lines == 0) return ERR_NONE;
+
+	while ((1u << cache->index_bits) < config->lines) ++cache->index_bits;
+	const size_t slots = (size_t) config->lines * config->ways;
+	cache->tags = calloc(slots, sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint8_t));
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(cache->tags, ERR_MEM);
+	cache->tables = (uint32_t *) (cache->tags + slots);
+	cache->ages = (uint8_t *) (cache->tables + slots);
+	return ERR_NONE;
+}
+
+// ======================================================================
+// see walk_cache_mng.h
+void walk_cache_free(walk_cache_t * cache)
+{
+	if (cache != NULL)
+		{
+			free(cache->tags);
+			cache->tags = NULL;
+			cache->tables = NULL;
+			cache->ages = NULL;
+		}
+}
+
+// ======================================================================
+// see walk_cache_mng.h
+void walk_cache_flush(walk_cache_t * cache)
+{
+	if (cache != NULL && cache->tags != NULL)
+		memset(cache->tags, 0, (size_t) cache->config.lines * cache->config.ways * sizeof(uint64_t));
+}
+
+// ======================================================================
+// see walk_cache_mng.h
+int walk_cache_lookup(walk_cache_t * cache, uint16_t pcid, uint64_t virt_page_num, mem_access_t access, uint32_t * table)
+{
+	if (cache == NULL || cache->tags == NULL || table == NULL) return 0;
+
+	const uint64_t prefix = walk_prefix_of(cache, virt_page_num);
+	const uint32_t line_index = (uint32_t) (prefix & (cache->config.lines - 1u));
+	const uint64_t key = walk_key_of(cache, prefix, pcid);
+	const uint64_t * const tags = cache->tags + walk_slot(cache, line_index, 0);
+
+	stats_inc(&cache->stats, access, STAT_ACCESSES);
+	foreach_way(way, cache->config.ways)
+		if (tags[way] == key)
+			{
+				*table = cache->tables[walk_slot(cache, line_index, way)];
+				LRU_age_update(cache, cache->config.ways, way, line_index);
+				stats_inc(&cache->stats, access, STAT_HITS);
+				return 1;
+			}
+	stats_inc(&cache->stats, access, STAT_MISSES);
+	return 0;
+}
+
+// ======================================================================
+// see walk_cache_mng.h
+void walk_cache_insert(walk_cache_t * cache, uint16_t pcid, uint64_t virt_page_num, mem_access_t access, uint32_t table)
+{
+	if (cache == NULL || cache->tags == NULL) return;
+
+	const uint64_t prefix = walk_prefix_of(cache, virt_page_num);
+	const uint32_t line_index = (uint32_t) (prefix & (cache->config.lines - 1u));
+	uint64_t * const tags = cache->tags + walk_slot(cache, line_index, 0);
+
+	// an invalid way if any, the least recently used one otherwise
+	uint8_t victim = 0;
+	foreach_way(way, cache->config.ways)
+		{
+			if (tags[way] == 0)
+				{
+					victim = way;
+					break;
+				}
+			if (cache_age(cache, line_index, way) > cache_age(cache, line_index, victim))
+				victim = way;
+		}
+	if (tags[victim] != 0) stats_inc(&cache->stats, access, STAT_EVICTIONS);
+
+	tags[victim] = walk_key_of(cache, prefix, pcid);
+	cache->tables[walk_slot(cache, line_index, victim)] = table;
+	LRU_age_increase(cache, cache->config.ways, victim, line_index);
+}
+
+// ======================================================================
+// see walk_cache_mng.h
+int walk_cache_stats_print(FILE * output, stats_format_t format, const walk_cache_t * caches)
+{
+	M_REQUIRE_NON_NULL(caches);
+
+	for (walk_cache_type_t type = PML4E_CACHE; type < NB_WALK_CACHES; ++type)
+		if (caches[type].config.lines > 0)
+			M_EXIT_IF_ERR(stats_print(output, format, WALK_CACHE_NAMES[type], &caches[type].stats),
+			              "printing paging-structure cache stats");
+	return ERR_NONE;
+}
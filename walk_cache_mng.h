@@ -0,0 +1,73 @@
+#pragma once
+
+/**
+ * @file walk_cache_mng.h
+ * @brief management of the paging-structure caches (see walk_cache.h)
+ *
+ * @date 2019
+ */
+
+#include "walk_cache.h"
+#include "mem_access.h"
+
+#include <stdint.h>
+#include <stdio.h> // FILE
+
+//=========================================================================
+/**
+ * @brief Create an empty paging-structure cache.
+ * @param cache (modified) the cache
+ * @param type which entries it caches
+ * @param config its geometry; 0 lines make an absent cache
+ * @return error code (ERR_SIZE if the geometry is not supported)
+ */
+int walk_cache_init(walk_cache_t * cache, walk_cache_type_t type, const walk_cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Free the entries of a cache.
+ * @param cache the cache
+ */
+void walk_cache_free(walk_cache_t * cache);
+
+//=========================================================================
+/**
+ * @brief Invalidate all the entries of a cache; the statistics are kept.
+ * @param cache the cache
+ */
+void walk_cache_flush(walk_cache_t * cache);
+
+//=========================================================================
+/**
+ * @brief Look up the table of a virtual page in a cache; an absent cache
+ * always misses and counts nothing.
+ * @param cache the cache
+ * @param pcid the address space of the page
+ * @param virt_page_num the virtual page number (in 4 kiB pages)
+ * @param access the kind of access the walk is for, for the statistics
+ * @param table (modified) on hit, the physical address of the table
+ * @return hit (1) or miss (0)
+ */
+int walk_cache_lookup(walk_cache_t * cache, uint16_t pcid, uint64_t virt_page_num, mem_access_t access, uint32_t * table);
+
+//=========================================================================
+/**
+ * @brief Cache the table of a virtual page, in the least recently used way
+ * of its set.
+ * @param cache the cache
+ * @param pcid the address space of the page
+ * @param virt_page_num the virtual page number (in 4 kiB pages)
+ * @param access the kind of access the walk is for, for the statistics
+ * @param table the physical address of the table
+ */
+void walk_cache_insert(walk_cache_t * cache, uint16_t pcid, uint64_t virt_page_num, mem_access_t access, uint32_t table);
+
+//=========================================================================
+/**
+ * @brief Print the statistics of the caches that exist.
+ * @param output the stream to print to
+ * @param format text or CSV (see stats_print())
+ * @param caches the NB_WALK_CACHES caches
+ * @return error code
+ */
+int walk_cache_stats_print(FILE * output, stats_format_t format, const walk_cache_t * caches);